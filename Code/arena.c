@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "debug.h"
+
+// Get a chunk which holds at least size bytes, a spare one if it is large enough.
+static ARChunk *ARNewChunk(Arena *arena, size_t size) {
+  ARChunk *chunk = arena->spare;
+  if (chunk != NULL && chunk->size >= size + AR_ALIGN) {
+    arena->spare = chunk->prev;
+  } else {
+    if (size < AR_CHUNK) size = AR_CHUNK;
+    chunk = (ARChunk *)malloc(sizeof(ARChunk) + size + AR_ALIGN);
+    Assert(chunk != NULL, "out of memory for arena chunk");
+    chunk->size = size + AR_ALIGN;
+  }
+  chunk->prev = arena->head;
+  chunk->used = 0;
+  return chunk;
+}
+
+// Move the chunks above stop to the spares.
+static void ARSpare(Arena *arena, ARChunk *stop) {
+  while (arena->head != stop) {
+    ARChunk *chunk = arena->head;
+    arena->head = chunk->prev;
+    chunk->prev = arena->spare;
+    arena->spare = chunk;
+  }
+}
+
+// Allocate size bytes from the arena. Memory is NOT zeroed.
+void *ARAlloc(Arena *arena, size_t size) {
+  ARChunk *chunk = arena->head;
+  if (chunk != NULL) {
+    uintptr_t base = (uintptr_t)(chunk->data + chunk->used);
+    size_t pad = (AR_ALIGN - (base & (AR_ALIGN - 1))) & (AR_ALIGN - 1);
+    if (chunk->used + pad + size <= chunk->size) {
+      chunk->used += pad + size;
+      return (void *)(base + pad);
+    }
+  }
+  chunk = arena->head = ARNewChunk(arena, size);
+  uintptr_t base = (uintptr_t)chunk->data;
+  size_t pad = (AR_ALIGN - (base & (AR_ALIGN - 1))) & (AR_ALIGN - 1);
+  chunk->used = pad + size;
+  return (void *)(base + pad);
+}
+
+// Release every object in the arena with one walk over the chunks.
+void ARDestroy(Arena *arena) {
+  ARSpare(arena, NULL);
+  for (ARChunk *chunk = arena->spare, *prev = NULL; chunk != NULL; chunk = prev) {
+    prev = chunk->prev;
+    free(chunk);
+  }
+  arena->spare = NULL;
+}
+
+// Release every object in the arena, but keep its memory.
+void ARReset(Arena *arena) {
+  ARSpare(arena, NULL);
+}
+
+// Remember the top of the arena.
+ARMark ARGetMark(const Arena *arena) {
+  ARMark mark;
+  mark.chunk = arena->head;
+  mark.used = arena->head != NULL ? arena->head->used : 0;
+  return mark;
+}
+
+// Release every object allocated after the mark was taken.
+void ARRelease(Arena *arena, ARMark mark) {
+  ARSpare(arena, mark.chunk);
+  if (arena->head != NULL) arena->head->used = mark.used;
+}
@@ -0,0 +1,42 @@
+/**
+ * The bump-pointer arena allocator.
+ * Objects are carved out of large chunks and released all at once.
+ * An arena can also be used as a stack of regions: take a mark, and
+ * release everything allocated after it in one step.
+ * Released chunks are kept as spares for later allocations, so an arena
+ * reset between compilations does not go back to malloc.
+ * */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define AR_ALIGN 16          // alignment of every allocation
+#define AR_CHUNK (1 << 20)   // default chunk size, 1 MiB
+
+typedef struct ARChunk {
+  struct ARChunk *prev;
+  size_t size, used;
+  char data[];
+} ARChunk;
+
+typedef struct Arena {
+  ARChunk *head;
+  ARChunk *spare; // released chunks, linked by prev
+} Arena;
+
+typedef struct ARMark {
+  ARChunk *chunk;
+  size_t used;
+} ARMark;
+
+#define ARENA_INIT { NULL, NULL }
+
+void *ARAlloc(Arena *arena, size_t size);
+void ARDestroy(Arena *arena);
+void ARReset(Arena *arena);
+ARMark ARGetMark(const Arena *arena);
+void ARRelease(Arena *arena, ARMark mark);
+
+#endif // ARENA_H
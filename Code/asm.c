@@ -1,13 +1,13 @@
+#include <stdlib.h>
+#include <string.h>
 #include "asm.h"
 #include "ir.h"
-#include "rbtree.h"
+#include "intern.h"
+#include "emit.h"
 
 // #define DEBUG // <- assembler debug switch
 #include "debug.h"
 
-size_t pushed = 0; // size of pushed values
-extern IRCodeList irlist;
-
 const char *registers[] = {
   "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
   "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
@@ -43,160 +43,231 @@ const char *_header =
   "    jr      $ra\n\n";
 
 // External API to translate IR to MIPS.
-void assemble(FILE *file) {
-  ASTranslateList(file, irlist);
+void assemble(FILE *file, IRCodeList list) {
+  ASTranslateHeader(file);
+  EMBuffer out;
+  EMOpen(&out, file);
+  ASTranslateList(&out, list);
+  EMClose(&out);
+}
+
+// Write the data section and the READ and WRITE functions.
+void ASTranslateHeader(FILE *file) {
+  fputs(_header, file);
 }
 
 // Internal API to translate IR to MIPS.
-void ASTranslateList(FILE *file, IRCodeList list) {
+// All state is local, lists can be translated on different threads.
+void ASTranslateList(EMBuffer *out, IRCodeList list) {
+  ASFrame frame = { 0, 0, NULL, 0 };
   for (IRCode *code = list.head; code != NULL; code = code->next) {
     if (code->kind == IR_CODE_FUNCTION) {
-      code->function.function.size = ASPrepareFunction(code, &code->function.root);
+      ASPrepareFunction(&frame, code);
     }
+    ASTranslateCode(out, &frame, code);
   }
-  fprintf(file, "%s", _header);
-  for (IRCode *code = list.head; code != NULL; code = code->next) {
-    ASTranslateCode(file, code);
+  free(frame.slots);
+}
+
+// Start an instruction, its name is padded to the column of operands.
+static void ASInstruction(EMBuffer *out, const char *name) {
+  static const char blank[] = "            ";
+  size_t length = strlen(name);
+  EMLiteral(out, "    ");
+  EMChars(out, name, length);
+  EMChars(out, blank, length < 8 ? 8 - length : 1);
+}
+
+// Append an instruction on registers, like `add $t0,$t0,$t1`; the last
+// registers may be NULL.
+static void ASRegisters(EMBuffer *out, const char *name, const char *r1, const char *r2,
+                        const char *r3) {
+  ASInstruction(out, name);
+  EMString(out, r1);
+  if (r2 != NULL) {
+    EMChar(out, ',');
+    EMString(out, r2);
   }
-  for (IRCode *code = list.head; code != NULL; code = code->next) {
-    if (code->kind == IR_CODE_FUNCTION) {
-      RBDestroy(&code->function.root, NULL);
-    }
+  if (r3 != NULL) {
+    EMChar(out, ',');
+    EMString(out, r3);
+  }
+  EMChar(out, '\n');
+}
+
+// Append an instruction on $sp and a number, like `addiu $sp,$sp,8` or
+// `sw $ra,4($sp)`.
+static void ASStack(EMBuffer *out, const char *name, const char *reg, long value, bool based) {
+  ASInstruction(out, name);
+  EMString(out, reg);
+  EMChar(out, ',');
+  if (!based) EMLiteral(out, "$sp,");
+  EMInt(out, value);
+  if (based) EMLiteral(out, "($sp)");
+  EMChar(out, '\n');
+}
+
+// Append the name of a function as a label, main keeps its name.
+static void ASFunctionName(EMBuffer *out, unsigned int atom) {
+  const char *name = INName(atom);
+  if (name == INTERN_MAIN) {
+    EMLiteral(out, "main");
+  } else {
+    EMLiteral(out, "func_");
+    EMString(out, name);
   }
 }
 
-// Translate a single code to MIPS assembly.
-void ASTranslateCode(FILE *file, IRCode *code) {
+// Translate a single code of the function of frame to MIPS assembly.
+void ASTranslateCode(EMBuffer *out, ASFrame *frame, IRCode *code) {
   if (code->kind == IR_CODE_FUNCTION) {
-    fprintf(file, "\n");
+    EMChar(out, '\n');
   }
 #ifdef DEBUG
-  fprintf(file, "# ");
-  IRWriteCode(file, code);
+  EMLiteral(out, "# ");
+  IREmitCode(out, code);
 #endif
   switch (code->kind) {
   case IR_CODE_LABEL: 
-    fprintf(file, "label%d:\n", code->label.label.number);
+    EMLiteral(out, "label");
+    EMInt(out, (int)code->label.label.number);
+    EMLiteral(out, ":\n");
     break;
   case IR_CODE_FUNCTION: {
-    size_t size = code->function.function.size;
-    if (!strcmp(code->function.function.name, "main")) {
-      fprintf(file, "main:\n");
-    } else {
-      fprintf(file, "func_%s:\n", code->function.function.name);
-    }
-    fprintf(file, "    subu    $sp,$sp,%lu\n", size);
-    fprintf(file, "    sw      $ra,%lu($sp)\n", size - 4);
-    fprintf(file, "    sw      $fp,%lu($sp)\n", size - 8);
-    fprintf(file, "    addiu   $fp,$sp,%lu\n", size);
+    long size = (long)frame->size;
+    ASFunctionName(out, code->function.function.atom);
+    EMLiteral(out, ":\n");
+    ASStack(out, "subu", "$sp", size, false);
+    ASStack(out, "sw", "$ra", size - 4, true);
+    ASStack(out, "sw", "$fp", size - 8, true);
+    ASInstruction(out, "addiu");
+    EMLiteral(out, "$fp,$sp,");
+    EMInt(out, size);
+    EMChar(out, '\n');
     break;
   }
   case IR_CODE_ASSIGN:
-    ASLoadRegister(file, _t0, code->assign.right);
-    ASSaveRegister(file, _t0, code->assign.left);
+    ASLoadRegister(out, frame, _t0, code->assign.right);
+    ASSaveRegister(out, frame, _t0, code->assign.left);
     break;
   case IR_CODE_ADD:
-    ASLoadRegister(file, _t0, code->binop.op1);
-    ASLoadRegister(file, _t1, code->binop.op2);
-    fprintf(file, "    add     %s,%s,%s\n", _t0, _t0, _t1);
-    ASSaveRegister(file, _t0, code->binop.result);
+    ASLoadRegister(out, frame, _t0, code->binop.op1);
+    ASLoadRegister(out, frame, _t1, code->binop.op2);
+    ASRegisters(out, "add", _t0, _t0, _t1);
+    ASSaveRegister(out, frame, _t0, code->binop.result);
     break;
   case IR_CODE_SUB:
-    ASLoadRegister(file, _t0, code->binop.op1);
-    ASLoadRegister(file, _t1, code->binop.op2);
-    fprintf(file, "    sub     %s,%s,%s\n", _t0, _t0, _t1);
-    ASSaveRegister(file, _t0, code->binop.result);
+    ASLoadRegister(out, frame, _t0, code->binop.op1);
+    ASLoadRegister(out, frame, _t1, code->binop.op2);
+    ASRegisters(out, "sub", _t0, _t0, _t1);
+    ASSaveRegister(out, frame, _t0, code->binop.result);
     break;
   case IR_CODE_MUL:
-    ASLoadRegister(file, _t0, code->binop.op1);
-    ASLoadRegister(file, _t1, code->binop.op2);
-    fprintf(file, "    mul     %s,%s,%s\n", _t0, _t0, _t1);
-    ASSaveRegister(file, _t0, code->binop.result);
+    ASLoadRegister(out, frame, _t0, code->binop.op1);
+    ASLoadRegister(out, frame, _t1, code->binop.op2);
+    ASRegisters(out, "mul", _t0, _t0, _t1);
+    ASSaveRegister(out, frame, _t0, code->binop.result);
     break;
   case IR_CODE_DIV:
-    ASLoadRegister(file, _t0, code->binop.op1);
-    ASLoadRegister(file, _t1, code->binop.op2);
-    fprintf(file, "    div     %s,%s\n", _t0, _t1);
-    fprintf(file, "    mflo    %s\n", _t0);
-    ASSaveRegister(file, _t0, code->binop.result);
+    ASLoadRegister(out, frame, _t0, code->binop.op1);
+    ASLoadRegister(out, frame, _t1, code->binop.op2);
+    ASRegisters(out, "div", _t0, _t1, NULL);
+    ASRegisters(out, "mflo", _t0, NULL, NULL);
+    ASSaveRegister(out, frame, _t0, code->binop.result);
     break;
   case IR_CODE_LOAD:
-    ASLoadRegister(file, _t1, code->load.right);
-    fprintf(file, "    lw      %s,0(%s)\n", _t0, _t1);
-    ASSaveRegister(file, _t0, code->load.left);
+    ASLoadRegister(out, frame, _t1, code->load.right);
+    ASInstruction(out, "lw");
+    EMString(out, _t0);
+    EMLiteral(out, ",0(");
+    EMString(out, _t1);
+    EMLiteral(out, ")\n");
+    ASSaveRegister(out, frame, _t0, code->load.left);
     break;
   case IR_CODE_SAVE:
-    ASLoadRegister(file, _t0, code->save.right);
-    ASLoadRegister(file, _t1, code->save.left);
-    fprintf(file, "    sw      %s,0(%s)\n", _t0, _t1);
+    ASLoadRegister(out, frame, _t0, code->save.right);
+    ASLoadRegister(out, frame, _t1, code->save.left);
+    ASInstruction(out, "sw");
+    EMString(out, _t0);
+    EMLiteral(out, ",0(");
+    EMString(out, _t1);
+    EMLiteral(out, ")\n");
     break;
   case IR_CODE_JUMP:
-    fprintf(file, "    j       label%d\n", code->jump.dest.number);
+    ASInstruction(out, "j");
+    EMLiteral(out, "label");
+    EMInt(out, (int)code->jump.dest.number);
+    EMChar(out, '\n');
     break;
   case IR_CODE_JUMP_COND: {
-    char command[8] = "";
+    const char *command = "";
     switch (code->jump_cond.relop.relop) {
     case RELOP_IV:
       Panic("invalid relop RELOP_IV");
       break;
     case RELOP_LT:
-      sprintf(command, "blt");
+      command = "blt";
       break;
     case RELOP_LE:
-      sprintf(command, "ble");
+      command = "ble";
       break;
     case RELOP_GE:
-      sprintf(command, "bge");
+      command = "bge";
       break;
     case RELOP_GT:
-      sprintf(command, "bgt");
+      command = "bgt";
       break;
     case RELOP_EQ:
-      sprintf(command, "beq");
+      command = "beq";
       break;
     case RELOP_NE:
-      sprintf(command, "bne");
+      command = "bne";
       break;
     }
-    ASLoadRegister(file, _t0, code->jump_cond.op1);
-    ASLoadRegister(file, _t1, code->jump_cond.op2);
-    fprintf(file, "    %s     %s,%s,label%d\n", command, _t0, _t1, code->jump_cond.dest.number);
+    ASLoadRegister(out, frame, _t0, code->jump_cond.op1);
+    ASLoadRegister(out, frame, _t1, code->jump_cond.op2);
+    ASInstruction(out, command);
+    EMString(out, _t0);
+    EMChar(out, ',');
+    EMString(out, _t1);
+    EMLiteral(out, ",label");
+    EMInt(out, (int)code->jump_cond.dest.number);
+    EMChar(out, '\n');
     break;
   }
   case IR_CODE_RETURN: {
-    Assert(code->parent != NULL, "code not belong to function");
-    size_t size = code->parent->function.function.size;
-    ASLoadRegister(file, _v0, code->ret.value);
-    fprintf(file, "    lw      $fp,%lu($sp)\n", size - 8);
-    fprintf(file, "    lw      $ra,%lu($sp)\n", size - 4);
-    fprintf(file, "    addiu   $sp,$sp,%lu\n", size);
-    fprintf(file, "    jr      $ra\n");
+    Assert(frame->size > 0, "code not belong to function");
+    long size = (long)frame->size;
+    ASLoadRegister(out, frame, _v0, code->ret.value);
+    ASStack(out, "lw", "$fp", size - 8, true);
+    ASStack(out, "lw", "$ra", size - 4, true);
+    ASStack(out, "addiu", "$sp", size, false);
+    ASRegisters(out, "jr", "$ra", NULL, NULL);
     break;
   }
   case IR_CODE_ARG: {
-    ASLoadRegister(file, _t0, code->arg.variable);
-    fprintf(file, "    addiu   $sp,$sp,-4\n");
-    fprintf(file, "    sw      %s,0($sp)\n", _t0);
-    pushed += 4;
+    ASLoadRegister(out, frame, _t0, code->arg.variable);
+    ASStack(out, "addiu", "$sp", -4, false);
+    ASStack(out, "sw", _t0, 0, true);
+    frame->pushed += 4;
     break;
   }
-  case IR_CODE_CALL:
-    if (!strcmp(code->call.function.name, "main")) {
-      fprintf(file, "    jal     main\n");
-    } else {
-      fprintf(file, "    jal     func_%s\n", code->call.function.name);
-    }
-    ASSaveRegister(file, _v0, code->call.result);
-    fprintf(file, "    addiu   $sp,$sp,%lu\n", pushed);
-    pushed = 0; // clear pushed arguments size
+  case IR_CODE_CALL: {
+    ASInstruction(out, "jal");
+    ASFunctionName(out, code->call.function.atom);
+    EMChar(out, '\n');
+    ASSaveRegister(out, frame, _v0, code->call.result);
+    ASStack(out, "addiu", "$sp", (long)frame->pushed, false);
+    frame->pushed = 0; // clear pushed arguments size
     break;
+  }
   case IR_CODE_READ:
-    fprintf(file, "    jal     read\n");
-    ASSaveRegister(file, _v0, code->read.variable);
+    ASRegisters(out, "jal", "read", NULL, NULL);
+    ASSaveRegister(out, frame, _v0, code->read.variable);
     break;
   case IR_CODE_WRITE:
-    ASLoadRegister(file, _a0, code->write.variable);
-    fprintf(file, "    jal     write\n");
+    ASLoadRegister(out, frame, _a0, code->write.variable);
+    ASRegisters(out, "jal", "write", NULL, NULL);
     break;
   default:
     break;
@@ -204,114 +275,157 @@ void ASTranslateCode(FILE *file, IRCode *code) {
 }
 
 // Move value between registers.
-void ASMoveRegister(FILE *file, const char *to, const char *from) {
-  fprintf(file, "    move    %s,%s\n", to, from);
+void ASMoveRegister(EMBuffer *out, const char *to, const char *from) {
+  ASRegisters(out, "move", to, from, NULL);
 }
 
 // Load value to register.
-void ASLoadRegister(FILE *file, const char *reg, IROperand var) {
+void ASLoadRegister(EMBuffer *out, const ASFrame *frame, const char *reg, IROperand var) {
   if (var.kind == IR_OP_CONSTANT) {
-    fprintf(file, "    li      %s,%d\n", reg, var.ivalue);
+    ASInstruction(out, "li");
+    EMString(out, reg);
+    EMChar(out, ',');
+    EMInt(out, var.ivalue);
+    EMChar(out, '\n');
   } else {
     // Parameter is stored above $fp.
     // Local variable is stored below $fp.
-    fprintf(file, "    %s      %s,%s%lu($fp)\n", 
-            var.kind == IR_OP_MEMBLOCK ? "la" : "lw",
-            reg, var.offset & _MSB ? "" : "-", var.offset & _MASK);
+    uint32_t offset = ASOffset(frame, var);
+    ASInstruction(out, var.kind == IR_OP_MEMBLOCK ? "la" : "lw");
+    EMString(out, reg);
+    if (offset & _MSB) {
+      EMChar(out, ',');
+    } else {
+      EMLiteral(out, ",-");
+    }
+    EMUnsigned(out, offset & _MASK);
+    EMLiteral(out, "($fp)\n");
   }
 }
 
 // Save value to memory.
-void ASSaveRegister(FILE *file, const char *reg, IROperand var) {
-  fprintf(file, "    sw      %s,-%lu($fp)\n", reg, var.offset);
+void ASSaveRegister(EMBuffer *out, const ASFrame *frame, const char *reg, IROperand var) {
+  ASInstruction(out, "sw");
+  EMString(out, reg);
+  EMLiteral(out, ",-");
+  EMUnsigned(out, ASOffset(frame, var));
+  EMLiteral(out, "($fp)\n");
+}
+
+// Slot of a variable or temp in the table of frame, or the free slot it
+// would take.
+static ASSlot *ASFind(const ASFrame *frame, IROperand op) {
+  size_t mask = frame->capacity - 1;
+  size_t i = (op.number * 0x9e3779b1u + op.kind) & mask;
+  while (frame->slots[i].kind != IR_OP_NULL &&
+         (frame->slots[i].kind != op.kind || frame->slots[i].number != op.number)) {
+    i = (i + 1) & mask;
+  }
+  return &frame->slots[i];
 }
 
 // Prepare function's variables and stack size.
-size_t ASPrepareFunction(IRCode *func, RBNode **root) {
-  if (func == NULL) { 
-    return 0;
+// The table gets room for every operand of the function at half load.
+void ASPrepareFunction(ASFrame *frame, IRCode *func) {
+  Log("prepare function %s", INName(func->function.function.atom));
+  size_t operands = 0;
+  for (IRCode *code = func->next; code != NULL && code->kind != IR_CODE_FUNCTION; code = code->next) {
+    IROperand *ops[IR_MAX_OPERANDS];
+    operands += IRCodeOperands(code, ops);
+  }
+  size_t capacity = 16;
+  while (capacity < operands * 2) capacity *= 2;
+  if (capacity > frame->capacity) {
+    free(frame->slots);
+    frame->slots = (ASSlot *)malloc(sizeof(ASSlot) * capacity);
+    Assert(frame->slots != NULL, "out of memory for frame");
+    frame->capacity = capacity;
   }
+  memset(frame->slots, 0, sizeof(ASSlot) * frame->capacity);
 
-  Log("prepare function %s", func->function.function.name);
   size_t size = 8; // 4 for $ra, 4 for $fp
   size_t args = 0;
   for (IRCode *code = func->next; code != NULL && code->kind != IR_CODE_FUNCTION; code = code->next) {
-    code->parent = func;
     switch (code->kind) {
     case IR_CODE_ASSIGN:
-      size += ASRegisterVariable(&code->assign.left, root, size);
-      size += ASRegisterVariable(&code->assign.right, root, size);
+      size += ASRegisterVariable(frame, code->assign.left, 4, size);
+      size += ASRegisterVariable(frame, code->assign.right, 4, size);
       break;
     case IR_CODE_ADD:
     case IR_CODE_SUB:
     case IR_CODE_MUL:
     case IR_CODE_DIV:
-      size += ASRegisterVariable(&code->binop.result, root, size);
-      size += ASRegisterVariable(&code->binop.op1, root, size);
-      size += ASRegisterVariable(&code->binop.op2, root, size);
+      size += ASRegisterVariable(frame, code->binop.result, 4, size);
+      size += ASRegisterVariable(frame, code->binop.op1, 4, size);
+      size += ASRegisterVariable(frame, code->binop.op2, 4, size);
       break;
     case IR_CODE_LOAD:
-      size += ASRegisterVariable(&code->load.left, root, size);
-      size += ASRegisterVariable(&code->load.right, root, size);
+      size += ASRegisterVariable(frame, code->load.left, 4, size);
+      size += ASRegisterVariable(frame, code->load.right, 4, size);
       break;
     case IR_CODE_SAVE:
-      size += ASRegisterVariable(&code->save.left, root, size);
-      size += ASRegisterVariable(&code->save.right, root, size);
+      size += ASRegisterVariable(frame, code->save.left, 4, size);
+      size += ASRegisterVariable(frame, code->save.right, 4, size);
       break;
     case IR_CODE_JUMP_COND:
-      size += ASRegisterVariable(&code->jump_cond.op1, root, size);
-      size += ASRegisterVariable(&code->jump_cond.op2, root, size);
+      size += ASRegisterVariable(frame, code->jump_cond.op1, 4, size);
+      size += ASRegisterVariable(frame, code->jump_cond.op2, 4, size);
       break;
     case IR_CODE_RETURN:
-      size += ASRegisterVariable(&code->ret.value, root, size);
+      size += ASRegisterVariable(frame, code->ret.value, 4, size);
       break;
     case IR_CODE_DEC:
-      size += ASRegisterVariable(&code->dec.variable, root, size);
+      // The DEC of a memblock comes before its uses and gives its size.
+      size += ASRegisterVariable(frame, code->dec.variable, code->dec.size.ivalue, size);
       break;
     case IR_CODE_ARG:
-      size += ASRegisterVariable(&code->arg.variable, root, size);
+      size += ASRegisterVariable(frame, code->arg.variable, 4, size);
       break;
     case IR_CODE_CALL:
-      size += ASRegisterVariable(&code->call.result, root, size);
+      size += ASRegisterVariable(frame, code->call.result, 4, size);
       break;
-    case IR_CODE_PARAM:
+    case IR_CODE_PARAM: {
       // Register the variable only.
       // Arguments are stored in a differenct direction.
-      ASRegisterVariable(&code->param.variable, root, 0);
-      code->param.variable.offset = _MSB | args;
+      ASSlot *slot = ASFind(frame, code->param.variable);
+      if (slot->kind == IR_OP_NULL) {
+        slot->kind = code->param.variable.kind;
+        slot->number = code->param.variable.number;
+        slot->offset = _MSB | args;
+      }
       args += 4; // pass by reference
-      Log("transformed to param, real offset %lu", code->param.variable.offset & _MASK);
+      Log("transformed to param, real offset %u", slot->offset & _MASK);
       break;
+    }
     case IR_CODE_READ:
-      size += ASRegisterVariable(&code->read.variable, root, size);
+      size += ASRegisterVariable(frame, code->read.variable, 4, size);
       break;
     case IR_CODE_WRITE:
-      size += ASRegisterVariable(&code->write.variable, root, size);
+      size += ASRegisterVariable(frame, code->write.variable, 4, size);
       break;
     default:
       break;
     }
   }
-  return size;
+  frame->size = size;
 }
 
-// Register a new local variable and allocate it on memory.
-size_t ASRegisterVariable(IROperand *op, RBNode **root, size_t offset) {
-  switch (op->kind) {
+// Register a new local variable of size bytes and allocate it on memory
+// at offset. Return the size allocated, 0 if it is known already.
+size_t ASRegisterVariable(ASFrame *frame, IROperand op, size_t size, size_t offset) {
+  switch (op.kind) {
     case IR_OP_TEMP:
     case IR_OP_VARIABLE:
     case IR_OP_VADDRESS:
     case IR_OP_MEMBLOCK: {
-      if (!RBContains(root, op, ASComp)) {
-        op->offset = offset + op->size;
-        RBInsert(root, op, ASComp);
-        Log("new variable %s%d, size %lu, offset %lu", op->kind == IR_OP_TEMP ? "t" : "v",
-                                                       op->number, op->size, op->offset);
-        return op->size;
-      } else {
-        RBNode *node = RBSearch(root, op, ASComp);
-        Assert(node != NULL && node->value != NULL, "bad data in RB tree");
-        op->offset = ((const IROperand *)node->value)->offset;
+      ASSlot *slot = ASFind(frame, op);
+      if (slot->kind == IR_OP_NULL) {
+        slot->kind = op.kind;
+        slot->number = op.number;
+        slot->offset = (uint32_t)(offset + size);
+        Log("new variable %s%d, size %zu, offset %u", op.kind == IR_OP_TEMP ? "t" : "v",
+                                                      op.number, size, slot->offset);
+        return size;
       }
       break;
     }
@@ -321,14 +435,10 @@ size_t ASRegisterVariable(IROperand *op, RBNode **root, size_t offset) {
   return 0;
 }
 
-int ASComp(const void *a, const void *b) {
-  const IROperand *op1 = (const IROperand *)a;
-  const IROperand *op2 = (const IROperand *)b;
-  if (op1->kind < op2->kind) {
-    return -1;
-  } else if (op1->kind > op2->kind) {
-    return 1;
-  } else {
-    return op1->number - op2->number;
-  }
+// Offset of a variable or temp from $fp, see _MSB.
+uint32_t ASOffset(const ASFrame *frame, IROperand op) {
+  Assert(frame->capacity > 0, "code not belong to function");
+  const ASSlot *slot = ASFind(frame, op);
+  Assert(slot->kind != IR_OP_NULL, "variable not in frame");
+  return slot->offset;
 }
@@ -1,7 +1,9 @@
 #ifndef ASM_H
 #define ASM_H
 
+#include <stdint.h>
 #include "ir.h"
+#include "emit.h"
 
 extern const char *registers[];
 #define _zero registers[0]
@@ -19,18 +21,35 @@ extern const char *registers[];
 #define _MSB  0x80000000 // used to mark a positive offset
 #define _MASK 0x7fffffff // get the absolute offset from $fp
 
-void assemble(FILE *file);
-
-void ASTranslateList(FILE *file, IRCodeList list);
-void ASTranslateCode(FILE *file, IRCode *code);
-
-void ASMoveRegister(FILE *file, const char *to, const char *from);
-void ASLoadRegister(FILE *file, const char *reg, IROperand var);
-void ASSaveRegister(FILE *file, const char *reg, IROperand var);
-
-size_t ASPrepareFunction(IRCode *func, RBNode **root);
-size_t ASRegisterVariable(IROperand *op, RBNode **root, size_t offset);
-
-int ASComp(const void *a, const void *b);
+// Place of a variable or temp in the frame, see ASFrame.
+typedef struct ASSlot {
+  unsigned int number;
+  enum IROperandType kind; // IR_OP_NULL if the slot is free
+  uint32_t offset;
+} ASSlot;
+
+// The function being translated: its frame and the offset of every
+// variable and temp in it, in an open-addressing table by kind and number.
+// The table is built once for each function and reused for the next one.
+typedef struct ASFrame {
+  size_t size;   // of the frame
+  size_t pushed; // size of pushed values
+  ASSlot *slots;
+  size_t capacity; // a power of 2
+} ASFrame;
+
+void assemble(FILE *file, IRCodeList list);
+
+void ASTranslateHeader(FILE *file);
+void ASTranslateList(EMBuffer *out, IRCodeList list);
+void ASTranslateCode(EMBuffer *out, ASFrame *frame, IRCode *code);
+
+void ASMoveRegister(EMBuffer *out, const char *to, const char *from);
+void ASLoadRegister(EMBuffer *out, const ASFrame *frame, const char *reg, IROperand var);
+void ASSaveRegister(EMBuffer *out, const ASFrame *frame, const char *reg, IROperand var);
+
+void ASPrepareFunction(ASFrame *frame, IRCode *func);
+size_t ASRegisterVariable(ASFrame *frame, IROperand op, size_t size, size_t offset);
+uint32_t ASOffset(const ASFrame *frame, IROperand op);
 
 #endif
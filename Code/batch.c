@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L // pthreads, clock_gettime, strerror_r
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "compiler.h"
+#include "debug.h"
+#include "source.h"
+
+typedef struct BAWorker {
+  pthread_t thread;
+  struct BABatch *batch;
+  CCContext *ctx;
+  pthread_mutex_t lock; // guards the run
+  size_t next, end;     // the run of sources left, [next, end)
+} BAWorker;
+
+typedef struct BABatch {
+  BAFile *files;
+  size_t count, capacity;
+  BAWorker *workers;
+  int workerCount;
+} BABatch;
+
+static double BANow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Add a source and its output to the batch.
+static void BAAdd(BABatch *batch, const char *source, const char *output) {
+  if (batch->count == batch->capacity) {
+    batch->capacity = batch->capacity ? batch->capacity * 2 : 64;
+    batch->files = (BAFile *)realloc(batch->files, sizeof(BAFile) * batch->capacity);
+    Assert(batch->files != NULL, "out of memory for batch");
+  }
+  batch->files[batch->count++] = (BAFile){ source, output, 0, 0, 0, 0, NULL, 0 };
+}
+
+// Add every `source output` line of a manifest, which must stay alive.
+static bool BAAddManifest(BABatch *batch, SRSource *manifest, const char *path) {
+  const char *delim = " \t\r\n";
+  char *save = NULL;
+  for (char *line = strtok_r(manifest->base, "\n", &save); line != NULL;
+       line = strtok_r(NULL, "\n", &save)) {
+    char *inner = NULL;
+    char *source = strtok_r(line, delim, &inner);
+    if (source == NULL) continue; // blank line
+    char *output = strtok_r(NULL, delim, &inner);
+    if (output == NULL) {
+      fprintf(stderr, "%s: no output file for %s\n", path, source);
+      return false;
+    }
+    BAAdd(batch, source, output);
+  }
+  return true;
+}
+
+// Record an error which stops a source from being compiled.
+static void BAFail(BAFile *file, const char *path, int error) {
+  char reason[256];
+  strerror_r(error, reason, sizeof(reason));
+  file->status = 2;
+  file->errorsSize = (size_t)snprintf(NULL, 0, "%s: %s\n", path, reason);
+  file->errors = (char *)malloc(file->errorsSize + 1);
+  Assert(file->errors != NULL, "out of memory for errors");
+  snprintf(file->errors, file->errorsSize + 1, "%s: %s\n", path, reason);
+}
+
+// Compile one source of the batch, like the parser would on its own.
+static void BACompile(CCContext *ctx, BAFile *file) {
+  double start = BANow();
+  SRSource source = {NULL, 0, 0};
+  FILE *fout = NULL;
+  if (!(SRMMAP && SRMap(file->source, &source)) && !SRRead(file->source, &source)) {
+    BAFail(file, file->source, errno);
+  } else if ((fout = fopen(file->output, "w+")) == NULL) {
+    BAFail(file, file->output, errno);
+  } else {
+    file->status = CCCompileBuffer(ctx, source.base, source.size, fout);
+    file->errors = (char *)malloc(ctx->errorsSize + 1);
+    Assert(file->errors != NULL, "out of memory for errors");
+    memcpy(file->errors, ctx->errors, ctx->errorsSize);
+    file->errorsSize = ctx->errorsSize;
+    file->cacheHits = ctx->cacheHits;
+    file->cacheMisses = ctx->cacheMisses;
+    if (file->status != CC_OK) {
+      fout = freopen(file->output, "w", fout); // drop what has been written
+    }
+  }
+  if (fout != NULL) fclose(fout);
+  SRRelease(&source);
+  file->seconds = BANow() - start;
+}
+
+// Move the back half of the longest run left to the run of a worker.
+// Return false if there is nothing left to steal.
+static bool BASteal(BAWorker *self) {
+  BABatch *batch = self->batch;
+  BAWorker *victim = NULL;
+  size_t longest = 1; // a single source is left to its worker
+  for (int i = 0; i < batch->workerCount; ++i) {
+    BAWorker *worker = &batch->workers[i];
+    pthread_mutex_lock(&worker->lock);
+    size_t left = worker->end - worker->next;
+    pthread_mutex_unlock(&worker->lock);
+    if (left > longest) {
+      victim = worker;
+      longest = left;
+    }
+  }
+  if (victim == NULL) return false;
+  pthread_mutex_lock(&victim->lock);
+  size_t half = (victim->end - victim->next) / 2; // may have shrunk meanwhile
+  size_t end = victim->end;
+  victim->end -= half;
+  pthread_mutex_unlock(&victim->lock);
+  pthread_mutex_lock(&self->lock);
+  self->next = end - half;
+  self->end = end;
+  pthread_mutex_unlock(&self->lock);
+  return true;
+}
+
+// Compile the sources of the own run, then steal from the others.
+static void *BALoop(void *arg) {
+  BAWorker *self = (BAWorker *)arg;
+  for (;;) {
+    pthread_mutex_lock(&self->lock);
+    bool any = self->next < self->end;
+    size_t index = self->next;
+    if (any) ++self->next;
+    pthread_mutex_unlock(&self->lock);
+    if (any) {
+      BACompile(self->ctx, &self->batch->files[index]);
+    } else if (!BASteal(self)) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+// Print the diagnostics of every source, then a summary of the batch.
+static int BAReport(BABatch *batch, int workers, double seconds, bool cache) {
+  int worst = 0;
+  size_t failed = 0, hits = 0, misses = 0;
+  for (size_t i = 0; i < batch->count; ++i) {
+    BAFile *file = &batch->files[i];
+    for (char *line = file->errors, *end = file->errors + file->errorsSize; line < end;) {
+      char *next = memchr(line, '\n', end - line);
+      next = next != NULL ? next + 1 : end;
+      fprintf(stderr, "%s: %.*s", file->source, (int)(next - line), line);
+      line = next;
+    }
+  }
+  printf("%6s %10s", "status", "ms");
+  if (cache) printf(" %6s %6s", "hits", "misses");
+  printf("  %s\n", "source");
+  for (size_t i = 0; i < batch->count; ++i) {
+    BAFile *file = &batch->files[i];
+    if (file->status != 0) {
+      printf("%6d %10.3f", file->status, file->seconds * 1e3);
+      ++failed;
+    } else {
+      printf("%6s %10.3f", "ok", file->seconds * 1e3);
+    }
+    if (cache) printf(" %6zu %6zu", file->cacheHits, file->cacheMisses);
+    printf("  %s\n", file->source);
+    if (file->status > worst) worst = file->status;
+    hits += file->cacheHits;
+    misses += file->cacheMisses;
+  }
+  printf("%zu sources, %zu ok, %zu failed in %.3f s on %d workers: %.1f sources/s\n",
+         batch->count, batch->count - failed, failed, seconds, workers,
+         seconds > 0 ? batch->count / seconds : 0.0);
+  if (cache) printf("code cache: %zu hits, %zu misses\n", hits, misses);
+  return worst;
+}
+
+// Compile every `source output` pair and @manifest in args on workers
+// (0: one for each processor), with a code cache unless it is NULL.
+// Return the worst status of all sources.
+int BARun(int argc, char *argv[], int workers, const char *cache) {
+  BABatch batch = { NULL, 0, 0, NULL, 0 };
+  SRSource *manifests = (SRSource *)calloc(argc, sizeof(SRSource));
+  Assert(manifests != NULL, "out of memory for batch");
+  int status = 0;
+  for (int i = 0; i < argc && status == 0; ++i) {
+    if (argv[i][0] == BA_MANIFEST) {
+      const char *path = argv[i] + 1;
+      if (!SRRead(path, &manifests[i])) {
+        perror(path);
+        status = 2;
+      } else if (!BAAddManifest(&batch, &manifests[i], path)) {
+        status = 1;
+      }
+    } else if (i + 1 < argc) {
+      BAAdd(&batch, argv[i], argv[i + 1]);
+      ++i;
+    } else {
+      fprintf(stderr, "%s: no output file\n", argv[i]);
+      status = 1;
+    }
+  }
+
+  if (status == 0) {
+    if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ((size_t)workers > batch.count) workers = (int)batch.count;
+    if (workers <= 0) workers = 1;
+    batch.workers = (BAWorker *)calloc(workers, sizeof(BAWorker));
+    Assert(batch.workers != NULL, "out of memory for batch");
+    batch.workerCount = workers;
+    double start = BANow();
+    for (int i = 0; i < workers; ++i) {
+      BAWorker *worker = &batch.workers[i];
+      worker->batch = &batch;
+      worker->ctx = CCNew(0); // the batch keeps the processors busy already
+      worker->ctx->cache = cache;
+      pthread_mutex_init(&worker->lock, NULL);
+      worker->next = batch.count * i / workers;
+      worker->end = batch.count * (i + 1) / workers;
+    }
+    int started = 0;
+    for (; started < workers; ++started) {
+      if (pthread_create(&batch.workers[started].thread, NULL, BALoop, &batch.workers[started]) != 0) break;
+    }
+    if (started == 0) BALoop(&batch.workers[0]); // the others are stolen from
+    for (int i = 0; i < started; ++i) {
+      pthread_join(batch.workers[i].thread, NULL);
+    }
+    status = BAReport(&batch, workers, BANow() - start, cache != NULL);
+    for (int i = 0; i < workers; ++i) {
+      CCFree(batch.workers[i].ctx);
+      pthread_mutex_destroy(&batch.workers[i].lock);
+    }
+  }
+
+  for (size_t i = 0; i < batch.count; ++i) {
+    free(batch.files[i].errors);
+  }
+  for (int i = 0; i < argc; ++i) {
+    SRRelease(&manifests[i]);
+  }
+  free(manifests);
+  free(batch.files);
+  free(batch.workers);
+  return status;
+}
@@ -0,0 +1,31 @@
+/**
+ * The batch mode: compile many sources in one process.
+ * Every worker thread has a compiler context of its own, which is reused
+ * (with its arenas) for all the sources it compiles. The sources are
+ * dealt out to the workers in equal runs up front; a worker takes the
+ * next source from the front of its own run, and once its run is empty
+ * it steals the back half of the longest run left, so the workers stay
+ * busy however uneven the sources are.
+ * The diagnostics and a summary of every source are printed at the end,
+ * in the order the sources were given.
+ * */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#define BA_MANIFEST '@' // <- prefix of a manifest file, one `source output` per line
+
+typedef struct BAFile {
+  const char *source, *output;
+  int status;     // exit status of the parser for this source alone
+  double seconds;
+  size_t cacheHits, cacheMisses;
+  char *errors;   // diagnostics
+  size_t errorsSize;
+} BAFile;
+
+int BARun(int argc, char *argv[], int workers, const char *cache);
+
+#endif // BATCH_H
@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L // mkstemp
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "intern.h"
+#include "debug.h"
+
+// Add a value to both halves of the key, which are mixed differently.
+static void CAMix(CAKey *key, uint64_t value) {
+  key->hi = (key->hi ^ value) * 0x100000001b3ull; // FNV-1a
+  key->lo = (key->lo + value) * 0x9e3779b97f4a7c15ull;
+  key->lo ^= key->lo >> 29;
+}
+
+// Spread every bit of a half over all of its bits (splitmix64).
+static uint64_t CAFinish(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+static void CAMixString(CAKey *key, const char *s) {
+  size_t length = strlen(s);
+  CAMix(key, length);
+  for (size_t i = 0; i < length; i += 8) {
+    uint64_t word = 0;
+    memcpy(&word, s + i, length - i < 8 ? length - i : 8);
+    CAMix(key, word);
+  }
+}
+
+// Numbers are hashed relative to the first ones of the function.
+// Only the fields the back end reads are hashed, the others may be unset.
+static void CAMixOperand(CAKey *key, const IROperand *op, IRState base) {
+  CAMix(key, op->kind);
+  switch (op->kind) {
+  case IR_OP_TEMP:
+    CAMix(key, op->number - base.temps);
+    break;
+  case IR_OP_LABEL:
+    CAMix(key, op->number - base.labels);
+    break;
+  case IR_OP_VARIABLE:
+  case IR_OP_VADDRESS:
+  case IR_OP_MEMBLOCK:
+    CAMix(key, op->number - base.variables);
+    break;
+  case IR_OP_CONSTANT:
+    CAMix(key, (uint32_t)op->ivalue);
+    break;
+  case IR_OP_RELOP:
+    CAMix(key, op->relop);
+    break;
+  case IR_OP_FUNCTION:
+    CAMixString(key, INName(op->atom));
+    break;
+  default:
+    break;
+  }
+}
+
+// Hash the IR of a function. base holds the numbers of the compilation
+// before the function was translated.
+CAKey CAHashList(IRCodeList list, IRState base) {
+  CAKey key = { 0xcbf29ce484222325ull, CA_FORMAT };
+  for (IRCode *code = list.head; code != NULL; code = code->next) {
+    CAMix(&key, code->kind);
+    IROperand *ops[IR_MAX_OPERANDS];
+    size_t count = IRCodeOperands(code, ops);
+    for (size_t i = 0; i < count; ++i) {
+      CAMixOperand(&key, ops[i], base);
+    }
+  }
+  key.hi = CAFinish(key.hi);
+  key.lo = CAFinish(key.lo);
+  return key;
+}
+
+// Copy assembly to out, adding delta to the number of every label.
+// Labels are `labelN` after a space, a comma or at the start of a line;
+// function names always start with `func_`.
+static void CARebase(EMBuffer *out, const char *text, size_t size, long delta) {
+  const char *end = text + size, *copied = text;
+  for (const char *p = text; p + 5 < end; ++p) {
+    if (p[0] != 'l' || memcmp(p, "label", 5) != 0 ||
+        (p > text && p[-1] != ' ' && p[-1] != ',' && p[-1] != '\n') ||
+        p[5] < '0' || p[5] > '9') {
+      continue;
+    }
+    long number = 0;
+    const char *digit = p + 5;
+    while (digit < end && *digit >= '0' && *digit <= '9') {
+      number = number * 10 + (*digit++ - '0');
+    }
+    EMChars(out, copied, p - copied);
+    EMLiteral(out, "label");
+    EMInt(out, number + delta);
+    copied = digit;
+    p = digit - 1;
+  }
+  EMChars(out, copied, end - copied);
+}
+
+// Path of the entry of a key, to be freed.
+static char *CAPath(const char *dir, CAKey key) {
+  size_t length = strlen(dir) + 1 + 32 + 3;
+  char *path = (char *)malloc(length);
+  Assert(path != NULL, "out of memory for cache path");
+  snprintf(path, length, "%s/%016llx%016llx.s", dir,
+           (unsigned long long)key.hi, (unsigned long long)key.lo);
+  return path;
+}
+
+// Write the cached assembly of a key to out, with labels numbered from
+// labels + 1. Return false if it is not cached.
+bool CALoad(const char *dir, CAKey key, unsigned int labels, EMBuffer *out) {
+  char *path = CAPath(dir, key);
+  FILE *file = fopen(path, "r");
+  free(path);
+  if (file == NULL) return false;
+  char *text = NULL;
+  size_t size = 0, capacity = 0, count;
+  do {
+    if (capacity - size < 4096) {
+      capacity = capacity ? capacity * 2 : 8192;
+      text = (char *)realloc(text, capacity);
+      Assert(text != NULL, "out of memory for cached code");
+    }
+    count = fread(text + size, 1, capacity - size, file);
+    size += count;
+  } while (count > 0);
+  bool ok = !ferror(file);
+  fclose(file);
+  if (ok) CARebase(out, text, size, labels);
+  free(text);
+  return ok;
+}
+
+// Cache the assembly of a key, whose labels are numbered from labels + 1.
+// The cache is best effort, entries which cannot be written are dropped.
+void CAStore(const char *dir, CAKey key, unsigned int labels, const char *text, size_t size) {
+  if (mkdir(dir, 0777) < 0 && errno != EEXIST) return;
+  size_t length = strlen(dir) + sizeof("/.tmp-XXXXXX");
+  char *temp = (char *)malloc(length);
+  Assert(temp != NULL, "out of memory for cache path");
+  snprintf(temp, length, "%s/.tmp-XXXXXX", dir);
+  int fd = mkstemp(temp);
+  FILE *file = fd < 0 ? NULL : fdopen(fd, "w");
+  if (file == NULL) {
+    if (fd >= 0) {
+      close(fd);
+      unlink(temp);
+    }
+    free(temp);
+    return;
+  }
+  EMBuffer out;
+  EMOpen(&out, file);
+  CARebase(&out, text, size, -(long)labels);
+  EMClose(&out);
+  char *path = CAPath(dir, key);
+  if (fclose(file) != 0 || rename(temp, path) < 0) {
+    unlink(temp);
+  }
+  free(path);
+  free(temp);
+}
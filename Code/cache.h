@@ -0,0 +1,37 @@
+/**
+ * The on-disk code cache of the back end.
+ * The optimizer and the assembler see nothing but the IR of a function,
+ * so its assembly is a function of that IR alone. The IR is hashed with
+ * its temps, labels and variables numbered from the start of the function
+ * (the tokens, the signatures it calls and the layouts of the structures
+ * it uses all end up in the IR), and the optimized assembly is kept in a
+ * file of the cache directory named after the hash.
+ * Label numbers are the only numbers of the IR left in the assembly, they
+ * are stored relative to the function as well, so a function which moves
+ * around in the source still hits.
+ * Entries are written to a temporary file and renamed, so any number of
+ * compilations can share a cache directory. Nothing is ever evicted.
+ * */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ir.h"
+#include "emit.h"
+
+#define CA_FORMAT 1 // <- bump whenever the back end changes its output
+#define CA_ENABLED !IRDebug // the IR comments of the debug output hold absolute numbers
+
+typedef struct CAKey {
+  uint64_t hi, lo;
+} CAKey;
+
+CAKey CAHashList(IRCodeList list, IRState base);
+bool CALoad(const char *dir, CAKey key, unsigned int labels, EMBuffer *out);
+void CAStore(const char *dir, CAKey key, unsigned int labels, const char *text, size_t size);
+
+#endif // CACHE_H
@@ -0,0 +1,358 @@
+#define _POSIX_C_SOURCE 200809L // open_memstream
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "arena.h"
+#include "asm.h"
+#include "cache.h"
+#include "compiler.h"
+#include "debug.h"
+#include "intern.h"
+#include "ir.h"
+#include "opt.h"
+#include "semantics.h"
+#include "tree.h"
+#include "worker.h"
+
+#define STREAM true // <- per-function pipeline switch (false: whole program at once)
+
+extern int yyparse_wrap(CCContext *ctx, const char *source, char *buffer, size_t size); // defined in syntax.y
+
+// The shared tables are prepared for the first context.
+static pthread_mutex_t CCLock = PTHREAD_MUTEX_INITIALIZER;
+static bool CCReady = false;
+#if !CCREENTRANT
+static pthread_mutex_t CCTurn = PTHREAD_MUTEX_INITIALIZER; // held while compiling
+#endif
+
+// The back end of an ExtDef, run on a worker.
+typedef struct BackJob {
+  WKJob job;
+  CCContext *ctx;
+  IRCodeList list;
+  IRStore store; // codes of the list
+  IRState base;  // numbers before the list was translated
+  bool hit;     // found in the code cache
+  char *text;   // assembly of the list
+  size_t size;
+} BackJob;
+
+// Directory of the code cache the back end uses, NULL: none.
+// Only optimized assembly is cached.
+static const char *cacheOf(CCContext *ctx) {
+  return CA_ENABLED && !ctx->unoptimized && ctx->image == IM_NONE ? ctx->cache : NULL;
+}
+
+// Optimize and assemble the IR of a job into memory, then free the IR.
+// The IR is laid out in its order first, so the passes scan it linearly.
+// With a code cache, the assembly is taken from it if it is there.
+// With an image, the IR is only optimized, it is written out in order.
+static void runBackJob(WKJob *job) {
+  BackJob *back = (BackJob *)job;
+  const char *cache = cacheOf(back->ctx);
+  CAKey key = { 0, 0 };
+  back->list = IRCompact(&back->store, back->list);
+  if (back->ctx->image != IM_NONE) {
+    if (!back->ctx->unoptimized) {
+      OCContext ctx = OC_CONTEXT_INIT;
+      back->list = OCOptimize(&ctx, back->list);
+    }
+    return;
+  }
+  EMBuffer out;
+  EMOpen(&out, NULL); // the text of the job
+  if (cache != NULL) {
+    key = CAHashList(back->list, back->base);
+    back->hit = CALoad(cache, key, back->base.labels, &out);
+  }
+  if (!back->hit) {
+    if (!back->ctx->unoptimized) {
+      OCContext ctx = OC_CONTEXT_INIT;
+      back->list = OCOptimize(&ctx, back->list);
+    }
+    ASTranslateList(&out, back->list);
+  }
+  back->text = out.data;
+  back->size = out.size;
+  if (cache != NULL && !back->hit) {
+    CAStore(cache, key, back->base.labels, back->text, back->size);
+  }
+  IRFreeStore(&back->store);
+}
+
+// Write the assembly or the IR of a job out, in the order of the source.
+static void retireBackJob(WKJob *job) {
+  BackJob *back = (BackJob *)job;
+  if (back->ctx->image != IM_NONE) {
+    IMWriteList(&back->ctx->writer, back->list);
+    IRFreeStore(&back->store);
+    free(back);
+    return;
+  }
+  if (cacheOf(back->ctx) != NULL) {
+    ++*(back->hit ? &back->ctx->cacheHits : &back->ctx->cacheMisses);
+  }
+  if (back->size > 0) fwrite(back->text, 1, back->size, back->ctx->out);
+  free(back->text);
+  free(back);
+}
+
+// Hand the IR of a function and its store to the back end, which frees
+// them afterwards.
+static void submitBackJob(CCContext *ctx, IRCodeList list, IRStore store, IRState base) {
+  BackJob *back = (BackJob *)malloc(sizeof(BackJob));
+  Assert(back != NULL, "out of memory for back end");
+  back->job.run = runBackJob;
+  back->job.retire = retireBackJob;
+  back->ctx = ctx;
+  back->list = list;
+  back->store = store;
+  back->base = base;
+  back->hit = false;
+  WKSubmit(&ctx->workers, &back->job);
+}
+
+// Compile an ExtDef as soon as it is parsed: check and translate it,
+// then hand its IR to the back end, or write it to the image.
+// Once there is an error, the output is dropped in the end anyway.
+static void compileExtDef(CCContext *ctx, STNode *edef) {
+  IRState base = ctx->ir;
+  semanticExtDef(ctx, edef);
+  if (ctx->hasErrorS || ctx->irlist.head == NULL) {
+    IRFreeStore(&ctx->irstore);
+  } else if (ctx->image != IM_NONE) {
+    IMWriteList(&ctx->writer, ctx->irlist);
+    IRFreeStore(&ctx->irstore);
+  } else {
+    submitBackJob(ctx, ctx->irlist, ctx->irstore, base);
+    ctx->irstore = (IRStore)IR_STORE_INIT; // the next ExtDef gets a store of its own
+  }
+  ctx->irlist = STATIC_EMPTY_IR_LIST;
+}
+
+// Status of a compilation which got through the semantic pass.
+static enum CCStatus semanticStatus(CCContext *ctx) {
+  if (!ctx->hasErrorS) return CC_OK;
+  return ctx->hasErrorT ? CC_ERROR_TRANSLATE : CC_ERROR_SEMANTICS;
+}
+
+// Run the steps of a compilation, return how it ended.
+// The source is scanned in place if buffer is not NULL, see CCCompileBuffer.
+static enum CCStatus CCRun(CCContext *ctx, const char *source, char *buffer, size_t size) {
+  // Step 1: call yyparse to get syntax tree, chunks of it on the workers.
+  // With STREAM, steps 2 to 5 run for each ExtDef as soon as it is parsed.
+  // Semantic errors are held back, syntax errors later on win over them.
+#if STREAM
+  semanticPrepare(ctx);
+  holdErrorsS(ctx);
+  if (ctx->image == IM_NONE) ASTranslateHeader(ctx->out);
+  ctx->hook = compileExtDef;
+#endif
+  yyparse_wrap(ctx, source, buffer, size);
+  WKDrain(&ctx->workers);
+  if (ctx->hasErrorA || ctx->hasErrorB) {
+#if STREAM
+    semanticFinish(ctx);
+    releaseErrorsS(ctx, false);
+#endif
+    return CC_ERROR_SYNTAX;
+  }
+  // printSyntaxTree(ctx->root);
+#if STREAM
+  releaseErrorsS(ctx, true);
+  semanticFinish(ctx);
+  return semanticStatus(ctx);
+#else
+  // Step 2: conduct a full semantic scan.
+  // Step 3: translate to IR during the scan.
+  semanticScan(ctx);
+  if (ctx->hasErrorS) {
+    return semanticStatus(ctx);
+  }
+  if (ctx->image != IM_NONE) {
+    IMWriteList(&ctx->writer, ctx->irlist);
+    return CC_OK;
+  }
+
+  // Step 4: do IR optimization.
+  ctx->irlist = IRCompact(&ctx->irstore, ctx->irlist);
+  ctx->irlist = optimize(ctx->irlist);
+  //for (IRCode *code = ctx->irlist.head; code != NULL; code = code->next) {
+  //  IRWriteCode(ctx->out, code);
+  //}
+
+  // Step 5: translate to ASM and output.
+  assemble(ctx->out, ctx->irlist);
+  return CC_OK;
+#endif
+}
+
+// Create a context, with workers for the back end (0: none).
+CCContext *CCNew(int workers) {
+  pthread_mutex_lock(&CCLock);
+  if (!CCReady) {
+    INPrepare();
+    CCReady = true;
+  }
+  pthread_mutex_unlock(&CCLock);
+  CCContext *ctx = (CCContext *)calloc(1, sizeof(CCContext));
+  Assert(ctx != NULL, "out of memory for context");
+  WKStart(&ctx->workers, workers, WKDEPTH);
+  return ctx;
+}
+
+static enum CCStatus CCCompileIn(CCContext *ctx, const char *source, char *buffer, size_t size,
+                                 FILE *out) {
+#if !CCREENTRANT
+  pthread_mutex_lock(&CCTurn);
+#endif
+  free(ctx->output);
+  free(ctx->errors);
+  ctx->output = NULL;
+  ctx->outputSize = 0;
+  ctx->out = out != NULL ? out : open_memstream(&ctx->output, &ctx->outputSize);
+  ctx->err = open_memstream(&ctx->errors, &ctx->errorsSize);
+  Assert(ctx->out != NULL && ctx->err != NULL, "out of memory for output");
+  ctx->cacheHits = ctx->cacheMisses = 0;
+  ctx->errLineno = 0;
+  ctx->hasErrorA = ctx->hasErrorB = ctx->hasErrorS = ctx->hasErrorT = false;
+  ctx->root = NULL;
+  ctx->hook = NULL;
+  ctx->ir = (IRState){ 0, 0, 0 };
+  ctx->irlist = STATIC_EMPTY_IR_LIST;
+
+  if (ctx->image != IM_NONE) IMBegin(&ctx->writer, ctx->out, ctx->image);
+  enum CCStatus status = CCRun(ctx, source, buffer, size);
+  if (ctx->image != IM_NONE) IMEnd(&ctx->writer);
+
+  // do not teardown until all work is done!
+  IRFreeStore(&ctx->irstore);
+  ctx->irlist = STATIC_EMPTY_IR_LIST;
+  STFreePool(&ctx->pool);
+  STFreePool(&ctx->kept);
+  ctx->root = NULL;
+  if (out == NULL) fclose(ctx->out);
+  fclose(ctx->err);
+  ctx->out = ctx->err = NULL;
+  if (status != CC_OK && out == NULL) {
+    ctx->output[0] = '\0'; // drop what has been written
+    ctx->outputSize = 0;
+  }
+#if !CCREENTRANT
+  pthread_mutex_unlock(&CCTurn);
+#endif
+  return status;
+}
+
+// Compile source[0..size) to out, or into ctx->output if out is NULL.
+// The diagnostics go to ctx->errors. The scanner works on a copy.
+enum CCStatus CCCompile(CCContext *ctx, const char *source, size_t size, FILE *out) {
+  return CCCompileIn(ctx, source, NULL, size, out);
+}
+
+// Compile buffer[0..size) like CCCompile, without copying it: buffer[size]
+// and buffer[size + 1] must be '\0' (see SRSource), and the scanner writes
+// to the buffer while it runs.
+enum CCStatus CCCompileBuffer(CCContext *ctx, char *buffer, size_t size, FILE *out) {
+  return CCCompileIn(ctx, buffer, buffer, size, out);
+}
+
+// Numbers of the compilation before the IR of a function was translated,
+// as far as they can be told from the IR: the first ones it uses, less one.
+static IRState baseOf(IRCodeList list) {
+  IRState first = { UINT_MAX, UINT_MAX, UINT_MAX };
+  for (IRCode *code = list.head; code != NULL; code = code->next) {
+    IROperand *ops[IR_MAX_OPERANDS];
+    size_t count = IRCodeOperands(code, ops);
+    for (size_t i = 0; i < count; ++i) {
+      unsigned int *number = NULL;
+      switch (ops[i]->kind) {
+      case IR_OP_TEMP:
+        number = &first.temps;
+        break;
+      case IR_OP_LABEL:
+        number = &first.labels;
+        break;
+      case IR_OP_VARIABLE:
+      case IR_OP_VADDRESS:
+      case IR_OP_MEMBLOCK:
+        number = &first.variables;
+        break;
+      default:
+        break;
+      }
+      if (number != NULL && ops[i]->number <= *number) *number = ops[i]->number - 1;
+    }
+  }
+  if (first.temps == UINT_MAX) first.temps = 0;
+  if (first.labels == UINT_MAX) first.labels = 0;
+  if (first.variables == UINT_MAX) first.variables = 0;
+  return first;
+}
+
+// Run the back end on the IR of an image, whose front end ran before, to
+// out or into ctx->output if out is NULL: optimize it unless unoptimized,
+// then assemble it, or write it to an image again. The functions are
+// handed to the back end one by one, like they are while compiling.
+enum CCStatus CCAssemble(CCContext *ctx, IMImage *image, FILE *out) {
+  free(ctx->output);
+  free(ctx->errors);
+  ctx->output = NULL;
+  ctx->outputSize = 0;
+  ctx->out = out != NULL ? out : open_memstream(&ctx->output, &ctx->outputSize);
+  ctx->err = open_memstream(&ctx->errors, &ctx->errorsSize);
+  Assert(ctx->out != NULL && ctx->err != NULL, "out of memory for output");
+  ctx->cacheHits = ctx->cacheMisses = 0;
+
+  enum CCStatus status = CC_OK;
+  if (ctx->image != IM_NONE) {
+    IMBegin(&ctx->writer, ctx->out, ctx->image);
+  } else {
+    ASTranslateHeader(ctx->out);
+  }
+  for (IRCodeList list;;) {
+    IRStore store = IR_STORE_INIT;
+    if (!IMNextFunction(image, &store, &list)) {
+      fprintf(ctx->err, "Line %u: invalid IR code\n", image->line);
+      status = CC_ERROR_SYNTAX;
+      break;
+    }
+    if (list.head == NULL) break;
+    submitBackJob(ctx, list, store, baseOf(list));
+  }
+  WKDrain(&ctx->workers);
+  if (ctx->image != IM_NONE) IMEnd(&ctx->writer);
+
+  if (out == NULL) fclose(ctx->out);
+  fclose(ctx->err);
+  ctx->out = ctx->err = NULL;
+  if (status != CC_OK && out == NULL) {
+    ctx->output[0] = '\0'; // drop what has been written
+    ctx->outputSize = 0;
+  }
+  return status;
+}
+
+// Stop the workers of a context and free it.
+void CCFree(CCContext *ctx) {
+  WKFinish(&ctx->workers);
+  ARDestroy(&ctx->table.arena); // reused by all compilations of the context
+  ARDestroy(&ctx->table.scopeArena);
+  ARDestroy(&ctx->se.arena);
+  free(ctx->output);
+  free(ctx->errors);
+  free(ctx);
+}
+
+// Free the shared tables, once no context is left.
+void CCShutdown() {
+  pthread_mutex_lock(&CCLock);
+  if (CCReady) {
+    teardownSyntaxTree();
+    INDestroy();
+    CCReady = false;
+  }
+  pthread_mutex_unlock(&CCLock);
+}
@@ -0,0 +1,84 @@
+/**
+ * The compiler as a library: compile a source in memory to assembly in
+ * memory or in a file, with the diagnostics the parser would print.
+ * Everything a compilation changes lives in its CCContext, contexts do
+ * not share state. Compilations in different contexts can run at once on
+ * different threads. Only the intern table and the node table are shared
+ * by all contexts, each behind a lock (see intern.h and tree.h).
+ * A context is reused for any number of compilations, one at a time.
+ * */
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "image.h"
+#include "ir.h"
+#include "scanner.h"
+#include "table.h"
+#include "tree.h"
+#include "type.h"
+#include "worker.h"
+
+// The flex scanner and the malloc'd node table are shared by all
+// contexts, compilations then take turns.
+#define CCREENTRANT (SCHAND && STARENA)
+
+// Exit codes of the parser binary.
+enum CCStatus {
+  CC_OK              = 0,
+  CC_ERROR_SYNTAX    = 3, // lexical or syntax errors
+  CC_ERROR_SEMANTICS = 4,
+  CC_ERROR_TRANSLATE = 5, // code without IR, see throwErrorT
+};
+
+typedef struct CCContext {
+  // Results of the last compilation, valid until the next one.
+  char *output;       // assembly, unless written to a file
+  size_t outputSize;  // 0 if there is an error
+  char *errors;       // diagnostics, one per line
+  size_t errorsSize;
+  size_t cacheHits, cacheMisses; // functions of the code cache, see cache.h
+
+  // Options.
+  const char *cache;  // directory of the code cache, NULL: none
+  enum IMFormat image; // write the IR instead of assembly, see image.h
+  bool unoptimized;   // the back end skips the optimizer
+
+  // Errors.
+  FILE *out, *err;    // output and errors while compiling
+  int errLineno;      // one lexical or syntax error per line
+  bool hasErrorA, hasErrorB, hasErrorS;
+  bool hasErrorT;     // hasErrorS is set as well
+  bool holdErrors;    // semantic errors are held back, see holdErrorsS
+  char *held;
+  size_t heldLength, heldCapacity;
+
+  // Front end.
+  STPool pool;        // nodes parsed on this thread
+  STPool kept;        // nodes of chunks parsed on the workers
+  STNode *root;       // the Program, unless streamed
+  void (*hook)(struct CCContext *ctx, STNode *edef); // see STStreamExtDef in syntax.y
+  bool splitFailed;   // see STParseChunks in syntax.y
+  SCChunk splitResume;
+  size_t splitAhead;
+  STTable table;
+  SEState se;
+  IRState ir;
+  IRCodeList irlist;
+  IRStore irstore;    // codes of irlist
+
+  // Back end.
+  IMWriter writer;    // with image
+  WKPool workers;
+} CCContext;
+
+CCContext *CCNew(int workers);
+enum CCStatus CCCompile(CCContext *ctx, const char *source, size_t size, FILE *out);
+enum CCStatus CCCompileBuffer(CCContext *ctx, char *buffer, size_t size, FILE *out);
+enum CCStatus CCAssemble(CCContext *ctx, IMImage *image, FILE *out);
+void CCFree(CCContext *ctx);
+void CCShutdown();
+
+#endif // COMPILER_H
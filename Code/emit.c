@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+#include "emit.h"
+#include "debug.h"
+
+// Start an empty buffer, which is flushed to file, or kept in memory if
+// file is NULL: data and size are the text then, to be freed by the
+// caller instead of closing the buffer.
+void EMOpen(EMBuffer *out, FILE *file) {
+  *out = (EMBuffer){ NULL, 0, 0, file };
+}
+
+// Make room for size more bytes and return where they go; the caller
+// adds what it has written to out->size.
+char *EMReserve(EMBuffer *out, size_t size) {
+  if (out->capacity - out->size >= size) {
+    return out->data + out->size;
+  }
+  if (out->file != NULL) {
+    EMFlush(out);
+  }
+  if (out->capacity - out->size < size) {
+    size_t capacity = out->capacity ? out->capacity : (out->file != NULL ? EM_FLUSH : 4096);
+    while (capacity - out->size < size) capacity *= 2;
+    out->data = (char *)realloc(out->data, capacity);
+    Assert(out->data != NULL, "out of memory for output");
+    out->capacity = capacity;
+  }
+  return out->data + out->size;
+}
+
+void EMChars(EMBuffer *out, const char *s, size_t length) {
+  memcpy(EMReserve(out, length), s, length);
+  out->size += length;
+}
+
+void EMString(EMBuffer *out, const char *s) {
+  EMChars(out, s, strlen(s));
+}
+
+void EMChar(EMBuffer *out, char c) {
+  *EMReserve(out, 1) = c;
+  ++out->size;
+}
+
+// Append a number in decimal, like %ld.
+void EMInt(EMBuffer *out, long value) {
+  if (value < 0) {
+    EMChar(out, '-');
+    EMUnsigned(out, 0ul - (unsigned long)value);
+  } else {
+    EMUnsigned(out, (unsigned long)value);
+  }
+}
+
+// Append a number in decimal, like %lu. The digits are made backwards.
+void EMUnsigned(EMBuffer *out, unsigned long value) {
+  char digits[20];
+  size_t n = sizeof(digits);
+  do {
+    digits[--n] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  EMChars(out, digits + n, sizeof(digits) - n);
+}
+
+// Write the buffered text to the file, if there is one.
+void EMFlush(EMBuffer *out) {
+  if (out->file == NULL || out->size == 0) return;
+  fwrite(out->data, 1, out->size, out->file);
+  out->size = 0;
+}
+
+// Flush the buffer and free it.
+void EMClose(EMBuffer *out) {
+  EMFlush(out);
+  free(out->data);
+  *out = (EMBuffer){ NULL, 0, 0, NULL };
+}
@@ -0,0 +1,37 @@
+/**
+ * The output buffer of the emitters.
+ * Assembly and IR text are appended to a buffer in memory, with numbers
+ * formatted by hand instead of by printf, and handed to the file with one
+ * fwrite for each flush; stdio passes a block that large straight to
+ * write. A buffer without a file keeps growing instead, its text is then
+ * the caller's, see EMOpen.
+ * */
+
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define EM_FLUSH (64 * 1024) // <- bytes buffered before a flush to the file
+
+typedef struct EMBuffer {
+  char *data;
+  size_t size, capacity;
+  FILE *file; // flushed to, NULL: kept in memory
+} EMBuffer;
+
+// Append a string literal.
+#define EMLiteral(out, s) EMChars(out, s, sizeof(s) - 1)
+
+void EMOpen(EMBuffer *out, FILE *file);
+char *EMReserve(EMBuffer *out, size_t size);
+void EMChars(EMBuffer *out, const char *s, size_t length);
+void EMString(EMBuffer *out, const char *s);
+void EMChar(EMBuffer *out, char c);
+void EMInt(EMBuffer *out, long value);
+void EMUnsigned(EMBuffer *out, unsigned long value);
+void EMFlush(EMBuffer *out);
+void EMClose(EMBuffer *out);
+
+#endif // EMIT_H
@@ -0,0 +1,277 @@
+#define _DEFAULT_SOURCE // mmap
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+#include "emit.h"
+#include "intern.h"
+#include "debug.h"
+
+// A function name of the string table.
+typedef struct IMName {
+  unsigned int atom;
+  uint32_t index;
+} IMName;
+
+static int IMComp(const void *a, const void *b) {
+  unsigned int x = ((const IMName *)a)->atom;
+  unsigned int y = ((const IMName *)b)->atom;
+  return (x > y) - (x < y);
+}
+
+// Index of a name in the string table, which is added if it is new.
+static uint32_t IMString(IMWriter *writer, unsigned int atom) {
+  IMName key = { atom, 0 };
+  RBNode *node = RBSearch(&writer->names, &key, IMComp);
+  if (node != NULL && IMComp(&key, node->value) == 0) {
+    return ((IMName *)node->value)->index;
+  }
+  IMHeader *header = &writer->header;
+  if (header->stringCount == writer->capacity) {
+    writer->capacity = writer->capacity ? writer->capacity * 2 : 256;
+    writer->strings = (const char **)realloc(writer->strings, sizeof(char *) * writer->capacity);
+    Assert(writer->strings != NULL, "out of memory for string table");
+  }
+  IMName *entry = (IMName *)malloc(sizeof(IMName));
+  Assert(entry != NULL, "out of memory for string table");
+  entry->atom = atom;
+  entry->index = header->stringCount++;
+  writer->strings[entry->index] = INName(atom);
+  header->stringsSize += strlen(INName(atom)) + 1;
+  RBInsert(&writer->names, entry, IMComp);
+  return entry->index;
+}
+
+// Start an image at the current position of file. A binary image needs
+// a seekable file.
+void IMBegin(IMWriter *writer, FILE *file, enum IMFormat format) {
+  *writer = (IMWriter){ file, format, ftell(file), { IM_MAGIC, IM_VERSION, 0, 0, 0 },
+                        NULL, NULL, 0 };
+  if (format == IM_BINARY) {
+    fwrite(&writer->header, sizeof(IMHeader), 1, file); // written again at the end
+  }
+}
+
+// Append the codes of a list to the image.
+void IMWriteList(IMWriter *writer, IRCodeList list) {
+  if (writer->format == IM_TEXT) {
+    EMBuffer out;
+    EMOpen(&out, writer->file);
+    for (IRCode *code = list.head; code != NULL; code = code->next) {
+      IREmitCode(&out, code);
+    }
+    EMClose(&out);
+    return;
+  }
+  for (IRCode *code = list.head; code != NULL; code = code->next) {
+    IMCode record;
+    memset(&record, 0, sizeof(record));
+    record.kind = code->kind;
+    IROperand *ops[IR_MAX_OPERANDS];
+    size_t count = IRCodeOperands(code, ops);
+    for (size_t i = 0; i < count; ++i) {
+      IMOperand *op = &record.ops[i];
+      op->kind = ops[i]->kind;
+      switch (ops[i]->kind) {
+      case IR_OP_FUNCTION:
+        op->value = IMString(writer, ops[i]->atom);
+        break;
+      case IR_OP_NULL:
+        break;
+      default:
+        op->value = ops[i]->number; // or ivalue, relop
+        break;
+      }
+    }
+    fwrite(&record, sizeof(record), 1, writer->file);
+    ++writer->header.codeCount;
+  }
+}
+
+// Write the string table and the header, and free the writer.
+void IMEnd(IMWriter *writer) {
+  if (writer->format != IM_BINARY) return;
+  for (uint32_t i = 0; i < writer->header.stringCount; ++i) {
+    fwrite(writer->strings[i], 1, strlen(writer->strings[i]) + 1, writer->file);
+  }
+  long end = ftell(writer->file);
+  fseek(writer->file, writer->start, SEEK_SET);
+  fwrite(&writer->header, sizeof(IMHeader), 1, writer->file);
+  fseek(writer->file, end, SEEK_SET);
+  RBDestroy(&writer->names, free);
+  free(writer->strings);
+  writer->names = NULL;
+  writer->strings = NULL;
+}
+
+// Check an operand of a record, names are indices into the string table.
+static bool IMValidOperand(const IMOperand *op, uint32_t stringCount) {
+  if (op->kind > IR_OP_FUNCTION) return false;
+  return op->kind != IR_OP_FUNCTION || op->value < stringCount;
+}
+
+// Fill the operands of a code from a record, once the names are interned.
+static void IMDecode(const IMImage *image, const IMCode *record, IRCode *code) {
+  IROperand *ops[IR_MAX_OPERANDS];
+  size_t count = IRCodeOperands(code, ops);
+  for (size_t j = 0; j < count; ++j) {
+    const IMOperand *op = &record->ops[j];
+    ops[j]->kind = (enum IROperandType)op->kind;
+    if (op->kind == IR_OP_FUNCTION) {
+      ops[j]->atom = image->atoms[op->value];
+    } else {
+      ops[j]->number = op->value; // or ivalue, relop
+    }
+  }
+}
+
+// Check a mapped image and intern its names, return false if it is broken.
+// The codes are checked as the text reader checks them, so that the back
+// end only sees what it can take.
+static bool IMCheck(IMImage *image) {
+  const IMHeader *header = (const IMHeader *)image->base;
+  if (image->size < sizeof(IMHeader) || header->magic != IM_MAGIC ||
+      header->version != IM_VERSION ||
+      image->size != sizeof(IMHeader) + (uint64_t)header->codeCount * sizeof(IMCode) +
+                     header->stringsSize) {
+    return false;
+  }
+  image->header = header;
+  image->records = (const IMCode *)(image->base + sizeof(IMHeader));
+  const char *table = (const char *)(image->records + header->codeCount);
+  const char *end = table + header->stringsSize;
+  if (header->stringsSize > 0 && end[-1] != '\0') return false;
+  for (uint32_t i = 0; i < header->codeCount; ++i) {
+    const IMCode *record = &image->records[i];
+    if (record->kind > IR_CODE_WRITE) return false;
+    for (size_t j = 0; j < IR_MAX_OPERANDS; ++j) {
+      if (!IMValidOperand(&record->ops[j], header->stringCount)) return false;
+    }
+  }
+
+  image->atoms = (unsigned int *)malloc(sizeof(unsigned int) * (header->stringCount + 1));
+  Assert(image->atoms != NULL, "out of memory for string table");
+  const char *string = table;
+  for (uint32_t i = 0; i < header->stringCount; ++i) {
+    if (string >= end) return false;
+    size_t length = strlen(string);
+    image->atoms[i] = INAtom(string, length);
+    string += length + 1;
+  }
+  IRChecker checker = IR_CHECKER_INIT;
+  bool valid = true;
+  for (uint32_t i = 0; valid && i < header->codeCount; ++i) {
+    IRCode code = { .kind = (enum IRCodeType)image->records[i].kind };
+    IMDecode(image, &image->records[i], &code);
+    valid = IRCheckCode(&checker, &code);
+  }
+  IRFreeChecker(&checker);
+  return valid;
+}
+
+// An IR file whose name ends in .ir is text.
+enum IMFormat IMFormatOf(const char *path) {
+  size_t length = strlen(path);
+  return length >= 3 && strcmp(path + length - 3, ".ir") == 0 ? IM_TEXT : IM_BINARY;
+}
+
+// Map and check an image. Return false with errno set if the file cannot
+// be read, or with errno 0 if it is not a valid image.
+bool IMOpen(const char *path, IMImage *image) {
+  *image = (IMImage){ NULL, 0, IM_NONE, NULL, NULL, NULL, 0, 0, 1 };
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t)st.st_size;
+  if (size == 0) { // the text of a program without functions, a binary image has a header
+    close(fd);
+    if (IMFormatOf(path) != IM_TEXT) {
+      errno = 0;
+      return false;
+    }
+    image->format = IM_TEXT;
+    return true;
+  }
+  void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file alive
+  if (base == MAP_FAILED) return false;
+  Log("mapped %s: %zu bytes at %p", path, size, base);
+  image->base = (char *)base;
+  image->size = size;
+  image->format = size >= sizeof(uint32_t) && *(const uint32_t *)base == IM_MAGIC ? IM_BINARY
+                                                                                 : IM_TEXT;
+  if (image->format == IM_BINARY && !IMCheck(image)) {
+    IMClose(image);
+    errno = 0;
+    return false;
+  }
+  return true;
+}
+
+// Read the lines of the next function, up to the next FUNCTION line.
+// Return false if a line is not a valid code, image->line is its number.
+static bool IMReadFunction(IMImage *image, IRStore *store, IRCodeList *list) {
+  const char *end = image->base + image->size;
+  IRChecker checker = IR_CHECKER_INIT;
+  bool valid = true;
+  while (image->offset < image->size) {
+    const char *line = image->base + image->offset;
+    const char *next = memchr(line, '\n', end - line);
+    size_t length = (next != NULL ? next : end) - line;
+    if (list->head != NULL && length >= 9 && memcmp(line, "FUNCTION ", 9) == 0) break;
+    char buffer[512];
+    if (length >= sizeof(buffer)) {
+      valid = false;
+      break;
+    }
+    memcpy(buffer, line, length);
+    buffer[length] = '\0';
+    if (strspn(buffer, " \t\r") < length) { // not blank
+      IRCode *code = IRNewCode(store, IR_CODE_LABEL);
+      valid = IRReadCode(buffer, code) && IRCheckCode(&checker, code);
+      if (!valid) break;
+      *list = IRAppendCode(*list, code);
+    }
+    image->offset += length + (next != NULL);
+    ++image->line;
+  }
+  IRFreeChecker(&checker);
+  return valid;
+}
+
+// Decode the codes of the next function, up to the next FUNCTION code,
+// into list and its store, the list is empty once the image is done.
+// Return false if the image is text and a line is not valid, nothing is
+// decoded then.
+bool IMNextFunction(IMImage *image, IRStore *store, IRCodeList *list) {
+  *list = STATIC_EMPTY_IR_LIST;
+  if (image->format == IM_TEXT) {
+    if (IMReadFunction(image, store, list)) return true;
+    IRFreeStore(store);
+    *list = STATIC_EMPTY_IR_LIST;
+    return false;
+  }
+  for (uint32_t start = image->next; image->next < image->header->codeCount; ++image->next) {
+    const IMCode *record = &image->records[image->next];
+    if (record->kind == IR_CODE_FUNCTION && image->next > start) break;
+    IRCode *code = IRNewCode(store, (enum IRCodeType)record->kind);
+    IMDecode(image, record, code);
+    *list = IRAppendCode(*list, code);
+  }
+  return true;
+}
+
+// Unmap an image.
+void IMClose(IMImage *image) {
+  if (image->base != NULL) munmap(image->base, image->size);
+  free(image->atoms);
+  *image = (IMImage){ NULL, 0, IM_NONE, NULL, NULL, NULL, 0, 0, 1 };
+}
@@ -0,0 +1,85 @@
+/**
+ * The IR image: a binary file of the IR of a program, the output of the
+ * front end, which the back end can load instead of compiling the source.
+ * The file is an IMHeader, the codes as fixed-width IMCode records and a
+ * string table of the function names, NUL-terminated one after another.
+ * A function operand holds the index of its name in the table, any other
+ * operand its number, constant or relop. Every field is 32 bits wide but
+ * for the size of the string table, in the byte order of the machine.
+ * The loader maps the file and checks it once, then turns the records of
+ * each function into IRCodes with a few stores, nothing is parsed. Only
+ * the functions handed to the back end are in memory at a time.
+ * An image can also be text, the IR as IRWriteCode prints it, one code
+ * per line; it is read a function at a time in the same way.
+ * */
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "ir.h"
+#include "rbtree.h"
+
+#define IM_MAGIC 0x52494d43u // "CMIR"
+#define IM_VERSION 2 // <- bump when IR or the records change
+
+enum IMFormat {
+  IM_NONE,
+  IM_BINARY,
+  IM_TEXT,
+};
+
+typedef struct IMHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t codeCount;   // followed by the codes
+  uint32_t stringCount; // then by the string table
+  uint64_t stringsSize;
+} IMHeader;
+
+typedef struct IMOperand {
+  uint32_t kind;  // IROperandType
+  uint32_t value; // see above
+} IMOperand;
+
+typedef struct IMCode {
+  uint32_t kind;  // IRCodeType
+  IMOperand ops[IR_MAX_OPERANDS]; // see IRCodeOperands, unused ones are 0
+} IMCode;
+
+// Writes an image as the IR is translated, one list at a time.
+typedef struct IMWriter {
+  FILE *file;
+  enum IMFormat format;
+  long start;       // position of the header
+  IMHeader header;
+  RBNode *names;    // IMName of every function name written, by atom
+  const char **strings; // the names by index
+  size_t capacity;
+} IMWriter;
+
+// A mapped image, whose functions are decoded one at a time.
+typedef struct IMImage {
+  char *base;
+  size_t size;
+  enum IMFormat format;
+  const IMHeader *header;
+  const IMCode *records;
+  unsigned int *atoms; // of the names, by index
+  uint32_t next;      // the first record not decoded yet
+  size_t offset;      // of the first line not read yet, in text
+  unsigned int line;  // its number
+} IMImage;
+
+void IMBegin(IMWriter *writer, FILE *file, enum IMFormat format);
+void IMWriteList(IMWriter *writer, IRCodeList list);
+void IMEnd(IMWriter *writer);
+
+enum IMFormat IMFormatOf(const char *path);
+bool IMOpen(const char *path, IMImage *image);
+bool IMNextFunction(IMImage *image, IRStore *store, IRCodeList *list);
+void IMClose(IMImage *image);
+
+#endif // IMAGE_H
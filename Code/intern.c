@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include "intern.h"
+#include "arena.h"
+#include "debug.h"
+
+#define IN_INIT_CAPACITY 1024 // must be a power of 2
+
+static INEntry *INTable = NULL;
+static size_t INCapacity = 0, INCount = 0;
+static Arena INArena = ARENA_INIT; // storage of the names
+static pthread_mutex_t INLock = PTHREAD_MUTEX_INITIALIZER;
+
+const char **INPages[IN_PAGE_COUNT];
+const char *INTERN_INT, *INTERN_FLOAT;
+const char *INTERN_READ, *INTERN_WRITE, *INTERN_MAIN;
+
+// Prepare the table and intern the well-known names.
+void INPrepare() {
+  INCapacity = IN_INIT_CAPACITY;
+  INCount = 0;
+  INTable = (INEntry *)calloc(INCapacity, sizeof(INEntry));
+  INPages[0] = (const char **)malloc(sizeof(const char *) << IN_PAGE_BITS);
+  INPages[0][0] = NULL;
+  INTERN_INT   = INIntern("int", 3);
+  INTERN_FLOAT = INIntern("float", 5);
+  INTERN_READ  = INIntern("read", 4);
+  INTERN_WRITE = INIntern("write", 5);
+  INTERN_MAIN  = INIntern("main", 4);
+}
+
+// Destroy the table and all interned names.
+void INDestroy() {
+  for (size_t page = 0; INCapacity > 0 && page <= (INCount >> IN_PAGE_BITS); ++page) {
+    free(INPages[page]);
+    INPages[page] = NULL;
+  }
+  free(INTable);
+  INTable = NULL;
+  INCapacity = INCount = 0;
+  ARDestroy(&INArena);
+}
+
+// FNV-1a hash of a string of given length.
+static unsigned int INHash(const char *str, size_t len) {
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= (unsigned char)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Double the capacity of the table and rehash all entries.
+static void INGrow() {
+  size_t capacity = INCapacity * 2;
+  INEntry *table = (INEntry *)calloc(capacity, sizeof(INEntry));
+  Assert(table != NULL, "out of memory for intern table");
+  for (size_t i = 0; i < INCapacity; ++i) {
+    if (INTable[i].name == NULL) continue;
+    size_t j = INTable[i].hash & (capacity - 1);
+    while (table[j].name != NULL) j = (j + 1) & (capacity - 1);
+    table[j] = INTable[i];
+  }
+  free(INTable);
+  INTable = table;
+  INCapacity = capacity;
+}
+
+// Get the atom of str[0..len), interning it when seen for the first time.
+unsigned int INAtom(const char *str, size_t len) {
+  unsigned int hash = INHash(str, len);
+  pthread_mutex_lock(&INLock);
+  size_t i = hash & (INCapacity - 1);
+  while (INTable[i].name != NULL) {
+    if (INTable[i].hash == hash && INTable[i].length == len &&
+        !memcmp(INTable[i].name, str, len)) {
+      unsigned int atom = INTable[i].atom;
+      pthread_mutex_unlock(&INLock);
+      return atom;
+    }
+    i = (i + 1) & (INCapacity - 1);
+  }
+  char *name = (char *)ARAlloc(&INArena, len + 1);
+  memcpy(name, str, len);
+  name[len] = '\0';
+  unsigned int atom = ++INCount;
+  Assert(atom >> IN_PAGE_BITS < IN_PAGE_COUNT, "too many names");
+  if ((atom & IN_PAGE_MASK) == 0) {
+    INPages[atom >> IN_PAGE_BITS] = (const char **)malloc(sizeof(const char *) << IN_PAGE_BITS);
+    Assert(INPages[atom >> IN_PAGE_BITS] != NULL, "out of memory for intern names");
+  }
+  INName(atom) = name;
+  INTable[i].hash = hash;
+  INTable[i].atom = atom;
+  INTable[i].length = len;
+  INTable[i].name = name;
+  if (INCount * 2 > INCapacity) INGrow(); // keep load factor below 1/2
+  pthread_mutex_unlock(&INLock);
+  return atom;
+}
+
+// Get the canonical copy of str[0..len).
+const char *INIntern(const char *str, size_t len) {
+  return INName(INAtom(str, len));
+}
@@ -0,0 +1,40 @@
+/**
+ * The identifier intern table.
+ * Every distinct name gets exactly one canonical pointer and one
+ * integer atom, so names can be compared with == instead of strcmp.
+ * Interning takes a lock, so scanners on several threads can share the
+ * table. Names are kept in pages which never move: the name of an atom
+ * already handed out can be read without the lock.
+ * */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+typedef struct INEntry {
+  unsigned int hash;
+  unsigned int atom;
+  size_t length;
+  const char *name;
+} INEntry;
+
+#define IN_PAGE_BITS 12
+#define IN_PAGE_MASK ((1u << IN_PAGE_BITS) - 1)
+#define IN_PAGE_COUNT (1u << 16)
+
+// Canonical name of each atom by pages, atom 0 is reserved.
+extern const char **INPages[IN_PAGE_COUNT];
+#define INName(atom) (INPages[(atom) >> IN_PAGE_BITS][(atom) & IN_PAGE_MASK])
+
+// Well-known names, valid after INPrepare().
+extern const char *INTERN_INT, *INTERN_FLOAT;
+extern const char *INTERN_READ, *INTERN_WRITE, *INTERN_MAIN;
+
+void INPrepare();
+void INDestroy();
+
+unsigned int INAtom(const char *str, size_t len);
+const char *INIntern(const char *str, size_t len);
+
+#endif // INTERN_H
@@ -1,748 +1,181 @@
+#define _POSIX_C_SOURCE 200809L // strtok_r
 #include "ir.h"
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "compiler.h"
 #include "debug.h"
+#include "emit.h"
+#include "intern.h"
 #include "syntax.tab.h"
 #include "table.h"
 #include "token.h"
-#include "tree.h"
-
-// same assertion code as in type.c
-#ifdef DEBUG
-#define AssertSTNode(node, str)                                                \
-  Assert(node, "node is null");                                                \
-  Assert(!strcmp(node->name, str), "not a " str);
-#else
-#define AssertSTNode(node, str)
-#endif
-
-extern SEType *STATIC_TYPE_VOID, *STATIC_TYPE_INT, *STATIC_TYPE_FLOAT;
 
 const IRCodeList STATIC_EMPTY_IR_LIST = {NULL, NULL};
 
-// Translate an Exp into IRCodeList with SEType as a pair.
-IRCodePair IRTranslateExp(STNode *exp, IROperand place, bool deref) {
-  AssertSTNode(exp, "Exp");
-  STNode *e1 = exp->child;
-  STNode *e2 = e1 ? e1->next : NULL;
-  STNode *e3 = e2 ? e2->next : NULL;
-  switch (e1->token) {
-  case LP: // LP Exp RP
-    return IRTranslateExp(e2, place, deref);
-  case MINUS: {
-    IROperand t1 = IRNewTempOperand();
-    IRCodePair pair = IRTranslateExp(e2, t1, true);
-
-    if (place.kind != IR_OP_NULL) {
-      IRCode *code = IRNewCode(IR_CODE_SUB);
-      code->binop.result = place;
-      code->binop.op1 = IRNewConstantOperand(0);
-      code->binop.op2 = t1;
-      pair.list = IRAppendCode(pair.list, code);
-    }
-    return pair;
-  }
-  case NOT:
-    return IRWrapPair(IRTranslateCondPre(exp, place), STATIC_TYPE_INT, false);
-  case ID: {
-    STEntry *entry = STSearch(e1->sval);
-    Assert(entry != NULL, "entry %s not found in ST", exp->sval);
-    SEType *type = entry->type;
-    if (e2 == NULL) {
-      if (place.kind != IR_OP_NULL) {
-        IROperand var = IRNewVariableOperand(e1->sval);
-        IRCode *code = IRNewCode(IR_CODE_ASSIGN);
-        code->assign.left = place;
-        code->assign.right = var;
-        return IRWrapPair(IRWrapCode(code), type, type->kind != BASIC);
-      } else {
-        return IRWrapPair(STATIC_EMPTY_IR_LIST, type, false);
-      }
-    } else {
-      // function calls can't be ignored as they may have side effects!
-      // if place is empty, we need to create a temp variable.
-      if (place.kind == IR_OP_NULL) {
-        place = IRNewTempOperand();
-      }
-      if (e3->token == RP) {
-        // ID()
-        if (!strcmp(e1->sval, "read")) {
-          IRCode *code = IRNewCode(IR_CODE_READ);
-          code->read.variable = place;
-          return IRWrapPair(IRWrapCode(code), STATIC_TYPE_INT, false);
-        } else {
-          IRCode *code = IRNewCode(IR_CODE_CALL);
-          code->call.result = place;
-          code->call.function = IRNewFunctionOperand(e1->sval);
-          return IRWrapPair(IRWrapCode(code), type->function.type,
-                            type->function.type->kind != BASIC);
-        }
-      } else {
-        // ID(args...)
-        STEntry *entry = STSearchFunc(e1->sval);
-        Assert(entry != NULL, "func not found in ST");
-
-        IRCodeList arg_list = STATIC_EMPTY_IR_LIST;
-        IRCodeList list =
-            IRTranslateArgs(e3, entry->type->function.signature, &arg_list);
-
-        if (!strcmp(e1->sval, "write")) {
-          Assert(arg_list.head != NULL, "empty arguments to WRITE");
-          IRCode *code = IRNewCode(IR_CODE_WRITE);
-          code->write.variable = arg_list.head->arg.variable;
-          list = IRAppendCode(list, code);
-          IRDestroyList(arg_list); // argument list no longer useful
-          return IRWrapPair(list, STATIC_TYPE_INT, false);
-        } else {
-          IRCode *code = IRNewCode(IR_CODE_CALL);
-          code->call.result = place;
-          code->call.function = IRNewFunctionOperand(e1->sval);
-          list = IRConcatLists(list, arg_list);
-          list = IRAppendCode(list, code);
-          return IRWrapPair(list, type->function.type,
-                            type->function.type->kind != BASIC);
-        }
-      }
-    }
+// Append the arithmetic code of Exp1 op Exp2.
+IRCodeList IRAppendArith(CCContext *ctx, IRCodeList list, int op, IROperand place,
+                         IROperand t1, IROperand t2) {
+  IRCode *code = NULL;
+  switch (op) {
+  case PLUS:
+    code = IRNewCode(&ctx->irstore, IR_CODE_ADD);
     break;
-  }
-  case INT: {
-    if (place.kind != IR_OP_NULL) {
-      IRCode *code = IRNewCode(IR_CODE_ASSIGN);
-      IRCodeList list = {code, code};
-      code->assign.left = place;
-      code->assign.right = IRNewConstantOperand(e1->ival);
-      return IRWrapPair(IRWrapCode(code), STATIC_TYPE_INT, false);
-    } else {
-      return IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
-    }
-  }
-  case FLOAT:
-    Panic("unexpected FLOAT");
+  case MINUS:
+    code = IRNewCode(&ctx->irstore, IR_CODE_SUB);
     break;
-  default: {
-    switch (e2->token) {
-    case LB: {
-      IRCodePair pair = IRTranslateExp(e1, place, false);
-      IRCodeList list = pair.list;
-      SEType *type = pair.type;
-      Assert(type->kind = ARRAY, "type is not array");
-
-      IROperand t1 = IRNewTempOperand();
-      IRCodePair pair2 = IRTranslateExp(e3, t1, true);
-      list = IRConcatLists(list, pair2.list);
-
-      IRCode *code = IRNewCode(IR_CODE_MUL);
-      code->binop.result = t1;
-      code->binop.op1 = t1;
-      code->binop.op2 = IRNewConstantOperand(type->array.type->size);
-      list = IRAppendCode(list, code);
-
-      if (place.kind != IR_OP_NULL) {
-        code = IRNewCode(IR_CODE_ADD);
-        code->binop.result = place;
-        code->binop.op1 = place;
-        code->binop.op2 = t1;
-        list = IRAppendCode(list, code);
-      }
-
-      if (deref && place.kind != IR_OP_NULL) {
-        code = IRNewCode(IR_CODE_LOAD);
-        code->load.left = place;
-        code->load.right = place;
-        list = IRAppendCode(list, code);
-      }
-      return IRWrapPair(list, type->array.type, !deref);
-    }
-    case DOT: {
-      IRCodePair pair = IRTranslateExp(e1, place, false);
-      IRCodeList list = pair.list;
-      SEType *type = pair.type;
-      SEField *field = NULL;
-      size_t offset = 0;
-      Assert(type->kind == STRUCTURE, "type is not structure");
-      for (field = type->structure; field != NULL; field = field->next) {
-        if (!strcmp(field->name, e3->sval)) {
-          type = field->type;
-          break;
-        } else {
-          offset += field->type->size;
-        }
-      }
-      Assert(field != NULL, "invalid offset in struct");
-      if (offset > 0 && place.kind != IR_OP_NULL) {
-        IRCode *code = IRNewCode(IR_CODE_ADD);
-        code->binop.result = place;
-        code->binop.op1 = place;
-        code->binop.op2 = IRNewConstantOperand(offset);
-        list = IRAppendCode(list, code);
-      }
-
-      if (deref && place.kind != IR_OP_NULL) {
-        IRCode *code = IRNewCode(IR_CODE_LOAD);
-        code->load.left = place;
-        code->load.right = place;
-        list = IRAppendCode(list, code);
-      }
-      return IRWrapPair(list, type, !deref);
-    }
-    case ASSIGNOP: {
-      IRCodePair pair; // return value
-      IROperand t1 = IRNewTempOperand();
-
-      bool lval = false;
-      if (e1->child->token == ID) {
-        STEntry *entry = STSearch(e1->child->sval);
-        Assert(entry != NULL, "entry %s not found in ST", e1->child->sval);
-        lval = entry->type->kind == BASIC;
-      }
-
-      if (lval) {
-        // assign to a variable
-        IROperand var = IRNewVariableOperand(e1->child->sval);
-        IRCode *code = IRNewCode(IR_CODE_ASSIGN);
-        pair = IRTranslateExp(e3, t1, true);
-        code->assign.left = var;
-        code->assign.right = t1;
-        pair.list = IRAppendCode(pair.list, code);
-      } else {
-        // assign to a address
-        IROperand addr = IRNewTempOperand();
-        pair = IRTranslateExp(e1, addr, false);
-
-        if (pair.type->size == 4) {
-          // we need the value stored in the memory
-          IRCodePair pair2 = IRTranslateExp(e3, t1, true);
-          pair.list = IRConcatLists(pair.list, pair2.list);
-
-          IRCode *save = IRNewCode(IR_CODE_SAVE);
-          save->save.left = addr;
-          save->save.right = t1;
-          pair.list = IRAppendCode(pair.list, save);
-          pair.type = pair2.type;
-          pair.addr = false;
-        } else {
-          // copy memory area, we don't care about the value
-          IRCodePair pair2 = IRTranslateExp(e3, t1, false);
-          pair.list = IRConcatLists(pair.list, pair2.list);
-          /**
-           * iter = 0
-           * LABEL loop:
-           * temp = *t1
-           * *addr = temp
-           * t1 += 4
-           * addr += 4
-           * iter += 4
-           * if iter < size GOTO loop
-           */
-          IROperand iter = IRNewTempOperand();
-          IROperand temp = IRNewTempOperand();
-          IROperand loop = IRNewLabelOperand();
-
-          IRCode *init = IRNewCode(IR_CODE_ASSIGN);
-          init->assign.left = iter;
-          init->assign.right = IRNewConstantOperand(0);
-          pair.list = IRAppendCode(pair.list, init);
-
-          IRCode *label = IRNewCode(IR_CODE_LABEL);
-          label->label.label = loop;
-          pair.list = IRAppendCode(pair.list, label);
-
-          IRCode *load = IRNewCode(IR_CODE_LOAD);
-          load->load.left = temp;
-          load->load.right = t1;
-          pair.list = IRAppendCode(pair.list, load);
-
-          IRCode *save = IRNewCode(IR_CODE_SAVE);
-          save->save.left = addr;
-          save->save.right = temp;
-          pair.list = IRAppendCode(pair.list, save);
-
-          IRCode *add_it = IRNewCode(IR_CODE_ADD);
-          add_it->binop.result = iter;
-          add_it->binop.op1 = iter;
-          add_it->binop.op2 = IRNewConstantOperand(4);
-          pair.list = IRAppendCode(pair.list, add_it);
-
-          IRCode *add1 = IRNewCode(IR_CODE_ADD);
-          add1->binop.result = addr;
-          add1->binop.op1 = addr;
-          add1->binop.op2 = IRNewConstantOperand(4);
-          pair.list = IRAppendCode(pair.list, add1);
-
-          IRCode *add2 = IRNewCode(IR_CODE_ADD);
-          add2->binop.result = t1;
-          add2->binop.op1 = t1;
-          add2->binop.op2 = IRNewConstantOperand(4);
-          pair.list = IRAppendCode(pair.list, add2);
-
-          IRCode *jump = IRNewCode(IR_CODE_JUMP_COND);
-          jump->jump_cond.op1 = iter;
-          jump->jump_cond.op2 = IRNewConstantOperand(pair.type->size);
-          jump->jump_cond.relop = IRNewRelopOperand(RELOP_LT);
-          jump->jump_cond.dest = loop;
-          pair.list = IRAppendCode(pair.list, jump);
-        }
-      }
-
-      if (place.kind != IR_OP_NULL) {
-        IRCode *code2 = IRNewCode(IR_CODE_ASSIGN);
-        code2->assign.left = place;
-        code2->assign.right = t1; // var may be an address, use t1 instead
-        pair.list = IRAppendCode(pair.list, code2);
-      }
-      return pair;
-    }
-    case AND:
-    case OR:
-    case RELOP:
-      return IRWrapPair(IRTranslateCondPre(exp, place), STATIC_TYPE_INT, false);
-    default: {
-      IROperand t1 = IRNewTempOperand();
-      IROperand t2 = IRNewTempOperand();
-      IRCodePair pair = IRTranslateExp(e1, t1, true);
-      IRCodePair pair2 = IRTranslateExp(e3, t2, true);
-      pair.list = IRConcatLists(pair.list, pair2.list);
-
-      if (place.kind != IR_OP_NULL) {
-        IRCode *code = NULL;
-        switch (e2->token) {
-        case PLUS:
-          code = IRNewCode(IR_CODE_ADD);
-          break;
-        case MINUS:
-          code = IRNewCode(IR_CODE_SUB);
-          break;
-        case STAR: // not MUL
-          code = IRNewCode(IR_CODE_MUL);
-          break;
-        case DIV:
-          code = IRNewCode(IR_CODE_DIV);
-          break;
-        default:
-          Panic("invalid arithmic code");
-        }
-        code->binop.result = place;
-        code->binop.op1 = t1;
-        code->binop.op2 = t2;
-        pair.list = IRAppendCode(pair.list, code);
-      }
-      return pair;
-    }
-    }
-  }
-  }
-  Panic("should not reach here");
-  return IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
-}
-
-// Prepare to translate an Cond Exp.
-IRCodeList IRTranslateCondPre(STNode *exp, IROperand place) {
-  AssertSTNode(exp, "Exp");
-  IROperand l1 = IRNewLabelOperand();
-  IROperand l2 = IRNewLabelOperand();
-  IRCodeList list = STATIC_EMPTY_IR_LIST;
-
-  if (place.kind != IR_OP_NULL) {
-    IRCode *code0 = IRNewCode(IR_CODE_ASSIGN);
-    code0->assign.left = place;
-    code0->assign.right = IRNewConstantOperand(0);
-    list = IRAppendCode(list, code0);
-  }
-
-  list = IRConcatLists(list, IRTranslateCond(exp, l1, l2));
-
-  IRCode *label1 = IRNewCode(IR_CODE_LABEL);
-  label1->label.label = l1;
-  list = IRAppendCode(list, label1);
-
-  if (place.kind != IR_OP_NULL) {
-    IRCode *code2 = IRNewCode(IR_CODE_ASSIGN);
-    code2->assign.left = place;
-    code2->assign.right = IRNewConstantOperand(1);
-    list = IRAppendCode(list, code2);
-  }
-
-  IRCode *label2 = IRNewCode(IR_CODE_LABEL);
-  label2->label.label = l2;
-  list = IRAppendCode(list, label2);
-  return list;
-}
-
-// Translate an Exp into an conditional IRCodeList.
-IRCodeList IRTranslateCond(STNode *exp, IROperand label_true,
-                           IROperand label_false) {
-  AssertSTNode(exp, "Exp");
-  if (exp->child->token == NOT) {
-    // NOT Exp
-    return IRTranslateCond(exp->child->next, label_false, label_true);
-  } else if (exp->child->token != MINUS && exp->child->next != NULL) {
-    Assert(exp->child->next->next != NULL, "invalid cond format");
-    STNode *exp1 = exp->child;
-    STNode *exp2 = exp1->next->next;
-    switch (exp1->next->token) {
-    case RELOP: {
-      // Exp1 RELOP Exp2
-      IROperand t1 = IRNewTempOperand();
-      IROperand t2 = IRNewTempOperand();
-
-      IRCodePair pair = IRTranslateExp(exp1, t1, true);
-      IRCodePair pair2 = IRTranslateExp(exp2, t2, true);
-      IRCodeList list = IRConcatLists(pair.list, pair2.list);
-
-      IRCode *jump1 = IRNewCode(IR_CODE_JUMP_COND);
-      jump1->jump_cond.op1 = t1;
-      jump1->jump_cond.op2 = t2;
-      jump1->jump_cond.relop = IRNewRelopOperand(exp1->next->rval);
-      jump1->jump_cond.dest = label_true;
-      list = IRAppendCode(list, jump1);
-
-      IRCode *jump2 = IRNewCode(IR_CODE_JUMP);
-      jump2->jump.dest = label_false;
-      list = IRAppendCode(list, jump2);
-      return list;
-    }
-    case AND: {
-      // Exp1 AND Exp2
-      IROperand l1 = IRNewLabelOperand();
-
-      IRCodeList list = IRTranslateCond(exp1, l1, label_false);
-      IRCode *label = IRNewCode(IR_CODE_LABEL);
-      label->label.label = l1;
-      list = IRAppendCode(list, label);
-
-      IRCodeList list2 = IRTranslateCond(exp2, label_true, label_false);
-      list = IRConcatLists(list, list2);
-      return list;
-    }
-    case OR: {
-      // Exp1 OR Exp2
-      IROperand l1 = IRNewLabelOperand();
-
-      IRCodeList list = IRTranslateCond(exp1, label_true, l1);
-      IRCode *label = IRNewCode(IR_CODE_LABEL);
-      label->label.label = l1;
-      list = IRAppendCode(list, label);
-
-      IRCodeList list2 = IRTranslateCond(exp2, label_true, label_false);
-      list = IRConcatLists(list, list2);
-      return list;
-    }
-    default:
-      // go through to the general case
-      break;
-    }
-  }
-
-  // General case: Exp (like if(0), while(1))
-  IROperand t1 = IRNewTempOperand();
-  IRCodeList list = IRTranslateExp(exp, t1, true).list;
-
-  IRCode *jump = IRNewCode(IR_CODE_JUMP_COND);
-  jump->jump_cond.op1 = t1;
-  jump->jump_cond.op2 = IRNewConstantOperand(0);
-  jump->jump_cond.relop = IRNewRelopOperand(RELOP_NE);
-  jump->jump_cond.dest = label_true;
-  list = IRAppendCode(list, jump);
-
-  jump = IRNewCode(IR_CODE_JUMP);
-  jump->jump.dest = label_false;
-  list = IRAppendCode(list, jump);
-  return list;
-}
-
-// Translate an CompSt into an IRCodeList.
-IRCodeList IRTranslateCompSt(STNode *comp) {
-  AssertSTNode(comp, "CompSt");
-  IRCodeList list = IRTranslateDefList(comp->child->next);
-  IRCodeList list2 = IRTranslateStmtList(comp->child->next->next);
-  list = IRConcatLists(list, list2);
-  comp->ir.head = list.head;
-  comp->ir.tail = list.tail;
-  return list; // save IR into STNode and return
-}
-
-// Translate a DefList into an IRCodeList.
-IRCodeList IRTranslateDefList(STNode *list) {
-  AssertSTNode(list, "DefList");
-  if (list->empty)
-    return STATIC_EMPTY_IR_LIST;
-  IRCodeList ret = IRTranslateDef(list->child);
-  return IRConcatLists(ret, IRTranslateDefList(list->child->next));
-}
-
-// Translate a Def into an IRCodeList.
-IRCodeList IRTranslateDef(STNode *def) {
-  AssertSTNode(def, "Def");
-  return IRTranslateDecList(def->child->next);
-}
-
-// Translate a DecList into an IRCodeList.
-IRCodeList IRTranslateDecList(STNode *list) {
-  AssertSTNode(list, "DecList");
-  IRCodeList ret = IRTranslateDec(list->child);
-  if (list->child->next != NULL) {
-    ret = IRConcatLists(ret, IRTranslateDecList(list->child->next->next));
-  }
-  return ret;
-}
-
-// Translate a Dec into an IRCodeList.
-IRCodeList IRTranslateDec(STNode *dec) {
-  AssertSTNode(dec, "Dec");
-  IRCodeList list = STATIC_EMPTY_IR_LIST;
-
-  // find name of variable and get IR number
-  STNode *var = dec->child;
-  while (var && var->token != ID) {
-    var = var->child;
-  }
-  Assert(var, "no ID inside VarDec");
-  IROperand v = IRNewVariableOperand(var->sval);
-
-  // check whether we need DEC an array or a struct (local variable)
-  STEntry *entry = STSearchCurr(var->sval);
-  Assert(entry, "entry %s not found in ST", var->sval);
-  if (entry->type->kind == ARRAY || entry->type->kind == STRUCTURE) {
-    Assert(v.kind == IR_OP_MEMBLOCK, "not declaring a memblock");
-    IRCode *code = IRNewCode(IR_CODE_DEC);
-    code->dec.variable = v;
-    code->dec.size = IRNewConstantOperand(entry->type->size);
-    list = IRAppendCode(list, code);
-  }
-
-  // check whether there is an assignment
-  if (dec->child->next != NULL) {
-    IROperand t1 = IRNewTempOperand();
-    list = IRConcatLists(list,
-                         IRTranslateExp(dec->child->next->next, t1, true).list);
-
-    IRCode *code = IRNewCode(IR_CODE_ASSIGN);
-    code->assign.left = v;
-    code->assign.right = t1;
-    list = IRAppendCode(list, code);
-  }
-  return list;
-}
-
-// Translate an StmtList into an IRCodeList.
-IRCodeList IRTranslateStmtList(STNode *list) {
-  AssertSTNode(list, "StmtList");
-  if (list->empty)
-    return STATIC_EMPTY_IR_LIST;
-  IRCodeList ret = IRTranslateStmt(list->child);
-  return IRConcatLists(ret, IRTranslateStmtList(list->child->next));
-}
-
-// Translate an Stmt into an IRCodeList.
-IRCodeList IRTranslateStmt(STNode *stmt) {
-  AssertSTNode(stmt, "Stmt");
-  if (stmt->child->next == NULL) {
-    // As we exit CompSt, symbol table is destroyed.
-    // Therefore, we first translate inner codes and put list into STNode.
-    STNode *comp = stmt->child;
-    IRCodeList list = {
-        .head = comp->ir.head,
-        .tail = comp->ir.tail,
-    };
-    return list;
-  } else {
-    switch (stmt->child->token) {
-    case RETURN: { // RETURN Exp SEMI
-      IROperand t1 = IRNewTempOperand();
-      IRCodeList list = IRTranslateExp(stmt->child->next, t1, true).list;
-      IRCode *code = IRNewCode(IR_CODE_RETURN);
-      code->ret.value = t1;
-
-      return IRAppendCode(list, code);
-    }
-    case IF: { // IF LP Exp RP Stmt [ELSE Stmt]
-      STNode *exp = stmt->child->next->next;
-      STNode *stmt1 = exp->next->next;
-      STNode *stmt2 = stmt1->next ? stmt1->next->next : NULL;
-
-      IROperand l1 = IRNewLabelOperand();
-      IROperand l2 = IRNewLabelOperand();
-
-      IRCode *label1 = IRNewCode(IR_CODE_LABEL);
-      label1->label.label = l1;
-      IRCode *label2 = IRNewCode(IR_CODE_LABEL);
-      label2->label.label = l2;
-
-      IRCodeList list = IRTranslateCond(exp, l1, l2);
-      IRCodeList list1 = IRTranslateStmt(stmt1);
-      list = IRAppendCode(list, label1);
-      list = IRConcatLists(list, list1);
-
-      if (stmt2 == NULL) {
-        list = IRAppendCode(list, label2);
-      } else {
-        IROperand l3 = IRNewLabelOperand();
-        IRCode *jump = IRNewCode(IR_CODE_JUMP);
-        jump->jump.dest = l3;
-
-        list = IRAppendCode(list, jump);
-        list = IRAppendCode(list, label2);
-
-        IRCodeList list2 = IRTranslateStmt(stmt2);
-        list = IRConcatLists(list, list2);
-
-        IRCode *label3 = IRNewCode(IR_CODE_LABEL);
-        label3->label.label = l3;
-        list = IRAppendCode(list, label3);
-      }
-      return list;
-    }
-    case WHILE: { // WHILE LP Exp RP Stmt
-      STNode *exp = stmt->child->next->next;
-      STNode *body = exp->next->next;
-
-      IROperand l1 = IRNewLabelOperand();
-      IROperand l2 = IRNewLabelOperand();
-      IROperand l3 = IRNewLabelOperand();
-
-      IRCode *label1 = IRNewCode(IR_CODE_LABEL);
-      IRCode *label2 = IRNewCode(IR_CODE_LABEL);
-      IRCode *label3 = IRNewCode(IR_CODE_LABEL);
-
-      label1->label.label = l1;
-      label2->label.label = l2;
-      label3->label.label = l3;
-
-      IRCodeList list = IRWrapCode(label1);
-      IRCodeList cond = IRTranslateCond(exp, l2, l3);
-      list = IRConcatLists(list, cond);
-      list = IRAppendCode(list, label2);
-
-      IRCodeList code = IRTranslateStmt(body);
-      list = IRConcatLists(list, code);
-
-      IRCode *jump = IRNewCode(IR_CODE_JUMP);
-      jump->jump.dest = l1;
-      list = IRAppendCode(list, jump);
-      list = IRAppendCode(list, label3);
-      return list;
-    }
-    default: { // Exp SEMI
-      return IRTranslateExp(stmt->child, IRNewNullOperand(), true).list;
-    }
-    }
+  case STAR: // not MUL
+    code = IRNewCode(&ctx->irstore, IR_CODE_MUL);
+    break;
+  case DIV:
+    code = IRNewCode(&ctx->irstore, IR_CODE_DIV);
+    break;
+  default:
+    Panic("invalid arithmic code");
   }
-  Panic("should not reach here");
-  return STATIC_EMPTY_IR_LIST;
+  code->binop.result = place;
+  code->binop.op1 = t1;
+  code->binop.op2 = t2;
+  return IRAppendCode(list, code);
 }
 
-// Translate an Args into an IRCodeList.
-// Field is used to get the type of argument and whether to deref.
-// The IR code list is appended to the end of arg_list.
-IRCodeList IRTranslateArgs(STNode *args, SEField *field, IRCodeList *arg_list) {
-  AssertSTNode(args, "Args");
-  Assert(field != NULL, "field is null in args");
-  STNode *exp = args->child;
-  IROperand t1 = IRNewTempOperand();
-
-  IRCodeList list = IRTranslateExp(exp, t1, field->type->kind == BASIC).list;
-
-  IRCode *code = IRNewCode(IR_CODE_ARG);
-  code->arg.variable = t1;
-  *arg_list = IRConcatLists(IRWrapCode(code), *arg_list);
-
-  if (exp->next) {
-    list = IRConcatLists(
-        list, IRTranslateArgs(exp->next->next, field->next, arg_list));
-  }
-  return list;
+// Append the word-by-word copy of a memory block at t1 to addr.
+IRCodeList IRAppendCopy(CCContext *ctx, IRCodeList list, IROperand addr, IROperand t1,
+                        size_t size) {
+  /**
+   * iter = 0
+   * LABEL loop:
+   * temp = *t1
+   * *addr = temp
+   * t1 += 4
+   * addr += 4
+   * iter += 4
+   * if iter < size GOTO loop
+   */
+  IROperand iter = IRNewTempOperand(ctx);
+  IROperand temp = IRNewTempOperand(ctx);
+  IROperand loop = IRNewLabelOperand(ctx);
+
+  IRCode *init = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+  init->assign.left = iter;
+  init->assign.right = IRNewConstantOperand(0);
+  list = IRAppendCode(list, init);
+
+  IRCode *label = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+  label->label.label = loop;
+  list = IRAppendCode(list, label);
+
+  IRCode *load = IRNewCode(&ctx->irstore, IR_CODE_LOAD);
+  load->load.left = temp;
+  load->load.right = t1;
+  list = IRAppendCode(list, load);
+
+  IRCode *save = IRNewCode(&ctx->irstore, IR_CODE_SAVE);
+  save->save.left = addr;
+  save->save.right = temp;
+  list = IRAppendCode(list, save);
+
+  IRCode *add_it = IRNewCode(&ctx->irstore, IR_CODE_ADD);
+  add_it->binop.result = iter;
+  add_it->binop.op1 = iter;
+  add_it->binop.op2 = IRNewConstantOperand(4);
+  list = IRAppendCode(list, add_it);
+
+  IRCode *add1 = IRNewCode(&ctx->irstore, IR_CODE_ADD);
+  add1->binop.result = addr;
+  add1->binop.op1 = addr;
+  add1->binop.op2 = IRNewConstantOperand(4);
+  list = IRAppendCode(list, add1);
+
+  IRCode *add2 = IRNewCode(&ctx->irstore, IR_CODE_ADD);
+  add2->binop.result = t1;
+  add2->binop.op1 = t1;
+  add2->binop.op2 = IRNewConstantOperand(4);
+  list = IRAppendCode(list, add2);
+
+  IRCode *jump = IRNewCode(&ctx->irstore, IR_CODE_JUMP_COND);
+  jump->jump_cond.op1 = iter;
+  jump->jump_cond.op2 = IRNewConstantOperand(size);
+  jump->jump_cond.relop = IRNewRelopOperand(RELOP_LT);
+  jump->jump_cond.dest = loop;
+  return IRAppendCode(list, jump);
 }
 
 // This function is unique.
-// All codes are translated as CompSt and pushed into IR queue.
-// Therefore we only need to add a function, pop the code from queue,
-// and link all new codes to the global IR list.
-extern IRCodeList irlist; // defined in main.c
-void IRTranslateFunc(const char *name, STNode *comp) {
+// The body of the function is translated while it is checked,
+// we only need to add a function and its parameters before it,
+// and link all new codes to the IR list of the compilation.
+void IRTranslateFunc(CCContext *ctx, const char *name, IRCodeList body) {
   // Add declaration of function
-  IRCode *code = IRNewCode(IR_CODE_FUNCTION);
+  IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_FUNCTION);
   code->function.function.kind = IR_OP_FUNCTION;
-  code->function.function.name = name;
-  code->function.root = NULL; // used in asm.c
-  irlist = IRAppendCode(irlist, code);
+  code->function.function.atom = INAtom(name, strlen(name));
+  ctx->irlist = IRAppendCode(ctx->irlist, code);
 
   // Traverse all parameters of the function
-  STEntry *entry = STSearchFunc(name);
+  STEntry *entry = STSearchFunc(ctx, name);
   Assert(entry != NULL, "func %s not found in ST", name);
   Assert(entry->type->kind == FUNCTION, "type is not func");
   for (SEField *field = entry->type->function.signature; field;
        field = field->next) {
-    if (field->kind == VOID)
+    if (field->type->kind == VOID)
       break;
-    code = IRNewCode(IR_CODE_PARAM);
-    code->param.variable = IRNewVariableOperand(field->name);
-    irlist = IRAppendCode(irlist, code);
+    STEntry *param = STSearch(ctx, field->name);
+    Assert(param != NULL, "entry %s not found in ST", field->name);
+    code = IRNewCode(&ctx->irstore, IR_CODE_PARAM);
+    code->param.variable = IRNewVariableOperand(ctx, param);
+    ctx->irlist = IRAppendCode(ctx->irlist, code);
   }
 
-  // Concat the list of function body (stored in IR queue)
-  IRCodeList list = {
-      .head = comp->ir.head,
-      .tail = comp->ir.tail,
-  };
-
   // Add a fail-safe return statement
-  IRCode *ret = IRNewCode(IR_CODE_RETURN);
+  IRCode *ret = IRNewCode(&ctx->irstore, IR_CODE_RETURN);
   ret->ret.value = IRNewConstantOperand(0);
-  list = IRAppendCode(list, ret);
+  body = IRAppendCode(body, ret);
 
-  irlist = IRConcatLists(irlist, list);
+  ctx->irlist = IRConcatLists(ctx->irlist, body);
 }
 
 // Allocate a new null operand.
 IROperand IRNewNullOperand() {
   IROperand op;
   op.kind = IR_OP_NULL;
-  op.size = 0;
+  op.number = 0;
   return op;
 }
 
 // Allocate a new temporary operand.
-static unsigned int IRTempNumber = 0;
-IROperand IRNewTempOperand() {
+IROperand IRNewTempOperand(CCContext *ctx) {
   IROperand op;
   op.kind = IR_OP_TEMP;
-  op.size = 4;
-  op.number = ++IRTempNumber;
+  op.number = ++ctx->ir.temps;
   return op;
 }
 
 // Allocate a new label operand.
-static unsigned int IRLabelNumber = 0;
-IROperand IRNewLabelOperand() {
+IROperand IRNewLabelOperand(CCContext *ctx) {
   IROperand op;
   op.kind = IR_OP_LABEL;
-  op.size = 0;
-  op.number = ++IRLabelNumber;
+  op.number = ++ctx->ir.labels;
   return op;
 }
 
-// Generate a new variable operand from STNode.
-static unsigned int IRVariableNumber = 0;
-IROperand IRNewVariableOperand(const char *name) {
-  STEntry *entry = STSearch(name);
-  Assert(entry != NULL, "entry %s not found in ST", name);
+// Generate a new variable operand of a resolved entry.
+IROperand IRNewVariableOperand(CCContext *ctx, STEntry *entry) {
   Assert(entry->number >= 0, "invalid entry number %d", entry->number);
   if (entry->number == 0) {
-    entry->number = ++IRVariableNumber;
+    entry->number = ++ctx->ir.variables;
   }
 
   IROperand op;
   if (entry->type->kind != BASIC) {
     op.kind = entry->allocate ? IR_OP_MEMBLOCK : IR_OP_VADDRESS;
-    op.size = entry->type->size;
   } else {
     op.kind = IR_OP_VARIABLE;
-    op.size = 4;
   }
-  Log("%s: %s", name,
+  Log("%s: %s", entry->id,
       (op.kind == IR_OP_MEMBLOCK
            ? "MEM"
            : (op.kind == IR_OP_VADDRESS ? "ADD" : "VAR")));
@@ -754,7 +187,6 @@ IROperand IRNewVariableOperand(const char *name) {
 IROperand IRNewConstantOperand(int value) {
   IROperand op;
   op.kind = IR_OP_CONSTANT;
-  op.size = 4;
   op.ivalue = value;
   return op;
 }
@@ -763,20 +195,16 @@ IROperand IRNewConstantOperand(int value) {
 IROperand IRNewRelopOperand(enum ENUM_RELOP relop) {
   IROperand op;
   op.kind = IR_OP_RELOP;
-  op.size = 0;
   op.relop = relop;
   return op;
 }
 
-// Generate a new function operand.
-IROperand IRNewFunctionOperand(const char *name) {
-  STEntry *entry = STSearchFunc(name);
-  Assert(entry != NULL, "entry %s not found in ST", name);
+// Generate a new function operand of a resolved entry.
+IROperand IRNewFunctionOperand(STEntry *entry) {
   IROperand op;
   op.kind = IR_OP_FUNCTION;
-  op.size = entry->type->size;
-  Assert(op.size == 4, "invalid function return size");
-  op.name = name;
+  Assert(entry->type->size == 4, "invalid function return size");
+  op.atom = INAtom(entry->id, strlen(entry->id));
   return op;
 }
 
@@ -811,7 +239,7 @@ size_t IRParseOperand(char *s, IROperand *op) {
   case IR_OP_CONSTANT:
     return sprintf(s, "#%d", op->ivalue);
   case IR_OP_FUNCTION:
-    return sprintf(s, "%s", op->name);
+    return sprintf(s, "%s", INName(op->atom));
   default:
     return sprintf(s, "(NULL)");
   }
@@ -944,20 +372,386 @@ size_t IRParseCode(char *s, IRCode *code) {
 }
 
 // Parse and output a line of IR code to file.
-static char ir_buffer[512] = {};
 size_t IRWriteCode(FILE *f, IRCode *code) {
-  IRParseCode(ir_buffer, code);
-  return fprintf(f, "%s\n", ir_buffer);
+  char buffer[512] = {};
+  IRParseCode(buffer, code);
+  return fprintf(f, "%s\n", buffer);
+}
+
+// Append a line of IR code to an output buffer.
+void IREmitCode(EMBuffer *out, IRCode *code) {
+  char *line = EMReserve(out, 512);
+  size_t length = IRParseCode(line, code);
+  line[length] = '\n';
+  out->size += length + 1;
+}
+
+// Read a decimal number which makes up all of s.
+static bool IRReadNumber(const char *s, long *value) {
+  char *end = NULL;
+  if ((*s < '0' || *s > '9') && *s != '-') return false;
+  *value = strtol(s, &end, 10);
+  return *end == '\0';
+}
+
+// Read an operand printed by IRParseOperand, but for relops and names.
+// Variables are read as IR_OP_VARIABLE, the text does not tell addresses
+// apart.
+static bool IRReadOperand(const char *s, IROperand *op) {
+  long value = 0;
+  *op = IRNewNullOperand();
+  if (strcmp(s, "(NULL)") == 0) {
+    return true;
+  } else if (s[0] == 't' && IRReadNumber(s + 1, &value)) {
+    op->kind = IR_OP_TEMP;
+  } else if (strncmp(s, "label", 5) == 0 && IRReadNumber(s + 5, &value)) {
+    op->kind = IR_OP_LABEL;
+  } else if (s[0] == 'v' && IRReadNumber(s + 1, &value)) {
+    op->kind = IR_OP_VARIABLE;
+  } else if (s[0] == '&' && s[1] == 'v' && IRReadNumber(s + 2, &value)) {
+    op->kind = IR_OP_MEMBLOCK;
+  } else if (s[0] == '#' && IRReadNumber(s + 1, &value)) {
+    *op = IRNewConstantOperand((int)value);
+    return true;
+  } else {
+    return false;
+  }
+  op->number = (unsigned int)value;
+  return value > 0;
+}
+
+// Read a relation operator printed by IRParseOperand.
+static bool IRReadRelop(const char *s, IROperand *op) {
+  static const char *relops[] = { "", "<", "<=", ">", ">=", "==", "!=" };
+  for (int relop = RELOP_LT; relop <= RELOP_NE; ++relop) {
+    if (strcmp(s, relops[relop]) == 0) {
+      *op = IRNewRelopOperand((enum ENUM_RELOP)relop);
+      return true;
+    }
+  }
+  return false;
 }
 
-// Allocate memory and initialize a code.
-IRCode *IRNewCode(enum IRCodeType kind) {
-  IRCode *code = (IRCode *)malloc(sizeof(IRCode));
+// Read the name of a function, which is interned.
+static void IRReadFunction(const char *s, IROperand *op) {
+  op->kind = IR_OP_FUNCTION;
+  op->atom = INAtom(s, strlen(s));
+}
+
+// Read a line printed by IRParseCode into code, the line is cut into
+// words in place. Return false if it is not a valid code.
+bool IRReadCode(char *line, IRCode *code) {
+  char *words[8], *save = NULL;
+  size_t n = 0;
+  for (char *word = strtok_r(line, " \t\r", &save); word != NULL && n < 8;
+       word = strtok_r(NULL, " \t\r", &save)) {
+    words[n++] = word;
+  }
+  if (n == 0 || n == 8) return false;
+  bool assign = n >= 3 && strcmp(words[1], ":=") == 0;
+
+  if (n == 3 && strcmp(words[0], "LABEL") == 0 && strcmp(words[2], ":") == 0) {
+    code->kind = IR_CODE_LABEL;
+    return IRReadOperand(words[1], &code->label.label) &&
+           code->label.label.kind == IR_OP_LABEL;
+  } else if (n == 3 && strcmp(words[0], "FUNCTION") == 0 && strcmp(words[2], ":") == 0) {
+    code->kind = IR_CODE_FUNCTION;
+    IRReadFunction(words[1], &code->function.function);
+    return true;
+  } else if (n == 2 && strcmp(words[0], "GOTO") == 0) {
+    code->kind = IR_CODE_JUMP;
+    return IRReadOperand(words[1], &code->jump.dest) && code->jump.dest.kind == IR_OP_LABEL;
+  } else if (n == 6 && strcmp(words[0], "IF") == 0 && strcmp(words[4], "GOTO") == 0) {
+    code->kind = IR_CODE_JUMP_COND;
+    return IRReadOperand(words[1], &code->jump_cond.op1) &&
+           IRReadRelop(words[2], &code->jump_cond.relop) &&
+           IRReadOperand(words[3], &code->jump_cond.op2) &&
+           IRReadOperand(words[5], &code->jump_cond.dest) &&
+           code->jump_cond.dest.kind == IR_OP_LABEL;
+  } else if (n == 3 && strcmp(words[0], "DEC") == 0) {
+    long size = 0;
+    code->kind = IR_CODE_DEC;
+    if (!IRReadOperand(words[1], &code->dec.variable) ||
+        code->dec.variable.kind != IR_OP_VARIABLE || !IRReadNumber(words[2], &size) ||
+        size <= 0) {
+      return false;
+    }
+    code->dec.variable.kind = IR_OP_MEMBLOCK;
+    code->dec.size = IRNewConstantOperand((int)size);
+    return true;
+  } else if (n == 2) {
+    static const struct {
+      const char *word;
+      enum IRCodeType kind;
+    } singles[] = {
+      { "RETURN", IR_CODE_RETURN }, { "ARG", IR_CODE_ARG }, { "PARAM", IR_CODE_PARAM },
+      { "READ", IR_CODE_READ },     { "WRITE", IR_CODE_WRITE },
+    };
+    for (size_t i = 0; i < sizeof(singles) / sizeof(singles[0]); ++i) {
+      if (strcmp(words[0], singles[i].word) == 0) {
+        code->kind = singles[i].kind;
+        return IRReadOperand(words[1], &code->arg.variable); // same place for all
+      }
+    }
+    return false;
+  } else if (assign && n == 3 && words[0][0] == '*') {
+    code->kind = IR_CODE_SAVE;
+    return IRReadOperand(words[0] + 1, &code->save.left) &&
+           IRReadOperand(words[2], &code->save.right);
+  } else if (assign && n == 3 && words[2][0] == '*') {
+    code->kind = IR_CODE_LOAD;
+    return IRReadOperand(words[0], &code->load.left) &&
+           IRReadOperand(words[2] + 1, &code->load.right);
+  } else if (assign && n == 3) {
+    code->kind = IR_CODE_ASSIGN;
+    return IRReadOperand(words[0], &code->assign.left) &&
+           IRReadOperand(words[2], &code->assign.right);
+  } else if (assign && n == 4 && strcmp(words[2], "CALL") == 0) {
+    code->kind = IR_CODE_CALL;
+    IRReadFunction(words[3], &code->call.function);
+    return IRReadOperand(words[0], &code->call.result);
+  } else if (assign && n == 5 && words[3][1] == '\0') {
+    switch (words[3][0]) {
+    case '+':
+      code->kind = IR_CODE_ADD;
+      break;
+    case '-':
+      code->kind = IR_CODE_SUB;
+      break;
+    case '*':
+      code->kind = IR_CODE_MUL;
+      break;
+    case '/':
+      code->kind = IR_CODE_DIV;
+      break;
+    default:
+      return false;
+    }
+    return IRReadOperand(words[0], &code->binop.result) &&
+           IRReadOperand(words[2], &code->binop.op1) &&
+           IRReadOperand(words[4], &code->binop.op2);
+  }
+  return false;
+}
+
+// Collect the operands of a code in ops, in the order they are printed,
+// and return how many there are.
+size_t IRCodeOperands(IRCode *code, IROperand *ops[IR_MAX_OPERANDS]) {
+  switch (code->kind) {
+  case IR_CODE_LABEL:
+    ops[0] = &code->label.label;
+    return 1;
+  case IR_CODE_FUNCTION:
+    ops[0] = &code->function.function;
+    return 1;
+  case IR_CODE_ASSIGN:
+  case IR_CODE_LOAD:
+  case IR_CODE_SAVE:
+    ops[0] = &code->assign.left;
+    ops[1] = &code->assign.right;
+    return 2;
+  case IR_CODE_ADD:
+  case IR_CODE_SUB:
+  case IR_CODE_MUL:
+  case IR_CODE_DIV:
+    ops[0] = &code->binop.result;
+    ops[1] = &code->binop.op1;
+    ops[2] = &code->binop.op2;
+    return 3;
+  case IR_CODE_JUMP:
+    ops[0] = &code->jump.dest;
+    return 1;
+  case IR_CODE_JUMP_COND:
+    ops[0] = &code->jump_cond.op1;
+    ops[1] = &code->jump_cond.relop;
+    ops[2] = &code->jump_cond.op2;
+    ops[3] = &code->jump_cond.dest;
+    return 4;
+  case IR_CODE_RETURN:
+    ops[0] = &code->ret.value;
+    return 1;
+  case IR_CODE_DEC:
+    ops[0] = &code->dec.variable;
+    ops[1] = &code->dec.size;
+    return 2;
+  case IR_CODE_CALL:
+    ops[0] = &code->call.result;
+    ops[1] = &code->call.function;
+    return 2;
+  case IR_CODE_ARG:
+  case IR_CODE_PARAM:
+  case IR_CODE_READ:
+  case IR_CODE_WRITE:
+    ops[0] = &code->arg.variable;
+    return 1;
+  default:
+    Panic("should not reach here");
+    return 0;
+  }
+}
+
+#define IR_KIND(kind) (1u << (kind))
+#define IR_PLACE (IR_KIND(IR_OP_TEMP) | IR_KIND(IR_OP_VARIABLE) | IR_KIND(IR_OP_VADDRESS))
+#define IR_VALUE (IR_PLACE | IR_KIND(IR_OP_MEMBLOCK) | IR_KIND(IR_OP_CONSTANT))
+
+// Operand kinds allowed in each place of a code, see IRCodeOperands:
+// written places hold a temp or a variable, read ones any value.
+static const unsigned int IRAllowed[IR_CODE_WRITE + 1][IR_MAX_OPERANDS] = {
+  [IR_CODE_LABEL] = { IR_KIND(IR_OP_LABEL) },
+  [IR_CODE_FUNCTION] = { IR_KIND(IR_OP_FUNCTION) },
+  [IR_CODE_ASSIGN] = { IR_PLACE, IR_VALUE },
+  [IR_CODE_ADD] = { IR_PLACE, IR_VALUE, IR_VALUE },
+  [IR_CODE_SUB] = { IR_PLACE, IR_VALUE, IR_VALUE },
+  [IR_CODE_MUL] = { IR_PLACE, IR_VALUE, IR_VALUE },
+  [IR_CODE_DIV] = { IR_PLACE, IR_VALUE, IR_VALUE },
+  [IR_CODE_LOAD] = { IR_PLACE, IR_VALUE },
+  [IR_CODE_SAVE] = { IR_VALUE, IR_VALUE },
+  [IR_CODE_JUMP] = { IR_KIND(IR_OP_LABEL) },
+  [IR_CODE_JUMP_COND] = { IR_VALUE, IR_KIND(IR_OP_RELOP), IR_VALUE, IR_KIND(IR_OP_LABEL) },
+  [IR_CODE_RETURN] = { IR_VALUE },
+  [IR_CODE_DEC] = { IR_KIND(IR_OP_MEMBLOCK), IR_KIND(IR_OP_CONSTANT) },
+  [IR_CODE_ARG] = { IR_VALUE },
+  [IR_CODE_CALL] = { IR_PLACE, IR_KIND(IR_OP_FUNCTION) },
+  [IR_CODE_PARAM] = { IR_PLACE },
+  [IR_CODE_READ] = { IR_PLACE },
+  [IR_CODE_WRITE] = { IR_VALUE },
+};
+
+// Slot of a memblock in the table of checker, or the free slot it would take.
+static IRBlockSlot *IRFindBlock(const IRChecker *checker, unsigned int number) {
+  size_t mask = checker->blockCapacity - 1;
+  size_t i = (number * 0x9e3779b1u) & mask;
+  while (checker->blocks[i].function == checker->function && checker->blocks[i].number != number) {
+    i = (i + 1) & mask;
+  }
+  return &checker->blocks[i];
+}
+
+// Remember the DEC of a memblock in the current function.
+static void IRAddBlock(IRChecker *checker, unsigned int number) {
+  if ((checker->blockCount + 1) * 2 > checker->blockCapacity) {
+    size_t capacity = checker->blockCapacity ? checker->blockCapacity * 2 : 16;
+    IRBlockSlot *old = checker->blocks;
+    size_t oldCapacity = checker->blockCapacity;
+    checker->blocks = (IRBlockSlot *)calloc(capacity, sizeof(IRBlockSlot));
+    Assert(checker->blocks != NULL, "out of memory for IR check");
+    checker->blockCapacity = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i) {
+      if (old[i].function == checker->function) *IRFindBlock(checker, old[i].number) = old[i];
+    }
+    free(old);
+  }
+  IRBlockSlot *slot = IRFindBlock(checker, number);
+  if (slot->function != checker->function) {
+    slot->number = number;
+    slot->function = checker->function;
+    ++checker->blockCount;
+  }
+}
+
+// Check the next code read, return false if the back end cannot take it.
+bool IRCheckCode(IRChecker *checker, IRCode *code) {
+  if (code->kind == IR_CODE_FUNCTION) {
+    ++checker->function; // forgets the memblocks of the last one
+    checker->blockCount = 0;
+  } else if (checker->function == 0) {
+    return false;
+  }
+  IROperand *ops[IR_MAX_OPERANDS];
+  size_t count = IRCodeOperands(code, ops);
+  for (size_t i = 0; i < count; ++i) {
+    if (ops[i]->kind > IR_OP_FUNCTION || !(IRAllowed[code->kind][i] & IR_KIND(ops[i]->kind))) {
+      return false;
+    }
+  }
+  switch (code->kind) {
+  case IR_CODE_JUMP_COND:
+    return code->jump_cond.relop.relop >= RELOP_LT && code->jump_cond.relop.relop <= RELOP_NE;
+  case IR_CODE_DEC:
+    if (code->dec.size.ivalue <= 0) return false;
+    IRAddBlock(checker, code->dec.variable.number);
+    return true;
+  default:
+    for (size_t i = 0; i < count; ++i) {
+      if (ops[i]->kind == IR_OP_MEMBLOCK &&
+          (checker->blockCount == 0 ||
+           IRFindBlock(checker, ops[i]->number)->function != checker->function)) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+void IRFreeChecker(IRChecker *checker) {
+  free(checker->blocks);
+  *checker = (IRChecker)IR_CHECKER_INIT;
+}
+
+// Add a chunk of at least size codes to a store.
+static IRChunk *IRNewChunk(IRStore *store, size_t size) {
+  IRChunk *chunk = (IRChunk *)malloc(sizeof(IRChunk) + sizeof(IRCode) * size);
+  Assert(chunk != NULL, "out of memory for IR");
+  chunk->prev = store->head;
+  chunk->used = 0;
+  chunk->size = size;
+  store->head = chunk;
+  return chunk;
+}
+
+// Take a code from the store and initialize it.
+IRCode *IRNewCode(IRStore *store, enum IRCodeType kind) {
+  IRChunk *chunk = store->head;
+  if (chunk == NULL || chunk->used == chunk->size) {
+    size_t size = chunk == NULL ? IR_CHUNK_MIN : chunk->size * 2;
+    chunk = IRNewChunk(store, size < IR_CHUNK_MAX ? size : IR_CHUNK_MAX);
+  }
+  IRCode *code = &chunk->codes[chunk->used++];
   code->kind = kind;
-  code->prev = code->next = code->parent = NULL;
+  code->prev = code->next = NULL;
   return code;
 }
 
+// Lay a list out in one block of the store, in its order, and drop every
+// other code of the store. Return the list, which may be the same one if
+// it is laid out like that already.
+IRCodeList IRCompact(IRStore *store, IRCodeList list) {
+  size_t count = 0;
+  bool inOrder = true;
+  for (IRCode *code = list.head; code != NULL; code = code->next) {
+    inOrder = inOrder && (code->next == NULL || code->next == code + 1);
+    ++count;
+  }
+  if (count == 0) {
+    IRFreeStore(store);
+    return list;
+  }
+  if (inOrder && store->head != NULL && store->head->prev == NULL &&
+      store->head->used == count && list.head == store->head->codes) {
+    return list;
+  }
+  IRStore compact = IR_STORE_INIT;
+  IRChunk *chunk = IRNewChunk(&compact, count);
+  for (IRCode *code = list.head; code != NULL; code = code->next) {
+    IRCode *copy = &chunk->codes[chunk->used++];
+    *copy = *code;
+    copy->prev = copy == chunk->codes ? NULL : copy - 1;
+    copy->next = chunk->used == count ? NULL : copy + 1;
+  }
+  IRFreeStore(store);
+  *store = compact;
+  return (IRCodeList){ chunk->codes, chunk->codes + count - 1 };
+}
+
+// Free every code of a store at once.
+void IRFreeStore(IRStore *store) {
+  for (IRChunk *chunk = store->head, *prev = NULL; chunk != NULL; chunk = prev) {
+    prev = chunk->prev;
+    free(chunk);
+  }
+  store->head = NULL;
+}
+
 // Wrap a single code to IRCodeList.
 IRCodeList IRWrapCode(IRCode *code) {
   IRCodeList list;
@@ -994,18 +788,20 @@ IRCodeList IRAppendCode(IRCodeList list, IRCode *code) {
 }
 
 // Remove a code from the list.
+// The code stays dead in its store, until the store is compacted or freed.
 IRCodeList IRRemoveCode(IRCodeList list, IRCode *code) {
   if (code == list.head) {
     list.head = code->next;
-    list.head->prev = NULL;
-  } else if (code == list.tail) {
-    list.tail = code->prev;
-    list.tail->next = NULL;
   } else {
     code->prev->next = code->next;
+  }
+  if (code == list.tail) {
+    list.tail = code->prev;
+  } else {
     code->next->prev = code->prev;
   }
-  free(code);
+  if (list.head != NULL) list.head->prev = NULL;
+  code->prev = code->next = NULL;
   return list;
 }
 
@@ -1022,12 +818,3 @@ IRCodeList IRConcatLists(IRCodeList list1, IRCodeList list2) {
     return list1;
   }
 }
-
-// Destory all codes in an IRCodeList.
-void IRDestroyList(IRCodeList list) {
-  // Do not free the IRCodeList, it is static
-  for (IRCode *code = list.head, *next = NULL; code != NULL; code = next) {
-    next = code->next; // safe loop
-    free(code);
-  }
-}
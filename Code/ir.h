@@ -9,7 +9,6 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "token.h"
-#include "rbtree.h"
 
 #define IRDebug false // <- debug switch
 #if IRDebug
@@ -19,6 +18,9 @@
 struct STNode;
 struct SEType;
 struct SEField;
+struct STEntry;
+struct CCContext;
+struct EMBuffer;
 
 enum IROperandType {
   IR_OP_NULL,
@@ -53,16 +55,16 @@ enum IRCodeType {
   IR_CODE_WRITE,
 };
 
+// An operand is its kind and one 32-bit value, 8 bytes. What the back end
+// needs besides, the size of a memblock and the place of every variable
+// in the frame, is kept in tables of each function, see asm.c.
 typedef struct IROperand {
   enum IROperandType kind;
-  size_t size; // size of memory used by operand
-  size_t offset; // offset in memory from $fp
   union {
     unsigned int number;
     int ivalue;
     float fvalue;
-    const char *name;
-    unsigned int address;
+    unsigned int atom; // of the interned name, see INName
     enum ENUM_RELOP relop;
   };
 } IROperand;
@@ -99,17 +101,35 @@ typedef struct IRCode {
     } fence, read, write, arg, param;
     struct {
       struct IROperand function;
-      struct RBNode *root; // RB tree of local variables
     } function;
   };
   struct IRCode *prev, *next;
-  struct IRCode *parent; // used in asm.c
 } IRCode;
 
 typedef struct IRCodeList {
   struct IRCode *head, *tail;
 } IRCodeList;
 
+#define IR_CHUNK_MIN 32   // <- codes in the first chunk of a store
+#define IR_CHUNK_MAX 4096 // <- codes in a chunk at most, chunks double up to it
+
+// Storage of the codes of a function: chunks of codes, which never move,
+// freed all at once. Codes sit in the order they were created, which is
+// not the order of their list; a removed code stays where it is, dead.
+// IRCompact copies a list into a single block, in its order.
+typedef struct IRChunk {
+  struct IRChunk *prev;
+  size_t used, size; // in codes
+  IRCode codes[];
+} IRChunk;
+
+typedef struct IRStore {
+  IRChunk *head;
+} IRStore;
+
+#define IR_STORE_INIT { NULL }
+extern const IRCodeList STATIC_EMPTY_IR_LIST;
+
 // List+Type+Addr, for Exp only
 typedef struct IRCodePair {
   struct IRCodeList list;
@@ -117,40 +137,63 @@ typedef struct IRCodePair {
   bool addr;
 } IRCodePair;
 
-struct IRCodePair IRTranslateExp(struct STNode *exp, struct IROperand place, bool deref);
-struct IRCodeList IRTranslateCondPre(struct STNode *exp, struct IROperand place);
-struct IRCodeList IRTranslateCond(struct STNode *exp, struct IROperand label_true, struct IROperand label_false);
-struct IRCodeList IRTranslateCompSt(struct STNode *comp);
-struct IRCodeList IRTranslateDefList(struct STNode *list);
-struct IRCodeList IRTranslateDef(struct STNode *def);
-struct IRCodeList IRTranslateDecList(struct STNode *list);
-struct IRCodeList IRTranslateDec(struct STNode *dec);
-struct IRCodeList IRTranslateVarDec(struct STNode *var);
-struct IRCodeList IRTranslateStmtList(struct STNode *list);
-struct IRCodeList IRTranslateStmt(struct STNode *stmt);
-struct IRCodeList IRTranslateArgs(struct STNode *args, struct SEField *field, struct IRCodeList *arg_list);
-
-// This function is unique, it operates on the global variable irlist.
-void IRTranslateFunc(const char *name, struct STNode *comp);
+// Numbers of the operands of a compilation.
+typedef struct IRState {
+  unsigned int temps, labels, variables;
+} IRState;
+
+// Emission helpers for the translation in type.c.
+struct IRCodeList IRAppendArith(struct CCContext *ctx, struct IRCodeList list, int op,
+                                struct IROperand place, struct IROperand t1, struct IROperand t2);
+struct IRCodeList IRAppendCopy(struct CCContext *ctx, struct IRCodeList list, struct IROperand addr,
+                               struct IROperand t1, size_t size);
+
+// This function is unique, it operates on the IR list of the compilation.
+void IRTranslateFunc(struct CCContext *ctx, const char *name, struct IRCodeList body);
 
 struct IROperand IRNewNullOperand();
-struct IROperand IRNewTempOperand();
-struct IROperand IRNewLabelOperand();
-struct IROperand IRNewVariableOperand(const char *name);
+struct IROperand IRNewTempOperand(struct CCContext *ctx);
+struct IROperand IRNewLabelOperand(struct CCContext *ctx);
+struct IROperand IRNewVariableOperand(struct CCContext *ctx, struct STEntry *entry);
 struct IROperand IRNewConstantOperand(int value);
 struct IROperand IRNewRelopOperand(enum ENUM_RELOP relop);
-struct IROperand IRNewFunctionOperand(const char *name);
+struct IROperand IRNewFunctionOperand(struct STEntry *entry);
 
 size_t IRParseOperand(char *s, IROperand *op);
 size_t IRParseCode(char *s, IRCode *code);
 size_t IRWriteCode(FILE *f, IRCode *code);
-
-struct IRCode *IRNewCode(enum IRCodeType kind);
+void IREmitCode(struct EMBuffer *out, IRCode *code);
+bool IRReadCode(char *line, IRCode *code);
+
+#define IR_MAX_OPERANDS 4
+size_t IRCodeOperands(struct IRCode *code, struct IROperand *ops[IR_MAX_OPERANDS]);
+
+// Checks IR which is read from a file, code by code, before it reaches
+// the back end: every operand is of a kind its place allows, every code
+// is in a function and every memblock has its DEC before it is used.
+typedef struct IRBlockSlot {
+  unsigned int number;
+  unsigned int function; // the slot is free unless it is the current one
+} IRBlockSlot;
+
+typedef struct IRChecker {
+  unsigned int function; // number of FUNCTION codes seen
+  IRBlockSlot *blocks;   // memblocks of the current function, by number
+  size_t blockCount, blockCapacity;
+} IRChecker;
+
+#define IR_CHECKER_INIT { 0, NULL, 0, 0 }
+
+bool IRCheckCode(IRChecker *checker, struct IRCode *code);
+void IRFreeChecker(IRChecker *checker);
+
+struct IRCode *IRNewCode(struct IRStore *store, enum IRCodeType kind);
+struct IRCodeList IRCompact(struct IRStore *store, struct IRCodeList list);
+void IRFreeStore(struct IRStore *store);
 struct IRCodeList IRWrapCode(struct IRCode *code);
 struct IRCodePair IRWrapPair(struct IRCodeList list, struct SEType *type, bool addr);
 struct IRCodeList IRAppendCode(struct IRCodeList list, struct IRCode *code);
 struct IRCodeList IRRemoveCode(struct IRCodeList list, struct IRCode *code);
 struct IRCodeList IRConcatLists(struct IRCodeList list1, struct IRCodeList list2);
-void IRDestroyList(struct IRCodeList list);
 
 #endif
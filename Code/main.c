@@ -1,65 +1,109 @@
-#include "asm.h"
-#include "ir.h"
-#include "opt.h"
-#include "semantics.h"
-#include "tree.h"
+#include "batch.h"
+#include "compiler.h"
+#include "image.h"
+#include "server.h"
+#include "source.h"
+#include "worker.h"
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <unistd.h>
-
-extern void yyrestart(FILE *);
-extern int yyparse_wrap(); // defined in syntax.y
-
-int errLineno = 0;
-bool hasErrorA = false;
-bool hasErrorB = false;
-bool hasErrorS = false;
-STNode *stroot = NULL;
-IRCodeList irlist = {NULL, NULL};
+#include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char *argv[]) {
-  if (argc <= 2) {
-    fprintf(stderr, "Usage: parser source_file output_file\n");
+  int first = 1, workers = 0;
+  bool jobs = false;
+  const char *cache = NULL;
+  for (; first + 1 < argc; first += 2) {
+    if (strcmp(argv[first], "-j") == 0) {
+      workers = atoi(argv[first + 1]);
+      jobs = true;
+    } else if (strcmp(argv[first], "-C") == 0) {
+      cache = argv[first + 1];
+    } else {
+      break;
+    }
+  }
+  // Serve requests on a socket, or send one to a server.
+  if (argc - first == 2 && strcmp(argv[first], "-s") == 0) {
+    int status = SVServe(argv[first + 1], workers, cache);
+    CCShutdown();
+    return status;
+  }
+  if (first == 1 && argc == 5 && strcmp(argv[1], "-c") == 0) {
+    return SVRequest(argv[2], argv[3], argv[4]);
+  }
+  // Run only the front end to an IR image, or only the back end on one:
+  // -M optimizes it to another image, -A assembles it without optimizing.
+  char mode = argc - first == 3 && argv[first][0] == '-' && argv[first][1] != '\0' &&
+                      argv[first][2] == '\0'
+                  ? argv[first][1] : '\0';
+  bool front = mode == 'E';
+  bool back = mode == 'B' || mode == 'M' || mode == 'A';
+  if (front || back) ++first;
+  if (argc - first < 1 || (argc - first == 1 && argv[first][0] != BA_MANIFEST) ||
+      argv[first][0] == '-') {
+    fprintf(stderr, "Usage: parser [-C cache_dir] source_file output_file\n"
+                    "       parser [-j workers] [-C cache_dir] (source_file output_file | @manifest)...\n"
+                    "       parser [-j workers] [-C cache_dir] -s socket\n"
+                    "       parser -c socket source_file output_file\n"
+                    "       parser -E source_file ir_image\n"
+                    "       parser [-C cache_dir] -B ir_image output_file\n"
+                    "       parser -M ir_image ir_image\n"
+                    "       parser -A ir_image output_file\n"
+                    "IR images whose names end in .ir are text.\n");
     return 1;
   }
-  FILE *fin = fopen(argv[1], "r");
-  if (fin == NULL) {
-    perror(argv[1]);
+  // More than one source, a manifest or a number of workers: batch mode.
+  if (!front && !back && (jobs || argc - first != 2 || argv[first][0] == BA_MANIFEST)) {
+    int status = BARun(argc - first, argv + first, workers, cache);
+    CCShutdown();
+    return status;
+  }
+  const char *input = argv[first], *output = argv[first + 1];
+  SRSource source = {NULL, 0, 0};
+  IMImage image = { NULL, 0, IM_NONE, NULL, NULL, NULL, 0, 0, 1 };
+  CCContext *ctx = CCNew(WKWORKERS); // the names of an image are interned
+  if (back ? !IMOpen(input, &image)
+           : !(SRMMAP && SRMap(input, &source)) && !SRRead(input, &source)) {
+    if (errno != 0) {
+      perror(input);
+    } else {
+      fprintf(stderr, "%s: not an IR image\n", input);
+    }
+    CCFree(ctx);
+    CCShutdown();
     return 2;
   }
-  FILE *fout = fopen(argv[2], "w+");
+  FILE *fout = fopen(output, "w+");
   if (fout == NULL) {
-    perror(argv[2]);
+    perror(output);
+    IMClose(&image);
+    CCFree(ctx);
+    CCShutdown();
+    SRRelease(&source);
     return 2;
   }
 
-  // Step 1: call yyparse to get syntax tree.
-  yyrestart(fin);
-  yyparse_wrap();
-  if (hasErrorA || hasErrorB) {
-    return 3;
+  // The whole pipeline runs in the compiler library, see compiler.c.
+  // The assembly is written out as it is produced.
+  ctx->cache = cache;
+  ctx->image = front || mode == 'M' ? IMFormatOf(output) : IM_NONE;
+  ctx->unoptimized = mode == 'A';
+  enum CCStatus status = back ? CCAssemble(ctx, &image, fout)
+                              : CCCompileBuffer(ctx, source.base, source.size, fout);
+  fwrite(ctx->errors, 1, ctx->errorsSize, stderr);
+  if (status != CC_OK) {
+    fout = freopen(output, "w", fout); // drop what has been written
   }
-  // printSyntaxTree();
-
-  // Step 2: conduct a full semantic scan.
-  // Step 3: translate to IR during the scan.
-  semanticScan();
-  if (hasErrorS) {
-    return 4;
+  if (fout != NULL) fclose(fout);
+  if (cache != NULL) {
+    printf("code cache: %zu hits, %zu misses\n", ctx->cacheHits, ctx->cacheMisses);
   }
 
-  // Step 4: do IR optimization.
-  optimize();
-  //for (IRCode *code = irlist.head; code != NULL; code = code->next) {
-  //  IRWriteCode(fout, code);
-  //}
-
-  // Step 5: translate to ASM and output.
-  assemble(fout);
-
-  // do not teardown until all work is done!
-  teardownSyntaxTree(stroot);
-  IRDestroyList(irlist);
-
-  return 0;
+  CCFree(ctx);
+  CCShutdown();
+  IMClose(&image);
+  SRRelease(&source);
+  return status;
 }
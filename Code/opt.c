@@ -5,35 +5,36 @@
 // #define DEBUG // <- optimizer debugging switch
 #include "debug.h"
 
-extern IRCodeList irlist;
-
-int timestamp = 0;
-int valid_ts = -1;
-RBNode *OCRoot = NULL;
+// Optimize the constants of the program at once.
+IRCodeList optimize(IRCodeList list) {
+  OCContext ctx = OC_CONTEXT_INIT;
+  return OCOptimize(&ctx, list);
+}
 
-// Optimize the constants.
-void optimize() {
+// Optimize the constants of a list, return the list after optimization.
+// All state lives in ctx, lists can be optimized on different threads.
+IRCodeList OCOptimize(OCContext *ctx, IRCodeList list) {
   // Step 1: replace all values with constants if possible
   Log("optimization step 1");
-  for (IRCode *code = irlist.head, *next = NULL; code != NULL; code = next) {
+  for (IRCode *code = list.head, *next = NULL; code != NULL; code = next) {
     next = code->next;
     switch (code->kind) {
     case IR_CODE_LABEL:
     case IR_CODE_FUNCTION: {
       // invalid all constants
-      valid_ts = ++timestamp;
+      ctx->valid_ts = ++ctx->timestamp;
       break;
     }
     case IR_CODE_ASSIGN: {
       Log("assign");
-      OCCreate(code->assign.left);
-      OCCreate(code->assign.right);
-      OCReplace(&code->assign.right);
-      OCInvalid(code->assign.left);
+      OCCreate(ctx, code->assign.left);
+      OCCreate(ctx, code->assign.right);
+      OCReplace(ctx, &code->assign.right);
+      OCInvalid(ctx, code->assign.left);
       if (code->assign.right.kind == IR_OP_CONSTANT) {
         Log("operand updated, type %d, number %d", code->assign.left.kind,
             code->assign.left.number);
-        OCUpdate(code->assign.left, code->assign.right.ivalue);
+        OCUpdate(ctx, code->assign.left, code->assign.right.ivalue);
       }
       break;
     }
@@ -41,12 +42,12 @@ void optimize() {
     case IR_CODE_SUB:
     case IR_CODE_MUL:
     case IR_CODE_DIV: {
-      OCCreate(code->binop.result);
-      OCCreate(code->binop.op1);
-      OCCreate(code->binop.op2);
-      OCReplace(&code->binop.op1);
-      OCReplace(&code->binop.op2);
-      OCInvalid(code->binop.result);
+      OCCreate(ctx, code->binop.result);
+      OCCreate(ctx, code->binop.op1);
+      OCCreate(ctx, code->binop.op2);
+      OCReplace(ctx, &code->binop.op1);
+      OCReplace(ctx, &code->binop.op2);
+      OCInvalid(ctx, code->binop.result);
       // special case: do not handle dividing by zero
       if (code->binop.op1.kind == IR_OP_CONSTANT &&
           code->binop.op2.kind == IR_OP_CONSTANT &&
@@ -72,7 +73,7 @@ void optimize() {
         code->kind = IR_CODE_ASSIGN;
         code->assign.left = result;
         code->assign.right = IRNewConstantOperand(val);
-        OCUpdate(result, val);
+        OCUpdate(ctx, result, val);
       } else if (code->kind == IR_CODE_ADD || code->kind == IR_CODE_SUB) {
         if (code->kind == IR_CODE_ADD &&
             code->binop.op1.kind == IR_OP_CONSTANT &&
@@ -102,7 +103,7 @@ void optimize() {
           code->kind = IR_CODE_ASSIGN;
           code->assign.left = res;
           code->assign.right = IRNewConstantOperand(0);
-          OCUpdate(res, 0);
+          OCUpdate(ctx, res, 0);
         }
       } else if (code->kind == IR_CODE_DIV) {
         // 0 / something, do not handle dividing zero
@@ -112,67 +113,67 @@ void optimize() {
           code->kind = IR_CODE_ASSIGN;
           code->assign.left = res;
           code->assign.right = IRNewConstantOperand(0);
-          OCUpdate(res, 0);
+          OCUpdate(ctx, res, 0);
         }
       }
       break;
     }
     case IR_CODE_LOAD: {
       // do not optimize address
-      OCCreate(code->load.left);
-      OCCreate(code->load.right);
-      OCInvalid(code->load.left);
+      OCCreate(ctx, code->load.left);
+      OCCreate(ctx, code->load.right);
+      OCInvalid(ctx, code->load.left);
       break;
     }
     case IR_CODE_SAVE: {
-      OCCreate(code->save.left);
-      OCCreate(code->save.right);
-      OCReplace(&code->save.right);
-      OCInvalid(code->save.left);
+      OCCreate(ctx, code->save.left);
+      OCCreate(ctx, code->save.right);
+      OCReplace(ctx, &code->save.right);
+      OCInvalid(ctx, code->save.left);
       break;
     }
     case IR_CODE_JUMP:
       break;
     case IR_CODE_JUMP_COND: {
-      OCCreate(code->jump_cond.op1);
-      OCCreate(code->jump_cond.op2);
-      OCReplace(&code->jump_cond.op1);
-      OCReplace(&code->jump_cond.op2);
+      OCCreate(ctx, code->jump_cond.op1);
+      OCCreate(ctx, code->jump_cond.op2);
+      OCReplace(ctx, &code->jump_cond.op1);
+      OCReplace(ctx, &code->jump_cond.op2);
       break;
     }
     case IR_CODE_RETURN: {
-      OCCreate(code->ret.value);
-      OCReplace(&code->ret.value);
+      OCCreate(ctx, code->ret.value);
+      OCReplace(ctx, &code->ret.value);
       break;
     }
     case IR_CODE_DEC: {
-      OCCreate(code->dec.variable);
-      OCInvalid(code->dec.variable);
+      OCCreate(ctx, code->dec.variable);
+      OCInvalid(ctx, code->dec.variable);
       break;
     }
     case IR_CODE_ARG: {
-      OCCreate(code->arg.variable);
-      OCReplace(&code->arg.variable);
+      OCCreate(ctx, code->arg.variable);
+      OCReplace(ctx, &code->arg.variable);
       break;
     }
     case IR_CODE_CALL: {
-      OCCreate(code->call.result);
-      OCInvalid(code->call.result);
+      OCCreate(ctx, code->call.result);
+      OCInvalid(ctx, code->call.result);
       break;
     }
     case IR_CODE_PARAM: {
-      OCCreate(code->param.variable);
-      OCInvalid(code->param.variable);
+      OCCreate(ctx, code->param.variable);
+      OCInvalid(ctx, code->param.variable);
       break;
     }
     case IR_CODE_READ: {
-      OCCreate(code->read.variable);
-      OCInvalid(code->read.variable);
+      OCCreate(ctx, code->read.variable);
+      OCInvalid(ctx, code->read.variable);
       break;
     }
     case IR_CODE_WRITE: {
-      OCCreate(code->write.variable);
-      OCReplace(&code->write.variable);
+      OCCreate(ctx, code->write.variable);
+      OCReplace(ctx, &code->write.variable);
       break;
     }
     default:
@@ -182,31 +183,31 @@ void optimize() {
 
   // Step 2: replace all values with variables if possible
   Log("optimization step 2");
-  valid_ts = ++timestamp;
-  for (IRCode *code = irlist.head, *next = NULL; code != NULL; code = next) {
+  ctx->valid_ts = ++ctx->timestamp;
+  for (IRCode *code = list.head, *next = NULL; code != NULL; code = next) {
     next = code->next;
     switch (code->kind) {
     case IR_CODE_LABEL:
     case IR_CODE_FUNCTION: {
       // invalid all variables
-      valid_ts = ++timestamp;
+      ctx->valid_ts = ++ctx->timestamp;
       break;
     }
     case IR_CODE_ASSIGN: {
-      OCReplace2(&code->assign.right);
-      OCInvalid(code->assign.left);
+      OCReplace2(ctx, &code->assign.right);
+      OCInvalid(ctx, code->assign.left);
       if (code->assign.right.kind == IR_OP_TEMP) {
         Log("operand updated, TEM, number %d", code->assign.left.number);
-        OCUpdate2(code->assign.left, code->assign.right.number, TEM);
+        OCUpdate2(ctx, code->assign.left, code->assign.right.number, TEM);
       } else if (code->assign.right.kind == IR_OP_VARIABLE) {
         Log("operand updated, VAR, number %d", code->assign.left.number);
-        OCUpdate2(code->assign.left, code->assign.right.number, VAR);
+        OCUpdate2(ctx, code->assign.left, code->assign.right.number, VAR);
       } else if (code->assign.right.kind == IR_OP_VADDRESS) {
         Log("operand updated, ADD, number %d", code->assign.left.number);
-        OCUpdate2(code->assign.left, code->assign.right.number, ADD);
+        OCUpdate2(ctx, code->assign.left, code->assign.right.number, ADD);
       } else if (code->assign.right.kind == IR_OP_MEMBLOCK) {
         Log("operand updated, MEM, number %d", code->assign.left.number);
-        OCUpdate2(code->assign.left, code->assign.right.number, MEM);
+        OCUpdate2(ctx, code->assign.left, code->assign.right.number, MEM);
       }
       break;
     }
@@ -214,36 +215,36 @@ void optimize() {
     case IR_CODE_SUB:
     case IR_CODE_MUL:
     case IR_CODE_DIV: {
-      OCReplace2(&code->binop.op1);
-      OCReplace2(&code->binop.op2);
-      OCInvalid(code->binop.result);
+      OCReplace2(ctx, &code->binop.op1);
+      OCReplace2(ctx, &code->binop.op2);
+      OCInvalid(ctx, code->binop.result);
       break;
     }
     case IR_CODE_LOAD: {
       // do not optimize address
-      OCInvalid(code->load.left);
+      OCInvalid(ctx, code->load.left);
       break;
     }
     case IR_CODE_SAVE: {
-      OCReplace2(&code->save.right);
-      OCInvalid(code->save.left);
+      OCReplace2(ctx, &code->save.right);
+      OCInvalid(ctx, code->save.left);
       break;
     }
     case IR_CODE_JUMP:
       break;
     case IR_CODE_JUMP_COND: {
-      OCReplace2(&code->jump_cond.op1);
-      OCReplace2(&code->jump_cond.op2);
+      OCReplace2(ctx, &code->jump_cond.op1);
+      OCReplace2(ctx, &code->jump_cond.op2);
       break;
     }
     case IR_CODE_RETURN: {
-      OCReplace2(&code->ret.value);
+      OCReplace2(ctx, &code->ret.value);
       break;
     }
     case IR_CODE_DEC:
       break;
     case IR_CODE_ARG: {
-      OCReplace2(&code->arg.variable);
+      OCReplace2(ctx, &code->arg.variable);
       break;
     }
     case IR_CODE_CALL:
@@ -251,7 +252,7 @@ void optimize() {
     case IR_CODE_READ:
       break;
     case IR_CODE_WRITE: {
-      OCReplace2(&code->write.variable);
+      OCReplace2(ctx, &code->write.variable);
       break;
     }
     default:
@@ -261,16 +262,16 @@ void optimize() {
 
   // Step 3: mark all important variables
   Log("optimization step 3");
-  for (IRCode *code = irlist.tail, *prev = NULL; code != NULL; code = prev) {
+  for (IRCode *code = list.tail, *prev = NULL; code != NULL; code = prev) {
     prev = code->prev;
     switch (code->kind) {
     case IR_CODE_LABEL:
     case IR_CODE_FUNCTION:
       break;
     case IR_CODE_ASSIGN: {
-      OCNode *node = OCFind(code->assign.left);
+      OCNode *node = OCFind(ctx, code->assign.left);
       if (node == NULL || node->important) {
-        OCImportant(code->assign.right);
+        OCImportant(ctx, code->assign.right);
       }
       break;
     }
@@ -278,40 +279,40 @@ void optimize() {
     case IR_CODE_SUB:
     case IR_CODE_MUL:
     case IR_CODE_DIV: {
-      OCNode *node = OCFind(code->binop.result);
+      OCNode *node = OCFind(ctx, code->binop.result);
       if (node == NULL || node->important) {
-        OCImportant(code->binop.op1);
-        OCImportant(code->binop.op2);
+        OCImportant(ctx, code->binop.op1);
+        OCImportant(ctx, code->binop.op2);
       }
       break;
     }
     case IR_CODE_LOAD: {
-      OCNode *node = OCFind(code->load.left);
+      OCNode *node = OCFind(ctx, code->load.left);
       if (node == NULL || node->important) {
-        OCImportant(code->load.right);
+        OCImportant(ctx, code->load.right);
       }
       break;
     }
     case IR_CODE_SAVE: {
-      OCImportant(code->save.left);
-      OCImportant(code->save.right);
+      OCImportant(ctx, code->save.left);
+      OCImportant(ctx, code->save.right);
       break;
     }
     case IR_CODE_JUMP:
       break;
     case IR_CODE_JUMP_COND: {
-      OCImportant(code->jump_cond.op1);
-      OCImportant(code->jump_cond.op2);
+      OCImportant(ctx, code->jump_cond.op1);
+      OCImportant(ctx, code->jump_cond.op2);
       break;
     }
     case IR_CODE_RETURN: {
-      OCImportant(code->ret.value);
+      OCImportant(ctx, code->ret.value);
       break;
     }
     case IR_CODE_DEC:
       break;
     case IR_CODE_ARG: {
-      OCImportant(code->arg.variable);
+      OCImportant(ctx, code->arg.variable);
       break;
     }
     case IR_CODE_CALL:
@@ -319,7 +320,7 @@ void optimize() {
     case IR_CODE_READ:
       break;
     case IR_CODE_WRITE: {
-      OCImportant(code->write.variable);
+      OCImportant(ctx, code->write.variable);
       break;
     }
     default:
@@ -330,21 +331,21 @@ void optimize() {
 
   // Step 4: delete all inactive variables
   Log("optimization step 4");
-  for (IRCode *code = irlist.tail, *prev = NULL; code != NULL; code = prev) {
+  for (IRCode *code = list.tail, *prev = NULL; code != NULL; code = prev) {
     prev = code->prev;
     switch (code->kind) {
     case IR_CODE_LABEL:
     case IR_CODE_FUNCTION:
       break;
     case IR_CODE_ASSIGN: {
-      OCNode *node = OCFind(code->assign.left);
+      OCNode *node = OCFind(ctx, code->assign.left);
       bool delete = node != NULL && !node->important && !node->active;
-      OCDeactivate(code->assign.left);
+      OCDeactivate(ctx, code->assign.left);
       if (delete) {
         Log("remove ASSIGN");
-        irlist = IRRemoveCode(irlist, code);
+        list = IRRemoveCode(list, code);
       } else {
-        OCActivate(code->assign.right);
+        OCActivate(ctx, code->assign.right);
       }
       break;
     }
@@ -352,69 +353,69 @@ void optimize() {
     case IR_CODE_SUB:
     case IR_CODE_MUL:
     case IR_CODE_DIV: {
-      OCNode *node = OCFind(code->binop.result);
+      OCNode *node = OCFind(ctx, code->binop.result);
       bool delete = node != NULL && !node->important && !node->active;
-      OCDeactivate(code->binop.result);
+      OCDeactivate(ctx, code->binop.result);
       if (delete) {
         Log("remove BINOP");
-        irlist = IRRemoveCode(irlist, code);
+        list = IRRemoveCode(list, code);
       } else {
-        OCActivate(code->binop.op1);
-        OCActivate(code->binop.op2);
+        OCActivate(ctx, code->binop.op1);
+        OCActivate(ctx, code->binop.op2);
       }
       break;
     }
     case IR_CODE_LOAD: {
-      OCNode *node = OCFind(code->load.left);
+      OCNode *node = OCFind(ctx, code->load.left);
       bool delete = node != NULL && !node->important && !node->active;
-      OCDeactivate(code->load.left);
+      OCDeactivate(ctx, code->load.left);
       if (delete) {
         Log("remove LOAD");
-        irlist = IRRemoveCode(irlist, code);
+        list = IRRemoveCode(list, code);
       } else {
-        OCActivate(code->load.right);
+        OCActivate(ctx, code->load.right);
       }
       break;
     }
     case IR_CODE_SAVE: {
       // cannot delete SAVE
-      OCActivate(code->save.left);
-      OCActivate(code->save.right);
+      OCActivate(ctx, code->save.left);
+      OCActivate(ctx, code->save.right);
       break;
     }
     case IR_CODE_JUMP:
       break;
     case IR_CODE_JUMP_COND: {
-      OCActivate(code->jump_cond.op1);
-      OCActivate(code->jump_cond.op2);
+      OCActivate(ctx, code->jump_cond.op1);
+      OCActivate(ctx, code->jump_cond.op2);
       break;
     }
     case IR_CODE_RETURN: {
-      OCActivate(code->ret.value);
+      OCActivate(ctx, code->ret.value);
       break;
     }
     case IR_CODE_DEC: {
-      OCDeactivate(code->dec.variable);
+      OCDeactivate(ctx, code->dec.variable);
       break;
     }
     case IR_CODE_ARG: {
-      OCActivate(code->arg.variable);
+      OCActivate(ctx, code->arg.variable);
       break;
     }
     case IR_CODE_CALL: {
-      OCDeactivate(code->call.result);
+      OCDeactivate(ctx, code->call.result);
       break;
     }
     case IR_CODE_PARAM: {
-      OCDeactivate(code->param.variable);
+      OCDeactivate(ctx, code->param.variable);
       break;
     }
     case IR_CODE_READ: {
-      OCDeactivate(code->read.variable);
+      OCDeactivate(ctx, code->read.variable);
       break;
     }
     case IR_CODE_WRITE: {
-      OCActivate(code->write.variable);
+      OCActivate(ctx, code->write.variable);
       break;
     }
     default:
@@ -424,16 +425,16 @@ void optimize() {
 
   // Step 5 - manual optimization
   Log("optimization step 5");
-  for (IRCode *code = irlist.head, *next = NULL; code != NULL; code = next) {
+  for (IRCode *code = list.head, *next = NULL; code != NULL; code = next) {
     next = code->next;
     if (code != NULL && next != NULL) {
       if (code->kind == IR_CODE_RETURN && next->kind == IR_CODE_RETURN) {
-        irlist = IRRemoveCode(irlist, next);
+        list = IRRemoveCode(list, next);
         next = code->next;
       }
     }
   }
-  for (IRCode *code = irlist.head, *next = NULL; code != NULL; code = next) {
+  for (IRCode *code = list.head, *next = NULL; code != NULL; code = next) {
     next = code->next;
     if (code != NULL && next != NULL) {
       if (code->kind == IR_CODE_ASSIGN) {
@@ -443,7 +444,7 @@ void optimize() {
           if (next->kind == IR_CODE_ASSIGN) {
             if (code->assign.left.kind == next->assign.left.kind &&
                 code->assign.left.number == next->assign.left.number) {
-              irlist = IRRemoveCode(irlist, code);
+              list = IRRemoveCode(list, code);
             }
           } else if (next->kind == IR_CODE_ADD || next->kind == IR_CODE_SUB ||
                      next->kind == IR_CODE_MUL || next->kind == IR_CODE_DIV) {
@@ -453,7 +454,7 @@ void optimize() {
                   code->assign.left.number != next->binop.op1.number) {
                 if (code->assign.left.kind != next->binop.op2.kind ||
                     code->assign.left.number != next->binop.op2.number) {
-                  irlist = IRRemoveCode(irlist, code);
+                  list = IRRemoveCode(list, code);
                 }
               }
             }
@@ -462,17 +463,19 @@ void optimize() {
       }
     }
   }
+  RBDestroy(&ctx->root, free);
+  return list;
 }
 
 // Optimize an operand with constant value if possible.
 // Return true if the operand is replaced by a constant.
-bool OCReplace(IROperand *op) {
+bool OCReplace(OCContext *ctx, IROperand *op) {
   if (op->kind == IR_OP_CONSTANT) {
     return true;
   } else if (op->kind == IR_OP_TEMP || op->kind == IR_OP_VARIABLE ||
              op->kind == IR_OP_VADDRESS) {
-    OCNode *node = OCFind(*op);
-    if (node != NULL && node->timestamp >= valid_ts) {
+    OCNode *node = OCFind(ctx, *op);
+    if (node != NULL && node->timestamp >= ctx->valid_ts) {
       *op = IRNewConstantOperand(node->value);
       return true;
     }
@@ -482,11 +485,11 @@ bool OCReplace(IROperand *op) {
 
 // Optimize an operand with another variable if possible.
 // Return true if the operand is replaced by a variable.
-bool OCReplace2(IROperand *op) {
+bool OCReplace2(OCContext *ctx, IROperand *op) {
   if (op->kind == IR_OP_TEMP || op->kind == IR_OP_VARIABLE ||
       op->kind == IR_OP_VADDRESS) {
-    OCNode *node = OCFind(*op);
-    if (node != NULL && node->timestamp >= valid_ts) {
+    OCNode *node = OCFind(ctx, *op);
+    if (node != NULL && node->timestamp >= ctx->valid_ts) {
       switch (node->reserved) {
       case TEM:
         op->kind = IR_OP_TEMP;
@@ -511,10 +514,10 @@ bool OCReplace2(IROperand *op) {
 }
 
 // Create a new operand in RB and set invalid.
-void OCCreate(IROperand op) {
+void OCCreate(OCContext *ctx, IROperand op) {
   if (op.kind == IR_OP_TEMP || op.kind == IR_OP_VARIABLE ||
       op.kind == IR_OP_VADDRESS) {
-    OCNode *target = OCFind(op);
+    OCNode *target = OCFind(ctx, op);
     if (target == NULL) {
       OCNode *node = (OCNode *)malloc(sizeof(OCNode));
       node->is_var = op.kind != IR_OP_TEMP;
@@ -523,43 +526,43 @@ void OCCreate(IROperand op) {
       node->timestamp = -1;
       node->important = false;
       node->active = false;
-      RBInsert(&OCRoot, node, OCComp);
+      RBInsert(&ctx->root, node, OCComp);
     }
   }
 }
 
 // Update a value of node in RB tree.
-void OCUpdate(IROperand op, int value) {
+void OCUpdate(OCContext *ctx, IROperand op, int value) {
   if (op.kind == IR_OP_TEMP || op.kind == IR_OP_VARIABLE ||
       op.kind == IR_OP_VADDRESS) {
-    OCNode *target = OCFind(op);
+    OCNode *target = OCFind(ctx, op);
     if (target != NULL) {
       target->value = value;
-      target->timestamp = timestamp;
+      target->timestamp = ctx->timestamp;
     }
   }
 }
 
 // Update a value of node with reserved field in RB tree.
-void OCUpdate2(IROperand op, int value, int reserved) {
+void OCUpdate2(OCContext *ctx, IROperand op, int value, int reserved) {
   if (op.kind == IR_OP_TEMP || op.kind == IR_OP_VARIABLE) {
-    OCNode *target = OCFind(op);
+    OCNode *target = OCFind(ctx, op);
     if (target != NULL) {
       target->value = value;
       target->reserved = reserved;
-      target->timestamp = timestamp;
+      target->timestamp = ctx->timestamp;
     }
   }
 }
 
 // Find the constant from the RB tree.
-OCNode *OCFind(IROperand op) {
+OCNode *OCFind(OCContext *ctx, IROperand op) {
   if (op.kind == IR_OP_TEMP || op.kind == IR_OP_VARIABLE ||
       op.kind == IR_OP_VADDRESS) {
     OCNode node;
     node.is_var = op.kind != IR_OP_TEMP;
     node.number = op.number;
-    RBNode *target = RBSearch(&OCRoot, &node, OCComp);
+    RBNode *target = RBSearch(&ctx->root, &node, OCComp);
     if (target != NULL) {
       return OCComp(target->value, &node) == 0 ? target->value : NULL;
     }
@@ -568,32 +571,32 @@ OCNode *OCFind(IROperand op) {
 }
 
 // Set an constant as invalid.
-void OCInvalid(IROperand op) {
-  OCNode *node = OCFind(op);
+void OCInvalid(OCContext *ctx, IROperand op) {
+  OCNode *node = OCFind(ctx, op);
   if (node != NULL) {
     node->timestamp = -1;
   }
 }
 
 // Set an constant as important.
-void OCImportant(IROperand op) {
-  OCNode *node = OCFind(op);
+void OCImportant(OCContext *ctx, IROperand op) {
+  OCNode *node = OCFind(ctx, op);
   if (node != NULL) {
     node->important = true;
   }
 }
 
 // Set an operand as active.
-void OCActivate(IROperand op) {
-  OCNode *node = OCFind(op);
+void OCActivate(OCContext *ctx, IROperand op) {
+  OCNode *node = OCFind(ctx, op);
   if (node != NULL) {
     node->active = true;
   }
 }
 
 // Set an operand as inactive.
-void OCDeactivate(IROperand op) {
-  OCNode *node = OCFind(op);
+void OCDeactivate(OCContext *ctx, IROperand op) {
+  OCNode *node = OCFind(ctx, op);
   if (node != NULL) {
     node->active = false;
   }
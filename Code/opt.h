@@ -4,6 +4,8 @@
 #include <stdbool.h>
 
 struct IROperand;
+struct IRCodeList;
+struct RBNode;
 
 #define TEM 0
 #define VAR 1
@@ -21,19 +23,29 @@ typedef struct OCNode {
   bool active;    // whether the value is used afterwards
 } OCNode;
 
-void optimize();
-
-bool OCReplace(struct IROperand *op);
-bool OCReplace2(struct IROperand *op);
-
-void OCCreate(struct IROperand op);
-void OCUpdate(struct IROperand op, int value);
-void OCUpdate2(struct IROperand op, int value, int reserved);
-OCNode *OCFind(struct IROperand op);
-void OCInvalid(struct IROperand op);
-void OCImportant(struct IROperand op);
-void OCActivate(struct IROperand op);
-void OCDeactivate(struct IROperand op);
+// State of optimizing one list, nothing is shared between contexts.
+typedef struct OCContext {
+  int timestamp;
+  int valid_ts;
+  struct RBNode *root; // operands seen in the list
+} OCContext;
+
+#define OC_CONTEXT_INIT { 0, -1, NULL }
+
+struct IRCodeList optimize(struct IRCodeList list);
+struct IRCodeList OCOptimize(OCContext *ctx, struct IRCodeList list);
+
+bool OCReplace(OCContext *ctx, struct IROperand *op);
+bool OCReplace2(OCContext *ctx, struct IROperand *op);
+
+void OCCreate(OCContext *ctx, struct IROperand op);
+void OCUpdate(OCContext *ctx, struct IROperand op, int value);
+void OCUpdate2(OCContext *ctx, struct IROperand op, int value, int reserved);
+OCNode *OCFind(OCContext *ctx, struct IROperand op);
+void OCInvalid(OCContext *ctx, struct IROperand op);
+void OCImportant(OCContext *ctx, struct IROperand op);
+void OCActivate(OCContext *ctx, struct IROperand op);
+void OCDeactivate(OCContext *ctx, struct IROperand op);
 int OCComp(const void *a, const void *b);
 
 #endif
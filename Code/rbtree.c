@@ -325,9 +325,22 @@ void RBDelete(RBNode **root, void *value, int (*cmp)(const void *, const void *)
 
 void RBDestroy(RBNode **root, void (*destroy)(void *)) {
   if (!root || !*root) return;
-  if ((*root)->left)  RBDestroy(&((*root)->left),  destroy);
-  if ((*root)->right) RBDestroy(&((*root)->right), destroy);
-  if (destroy != NULL) destroy((*root)->value);
-  free(*root);
+  RBNode *node = *root;
+  while (node != NULL) {
+    if (node->left) {
+      node = node->left;
+    } else if (node->right) {
+      node = node->right;
+    } else {
+      RBNode *parent = node == *root ? NULL : node->parent;
+      if (parent != NULL) {
+        if (parent->left == node) parent->left = NULL;
+        else parent->right = NULL;
+      }
+      if (destroy != NULL) destroy(node->value);
+      free(node);
+      node = parent;
+    }
+  }
   *root = NULL;
 }
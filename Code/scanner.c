@@ -0,0 +1,629 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scanner.h"
+#include "intern.h"
+#include "token.h"
+#include "tree.h"
+#include "syntax.tab.h"
+#include "compiler.h"
+#include "debug.h"
+
+#if SCHAND
+
+/**
+ * Character classes are tested a whole vector at a time: the bytes of an
+ * aligned chunk are compared against the class and the movemask gives one
+ * bit per byte. Aligned loads never cross a page, so reading the chunk
+ * that holds the terminating '\0' is always safe. Without SSE2 the same
+ * code runs with one-byte "vectors".
+ * */
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i SCVector;
+#define SC_WIDTH    32
+#define SC_FULL     0xffffffffu
+#define SCLoad(p)   _mm256_load_si256((const __m256i *)(p))
+#define SCEq(v, c)  _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+#define SCGt(v, c)  _mm256_cmpgt_epi8(v, _mm256_set1_epi8(c))
+#define SCLt(v, c)  _mm256_cmpgt_epi8(_mm256_set1_epi8(c), v)
+#define SCOr(a, b)  _mm256_or_si256(a, b)
+#define SCAnd(a, b) _mm256_and_si256(a, b)
+#define SCLower(v)  _mm256_or_si256(v, _mm256_set1_epi8(0x20))
+#define SCMask(v)   ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i SCVector;
+#define SC_WIDTH    16
+#define SC_FULL     0xffffu
+#define SCLoad(p)   _mm_load_si128((const __m128i *)(p))
+#define SCEq(v, c)  _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+#define SCGt(v, c)  _mm_cmpgt_epi8(v, _mm_set1_epi8(c))
+#define SCLt(v, c)  _mm_cmpgt_epi8(_mm_set1_epi8(c), v)
+#define SCOr(a, b)  _mm_or_si128(a, b)
+#define SCAnd(a, b) _mm_and_si128(a, b)
+#define SCLower(v)  _mm_or_si128(v, _mm_set1_epi8(0x20))
+#define SCMask(v)   ((uint32_t)_mm_movemask_epi8(v))
+#else
+typedef signed char SCVector;
+#define SC_WIDTH    1
+#define SC_FULL     1u
+#define SCLoad(p)   (*(const signed char *)(p))
+#define SCEq(v, c)  ((v) == (c))
+#define SCGt(v, c)  ((v) > (c))
+#define SCLt(v, c)  ((v) < (c))
+#define SCOr(a, b)  ((a) || (b))
+#define SCAnd(a, b) ((a) && (b))
+#define SCLower(v)  ((v) | 0x20)
+#define SCMask(v)   ((uint32_t)(v))
+#endif
+
+#define SCAlign(p) ((char *)((uintptr_t)(p) & ~(uintptr_t)(SC_WIDTH - 1)))
+#define SCLead(n)  ((SC_FULL << (n)) & SC_FULL) // bits of bytes from the n-th on
+
+// [ \t\r\n], the {newline} and {whitespace} rules
+#define SCBlank(v) \
+  SCOr(SCOr(SCEq(v, ' '), SCEq(v, '\t')), SCOr(SCEq(v, '\r'), SCEq(v, '\n')))
+// [0-9a-zA-Z_], the tail of {id} and {invalidnum}
+#define SCWord(v)                                                        \
+  SCOr(SCOr(SCAnd(SCGt(v, '0' - 1), SCLt(v, '9' + 1)),                   \
+            SCAnd(SCGt(SCLower(v), 'a' - 1), SCLt(SCLower(v), 'z' + 1))), \
+       SCEq(v, '_'))
+
+#define SCNotWord(v)     (~SCMask(SCWord(v)) & SC_FULL)
+#define SCLineEnd(v)     SCMask(SCOr(SCEq(v, '\n'), SCEq(v, '\0')))
+#define SCCommentStop(v) SCMask(SCOr(SCOr(SCEq(v, '*'), SCEq(v, '\n')), SCEq(v, '\0')))
+
+// Define a function to find the first byte from p on whose bit is set by STOP.
+#define SC_FINDER(NAME, STOP)                                  \
+  static inline char *NAME(char *p) {                          \
+    char *chunk = SCAlign(p);                                  \
+    uint32_t mask = STOP(SCLoad(chunk)) & SCLead(p - chunk);   \
+    while (mask == 0) {                                        \
+      chunk += SC_WIDTH;                                       \
+      mask = STOP(SCLoad(chunk));                              \
+    }                                                          \
+    return chunk + __builtin_ctz(mask);                        \
+  }
+
+SC_FINDER(SCSpanWord, SCNotWord)
+SC_FINDER(SCFindLineEnd, SCLineEnd)
+SC_FINDER(SCFindCommentStop, SCCommentStop)
+
+/**
+ * Most identifiers and blank runs are shorter than a vector, where the
+ * mask setup costs more than it saves, so the first SC_SHORT bytes of
+ * a run are tested one at a time before switching to vectors.
+ * */
+#define SC_SHORT 8
+
+#define SC_DIGIT(c)  ((c) >= '0' && (c) <= '9')
+#define SC_OCTAL(c)  ((c) >= '0' && (c) <= '7')
+#define SC_HEX(c)    (SC_DIGIT(c) || (((c) | 0x20) >= 'a' && ((c) | 0x20) <= 'f'))
+#define SC_LETTER(c) ((((c) | 0x20) >= 'a' && ((c) | 0x20) <= 'z') || (c) == '_')
+#define SC_BLANK(c)  ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+#define SC_WORD(c)   (SC_DIGIT(c) || SC_LETTER(c))
+
+// Find the end of the run of [0-9a-zA-Z_] from p on.
+static inline char *SCSkipWord(char *p) {
+  for (char *short_end = p + SC_SHORT; p < short_end; ++p) {
+    if (!SC_WORD(*p)) return p;
+  }
+  return SCSpanWord(p);
+}
+
+// Set the value of the token in text by a getter of token.c.
+#define SCValue(s, TYPE) ((s)->lval->TYPE##val = get##TYPE##Token((s)->text, (size_t)(s)->leng))
+
+void SCStart(SCScanner *s, char *buffer, size_t size, int lineno, int column) {
+  s->cursor = buffer;
+  s->end = buffer + size;
+  s->hold = NULL;
+  s->text = buffer;
+  s->leng = 0;
+  s->lineno = lineno;
+  s->column = column;
+  s->streamed = 0;
+  s->failed = false;
+  s->root = 0;
+  s->block = NULL;
+}
+
+/**
+ * Scan a copy of source[0..size), for a chunk of a buffer shared with
+ * other scanners. The copy is aligned and padded with zeros, so vector
+ * loads stay in it and the terminators of lexemes go to it.
+ * */
+void SCStartCopy(SCScanner *s, const char *source, size_t size, int lineno, int column) {
+  char *block = (char *)malloc(size + 2 + 4 * SC_WIDTH);
+  Assert(block != NULL, "out of memory for chunk");
+  char *buffer = (char *)(((uintptr_t)block + SC_WIDTH - 1) & ~(uintptr_t)(SC_WIDTH - 1));
+  memcpy(buffer, source, size);
+  memset(buffer + size, 0, 2 + 2 * SC_WIDTH);
+  SCStart(s, buffer, size, lineno, column);
+  s->block = block;
+}
+
+// Free the copy of the source, if any.
+void SCFinish(SCScanner *s) {
+  free(s->block);
+  s->block = NULL;
+}
+
+// Report a lexical error, as throwErrorA in lexical.l does.
+static void SCError(SCScanner *s, const char *message, bool showText) {
+  s->failed = true;
+  if (s->quiet) return;
+  CCContext *ctx = s->ctx;
+  ctx->hasErrorA = true;
+  if (ctx->errLineno == s->lineno) return; // one error per line
+  else ctx->errLineno = s->lineno;
+  fprintf(ctx->err, "Error type A at Line %d: %s", s->lineno, message);
+  if (showText) {
+    fprintf(ctx->err, " \'%s\'", s->text);
+  }
+  fprintf(ctx->err, ".\n");
+}
+
+// Put back the character overwritten by the terminator of s->text.
+static inline void SCRelease(SCScanner *s) {
+  if (s->hold != NULL) {
+    *s->hold = s->holdChar;
+    s->hold = NULL;
+  }
+}
+
+// Point s->text at [p, p + length), terminating it in place.
+static inline void SCText(SCScanner *s, char *p, int length) {
+  SCRelease(s);
+  s->text = p;
+  s->leng = length;
+  s->hold = p + length;
+  s->holdChar = *s->hold;
+  *s->hold = '\0';
+}
+
+// Match [p, p + length) as the next lexeme, doing what YY_USER_ACTION does.
+static void SCMatch(SCScanner *s, char *p, int length) {
+  SCText(s, p, length);
+  s->lloc->first_line   = s->lloc->last_line = s->lineno;
+  s->lloc->first_column = s->column;
+  s->lloc->last_column  = s->column + length - 1;
+  s->lloc->st_node      = 0;
+  s->column += length;
+  s->cursor = p + length;
+}
+
+// Create the leaf node of a token, as TOKENIFY in lexical.l does.
+static int SCTokenify(SCScanner *s, int token) {
+  STIndex index = STNewNode(s->pool);
+  STNode *node  = STNodeAt(index);
+  node->line    = s->lineno;
+  node->column  = s->column;
+  node->token   = token;
+  node->kind    = ST_TOKEN;
+  node->empty   = true;
+  node->child   = 0;
+  node->next    = 0;
+  switch (token) {
+    case INT:
+      node->ival = s->lval->ival;
+      break;
+    case FLOAT:
+      node->fval = s->lval->fval;
+      break;
+    case RELOP:
+      node->rval = s->lval->rval;
+      break;
+    case ID:
+    case TYPE:
+      node->atom = s->lval->atom;
+      break;
+    default:
+      node->ival = 0; // no value
+      break;
+  }
+  s->lloc->st_node = index;
+  return s->lval->type = token;
+}
+
+/**
+ * Skip a run of blanks. Flex matches them one byte at a time, so lines
+ * and columns are advanced as if it did, and yylloc is left at the last
+ * blank of the run.
+ * */
+static char *SCSkipBlank(SCScanner *s, char *p) {
+  if (!SC_BLANK(*p)) return p;
+  char *end = p + 1, *newline = *p == '\n' ? p : NULL;
+  int lines = newline != NULL;
+  for (char *short_end = p + SC_SHORT; end < short_end && SC_BLANK(*end); ++end) {
+    if (*end == '\n') {
+      ++lines;
+      newline = end;
+    }
+  }
+  if (SC_BLANK(*end)) {
+    char *chunk = SCAlign(end);
+    uint32_t lead = SCLead(end - chunk);
+    while (true) {
+      SCVector v = SCLoad(chunk);
+      uint32_t stop = ~SCMask(SCBlank(v)) & lead;
+      uint32_t nl = SCMask(SCEq(v, '\n')) & lead;
+      if (stop != 0) nl &= (1u << __builtin_ctz(stop)) - 1;
+      if (nl != 0) {
+        lines += __builtin_popcount(nl);
+        newline = chunk + (31 - __builtin_clz(nl));
+      }
+      if (stop != 0) {
+        end = chunk + __builtin_ctz(stop);
+        break;
+      }
+      chunk += SC_WIDTH;
+      lead = SC_FULL;
+    }
+  }
+  char *last = end - 1;
+  int column; // of the last blank
+  if (newline == NULL) {
+    column = s->column + (int)(last - p);
+    s->column += (int)(end - p);
+  } else {
+    if (newline != last) {
+      column = (int)(last - newline);
+    } else {
+      char *previous = last - 1;
+      while (previous >= p && *previous != '\n') --previous;
+      column = previous >= p ? (int)(last - previous) : s->column + (int)(last - p);
+    }
+    s->lineno += lines;
+    s->column = (int)(end - newline);
+  }
+  s->lloc->first_line   = s->lloc->last_line = s->lineno;
+  s->lloc->first_column = s->lloc->last_column = column;
+  s->lloc->st_node      = 0;
+  return end;
+}
+
+/**
+ * Skip the body of a block comment after "/\*", following the {commentb}
+ * action: every byte read is a column, and a '\0' before the closing
+ * "*\/" is an unterminated comment. Return the end or NULL on error.
+ * */
+static char *SCSkipComment(SCScanner *s, char *p) {
+  char *start = p, *newline = NULL;
+  int extra = 0; // bytes read past the end
+  while (true) {
+    p = SCFindCommentStop(p);
+    if (*p == '\n') {
+      ++s->lineno;
+      newline = p++;
+    } else if (*p == '*') {
+      while (*++p == '*') continue;
+      if (*p == '/') {
+        ++p;
+        break;
+      } else if (p == s->end) {
+        extra = 2;
+        break;
+      }
+      if (*p == '\n') {
+        ++s->lineno;
+        newline = p;
+      }
+      ++p;
+    } else {
+      extra = 1;
+      break;
+    }
+  }
+  s->column = (newline ? 1 + (int)(p - newline - 1) : s->column + (int)(p - start)) + extra;
+  return extra ? NULL : p;
+}
+
+// Skip an exponent [eE][+-]?[0-9]+ at p, return NULL if there is none.
+static char *SCExponent(char *p) {
+  if (*p != 'e' && *p != 'E') return NULL;
+  ++p;
+  if (*p == '+' || *p == '-') ++p;
+  if (!SC_DIGIT(*p)) return NULL;
+  while (SC_DIGIT(*p)) ++p;
+  return p;
+}
+
+/**
+ * Match a number at p by the longest of {int}, {float} and {invalidnum},
+ * the earlier rule winning a tie. Return INT, FLOAT or 0 if invalid.
+ * */
+static int SCNumber(char *p, int *length) {
+  char *q = p;
+  if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && SC_HEX(p[2])) {
+    for (q = p + 2; SC_HEX(*q); ++q) continue;
+  } else if (p[0] == '0') {
+    for (q = p + 1; SC_OCTAL(*q); ++q) continue;
+  } else {
+    while (SC_DIGIT(*q)) ++q;
+  }
+  int token = INT;
+  *length = (int)(q - p);
+  char *digits = p;
+  while (SC_DIGIT(*digits)) ++digits;
+  if (*digits == '.') {
+    char *fraction = digits + 1;
+    while (SC_DIGIT(*fraction)) ++fraction;
+    char *exponent = SCExponent(fraction);
+    int floatLength = exponent ? (int)(exponent - p)
+                    : fraction > digits + 1 ? (int)(fraction - p) : 0;
+    if (floatLength > *length) {
+      token = FLOAT;
+      *length = floatLength;
+    }
+  }
+  int wordLength = (int)(SCSkipWord(p) - p);
+  if (wordLength > *length) {
+    token = 0;
+    *length = wordLength;
+  }
+  return token;
+}
+
+// Keyword or type spelled by [p, p + length), 0 for an identifier.
+static int SCKeyword(const char *p, int length) {
+  switch (length) {
+    case 2:
+      return memcmp(p, "if", 2) ? 0 : IF;
+    case 3:
+      return memcmp(p, "int", 3) ? 0 : TYPE;
+    case 4:
+      return memcmp(p, "else", 4) ? 0 : ELSE;
+    case 5:
+      return !memcmp(p, "float", 5) ? TYPE : !memcmp(p, "while", 5) ? WHILE : 0;
+    case 6:
+      return !memcmp(p, "struct", 6) ? STRUCT : !memcmp(p, "return", 6) ? RETURN : 0;
+    default:
+      return 0;
+  }
+}
+
+// Match a token of fixed length.
+static inline int SCFixed(SCScanner *s, char *p, int length, int token) {
+  SCMatch(s, p, length);
+  return SCTokenify(s, token);
+}
+
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, SCScanner *s) {
+  s->lval = lval;
+  s->lloc = lloc;
+  if (s->failed && s->quiet) return 0; // give up at once
+  while (true) {
+    SCRelease(s);
+    char *p = SCSkipBlank(s, s->cursor);
+    s->cursor = p;
+    int length, token;
+    switch (*p) {
+      case '\0':
+        if (p == s->end) {
+          s->text = p; // ""
+          s->leng = 0;
+          return 0;
+        }
+        break; // unknown character
+      case '/':
+        if (p[1] == '/') {
+          char *end = p + 2;
+          while (*(end = SCFindLineEnd(end)) == '\0' && end != s->end) ++end;
+          SCMatch(s, p, (int)(end - p));
+          continue;
+        } else if (p[1] == '*') {
+          SCMatch(s, p, 2);
+          SCRelease(s);
+          char *end = SCSkipComment(s, p + 2);
+          if (end == NULL) {
+            SCText(s, p, 2);
+            SCError(s, "unterminated comment", false);
+            s->cursor = s->end;
+            return 0;
+          }
+          s->cursor = end;
+          continue;
+        }
+        return SCFixed(s, p, 1, DIV);
+      case ';': return SCFixed(s, p, 1, SEMI);
+      case ',': return SCFixed(s, p, 1, COMMA);
+      case '+': return SCFixed(s, p, 1, PLUS);
+      case '-': return SCFixed(s, p, 1, MINUS);
+      case '*': return SCFixed(s, p, 1, STAR);
+      case '(': return SCFixed(s, p, 1, LP);
+      case ')': return SCFixed(s, p, 1, RP);
+      case '[': return SCFixed(s, p, 1, LB);
+      case ']': return SCFixed(s, p, 1, RB);
+      case '{': return SCFixed(s, p, 1, LC);
+      case '}': return SCFixed(s, p, 1, RC);
+      case '&':
+        if (p[1] == '&') return SCFixed(s, p, 2, AND);
+        break;
+      case '|':
+        if (p[1] == '|') return SCFixed(s, p, 2, OR);
+        break;
+      case '=':
+        if (p[1] != '=') return SCFixed(s, p, 1, ASSIGNOP);
+        /* fall through */
+      case '<':
+      case '>':
+        SCMatch(s, p, p[1] == '=' ? 2 : 1);
+        SCValue(s, r);
+        return SCTokenify(s, RELOP);
+      case '!':
+        if (p[1] != '=') return SCFixed(s, p, 1, NOT);
+        SCMatch(s, p, 2);
+        SCValue(s, r);
+        return SCTokenify(s, RELOP);
+      case '.':
+        if (SC_DIGIT(p[1])) {
+          char *fraction = p + 1;
+          while (SC_DIGIT(*fraction)) ++fraction;
+          char *exponent = SCExponent(fraction);
+          if (exponent != NULL) {
+            SCMatch(s, p, (int)(exponent - p));
+            SCValue(s, f);
+            return SCTokenify(s, FLOAT);
+          }
+        }
+        return SCFixed(s, p, 1, DOT);
+      default:
+        if (SC_DIGIT(*p)) {
+          token = SCNumber(p, &length);
+          SCMatch(s, p, length);
+          if (token == INT) {
+            SCValue(s, i);
+          } else if (token == FLOAT) {
+            SCValue(s, f);
+          } else {
+            SCError(s, "invalid ID or number", true);
+            token = ID;
+          }
+          return SCTokenify(s, token);
+        } else if (SC_LETTER(*p)) {
+          length = (int)(SCSkipWord(p + 1) - p);
+          token = SCKeyword(p, length);
+          SCMatch(s, p, length);
+          if (token == 0 || token == TYPE) {
+            s->lval->atom = INAtom(s->text, (size_t)s->leng);
+            if (token == 0) token = ID;
+          }
+          return SCTokenify(s, token);
+        }
+        break;
+    }
+    SCMatch(s, p, 1);
+    SCError(s, "unknown character", true);
+  }
+}
+
+/**
+ * A top-level '}' ends an ExtDef when a type or "struct" comes next: after
+ * the body of a structure only ';' or a declarator may follow. Comments
+ * are skipped, and braces are not counted inside them. The line and the
+ * column of a chunk are where the scanner would be at its first byte.
+ * */
+size_t SCSplit(const char *buffer, size_t size, size_t target, SCChunk **chunks) {
+  size_t count = 0, capacity = 0;
+  *chunks = NULL;
+  const char *p = buffer, *end = buffer + size, *begin = buffer;
+  const char *line = buffer - 1; // the last '\n'
+  int lineno = 1, depth = 0;
+  while (p < end) {
+    char c = *p++;
+    if (c == '\n') {
+      ++lineno;
+      line = p - 1;
+    } else if (c == '/' && p < end && *p == '/') {
+      while (p < end && *p != '\n') ++p;
+    } else if (c == '/' && p < end && *p == '*') {
+      const char *q = p + 1;
+      while (q + 1 < end && !(q[0] == '*' && q[1] == '/')) {
+        if (*q == '\n') {
+          ++lineno;
+          line = q;
+        }
+        ++q;
+      }
+      if (q + 1 >= end) break; // unterminated, leave the rest to the parser
+      p = q + 2;
+    } else if (c == '{') {
+      ++depth;
+    } else if (c == '}' && --depth <= 0) {
+      if (depth < 0) break; // unbalanced, leave the rest to the parser
+      if ((size_t)(p - begin) < target) continue;
+      const char *q = p;
+      while (q < end) { // skip blanks and comments without counting lines
+        if (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\n') {
+          ++q;
+        } else if (q + 1 < end && q[0] == '/' && q[1] == '/') {
+          while (q < end && *q != '\n') ++q;
+        } else if (q + 1 < end && q[0] == '/' && q[1] == '*') {
+          const char *close = q + 2;
+          while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) ++close;
+          q = close + 1 < end ? close + 2 : end;
+        } else {
+          break;
+        }
+      }
+      size_t length = 0;
+      while (q + length < end && (SC_LETTER(q[length]) || SC_DIGIT(q[length]))) ++length;
+      if ((length == 3 && !memcmp(q, "int", 3)) || (length == 5 && !memcmp(q, "float", 5)) ||
+          (length == 6 && !memcmp(q, "struct", 6))) {
+        if (count + 1 >= capacity) {
+          capacity = capacity ? capacity * 2 : 64;
+          *chunks = (SCChunk *)realloc(*chunks, sizeof(SCChunk) * capacity);
+          Assert(*chunks != NULL, "out of memory for chunks");
+        }
+        if (count == 0) {
+          (*chunks)[count++] = (SCChunk){0, 1, 1};
+        }
+        (*chunks)[count++] = (SCChunk){(size_t)(p - buffer), lineno, (int)(p - line)};
+        begin = p;
+      }
+    }
+  }
+  return count;
+}
+
+#else
+
+/**
+ * The flex scanner keeps its state in globals (see lexical.l), so it can
+ * only be used by one parser at a time. Its state is copied to the
+ * scanner after each token for the parser to see, and the scanner is
+ * left in SCFlex for the actions of lexical.l to find the pool and ctx.
+ * */
+struct yy_buffer_state;
+extern struct yy_buffer_state *yy_scan_buffer(char *, size_t);
+extern int yylexFlex(void);
+extern char *yytext;
+extern int yyleng;
+extern int yylineno;
+extern int yycolumn;
+extern SCScanner *SCFlex;
+
+void SCStart(SCScanner *s, char *buffer, size_t size, int lineno, int column) {
+  yy_scan_buffer(buffer, size + 2);
+  yylineno = s->lineno = lineno;
+  yycolumn = s->column = column;
+  s->text = buffer;
+  s->leng = 0;
+  s->streamed = 0;
+  s->failed = false;
+  s->root = 0;
+  s->block = NULL;
+}
+
+// Scan a copy of source[0..size), followed by the two '\0' flex needs.
+void SCStartCopy(SCScanner *s, const char *source, size_t size, int lineno, int column) {
+  char *block = (char *)malloc(size + 2);
+  Assert(block != NULL, "out of memory for source");
+  memcpy(block, source, size);
+  block[size] = block[size + 1] = '\0';
+  SCStart(s, block, size, lineno, column);
+  s->block = block;
+}
+
+void SCFinish(SCScanner *s) {
+  free(s->block);
+  s->block = NULL;
+}
+
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, SCScanner *s) {
+  SCFlex = s;
+  int token = yylexFlex();
+  *lval = yylval;
+  *lloc = yylloc;
+  s->text = yytext;
+  s->leng = yyleng;
+  s->lineno = yylineno;
+  s->column = yycolumn;
+  return token;
+}
+
+#endif // SCHAND
@@ -0,0 +1,58 @@
+/**
+ * The hand-written scanner.
+ * A drop-in replacement of the flex scanner in lexical.l: it produces the
+ * same tokens, node payloads, locations and lexical errors. Whitespace,
+ * comments, identifiers and numbers are spanned with SSE2 character-class
+ * masks (AVX2 when built with -mavx2) instead of one DFA step per byte.
+ * All of its state is in an SCScanner, so parsers on several threads can
+ * scan at once, each into its own pool of nodes.
+ * */
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "token.h"
+#include "tree.h"
+
+#define SCHAND true // <- hand-written scanner switch (false: flex)
+#define SCSPLIT true // <- parallel parsing of top-level chunks switch (needs SCHAND and STARENA)
+#define SC_SPLIT_SIZE (1 << 15) // bytes of a chunk at least
+
+struct CCContext;
+
+typedef struct SCScanner {
+  char *cursor, *end;
+  char *hold;       // where text is terminated
+  char holdChar;
+  char *text;       // of the last token
+  int leng;
+  int lineno, column;
+  YYSTYPE *lval;    // of the token being scanned
+  YYLTYPE *lloc;
+  struct CCContext *ctx;
+  STPool *pool;     // of the nodes of the parse
+  bool quiet;       // do not report errors, only remember them
+  bool stream;      // hand ExtDefs to the hook of ctx as they are parsed
+  size_t streamed;  // nodes of the pool up to here are handed over or in use
+  bool failed;      // an error was seen
+  STIndex root;     // the Program, once parsed
+  char *block;      // the copy of the source, if any
+} SCScanner;
+
+// A chunk of the source made of whole ExtDefs.
+typedef struct SCChunk {
+  size_t begin;
+  int lineno, column;
+} SCChunk;
+
+// Scan buffer[0..size) from the given position, buffer[size] must be
+// '\0' and the buffer writable. Set ctx, pool, quiet and stream beforehand.
+void SCStart(SCScanner *scanner, char *buffer, size_t size, int lineno, int column);
+void SCStartCopy(SCScanner *scanner, const char *source, size_t size, int lineno, int column);
+void SCFinish(SCScanner *scanner);
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, SCScanner *scanner);
+size_t SCSplit(const char *buffer, size_t size, size_t target, SCChunk **chunks);
+
+#endif // SCANNER_H
@@ -1,12 +1,11 @@
+#include <stdarg.h>
 #include "type.h"
 #include "table.h"
 #include "semantics.h"
+#include "compiler.h"
 #include "syntax.tab.h"
 #include "debug.h"
 
-extern bool hasErrorS;
-extern STNode *stroot;
-
 const STError SETable[] = {
   {  0, "Pseudo error", "" },
   {  1, "Use of undefined variable ", "" },
@@ -31,39 +30,101 @@ const STError SETable[] = {
 };
 
 // Main entry of semantic scan
-void semanticScan() {
+void semanticScan(CCContext *ctx) {
+  semanticPrepare(ctx);
+  //checkSemantics(ctx, ctx->root, ctx->root);
+  SEParseExtDefList(ctx, STChild(ctx->root));
+  semanticFinish(ctx);
+}
+
+// Prepare the scan of ExtDefs one by one.
+void semanticPrepare(CCContext *ctx) {
   CLog(FG_YELLOW, "Before prepare");
-  STPrepare();
+  STPrepare(ctx);
   CLog(FG_YELLOW, "After prepare");
-  //checkSemantics(stroot, stroot);
-  SEParseExtDefList(stroot->child);
+}
+
+// Scan (and translate) a single ExtDef.
+void semanticExtDef(CCContext *ctx, STNode *edef) {
+  SEParseExtDef(ctx, edef);
+}
+
+// Finish the scan, the symbol table is destroyed.
+void semanticFinish(CCContext *ctx) {
   CLog(FG_YELLOW, "Before destroy");
-  STDestroy();
+  STDestroy(ctx);
   CLog(FG_YELLOW, "After destroy");
 }
 
+// Hold back the semantic errors from now on, until released.
+void holdErrorsS(CCContext *ctx) {
+  ctx->holdErrors = true;
+}
+
+// Stop holding back errors, print the held ones or drop them.
+void releaseErrorsS(CCContext *ctx, bool print) {
+  if (print && ctx->heldLength > 0) {
+    fwrite(ctx->held, 1, ctx->heldLength, ctx->err);
+  }
+  free(ctx->held);
+  ctx->held = NULL;
+  ctx->heldLength = ctx->heldCapacity = 0;
+  ctx->holdErrors = false;
+}
+
 // Parse and check semantics of the current node.
-void checkSemantics(STNode *node, STNode *parent) {
+void checkSemantics(CCContext *ctx, STNode *node, STNode *parent) {
   if (node->empty) return;
-  if (!strcmp(node->name, "DefList")) {
-    SEParseDefList(node, true);
-  } else if (!strcmp(node->name, "Exp")) {
-    SEType *type = SEParseExp(node);
-  } else {
-    for (STNode *child = node->child; child != NULL; child = child->next) {
-      checkSemantics(child, node);
-    }
+  switch (node->kind) {
+    case ST_DefList:
+      SEParseDefList(ctx, node, true, NULL);
+      break;
+    case ST_Exp:
+      SEParseExp(ctx, node, IRNewNullOperand(), true);
+      break;
+    default:
+      for (STNode *child = STChild(node); child != NULL; child = STNext(child)) {
+        checkSemantics(ctx, child, node);
+      }
+      break;
   }
 }
 
-// Throw an semantic error.
-void throwErrorS(enum SemanticErrors id, int line, const char *name) {
-  hasErrorS = true;
-  fprintf(stderr, "Error type %d at Line %d: ", id, line);
-  if (name != NULL) {
-    fprintf(stderr, "%s\"%s\"%s", SETable[id].message1, name, SETable[id].message2);
-  } else {
-    fprintf(stderr, "%s", SETable[id].message1);
+// Print an error of the semantic pass, or hold it back.
+static void reportErrorS(CCContext *ctx, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  if (!ctx->holdErrors) {
+    vfprintf(ctx->err, format, args);
+    va_end(args);
+    return;
   }
-  fprintf(stderr, ".\n");
+  va_list copy;
+  va_copy(copy, args);
+  int length = vsnprintf(NULL, 0, format, copy);
+  va_end(copy);
+  while (ctx->heldLength + length + 1 > ctx->heldCapacity) {
+    ctx->heldCapacity = ctx->heldCapacity ? ctx->heldCapacity * 2 : 1024;
+    ctx->held = (char *)realloc(ctx->held, ctx->heldCapacity);
+    Assert(ctx->held != NULL, "out of memory for held errors");
+  }
+  vsnprintf(ctx->held + ctx->heldLength, length + 1, format, args);
+  ctx->heldLength += length;
+  va_end(args);
+}
+
+// Throw an semantic error.
+void throwErrorS(CCContext *ctx, enum SemanticErrors id, int line, const char *name) {
+  ctx->hasErrorS = true;
+  const char *format = name != NULL ? "Error type %d at Line %d: %s\"%s\"%s.\n"
+                                    : "Error type %d at Line %d: %s.\n";
+  const char *message2 = SETable[id].message2 != NULL ? SETable[id].message2 : "";
+  reportErrorS(ctx, format, id, line, SETable[id].message1, name, message2);
+}
+
+// Report code the back end cannot translate: FLOAT has no IR. No more IR
+// is made, like after a semantic error.
+void throwErrorT(CCContext *ctx, int line) {
+  ctx->hasErrorS = ctx->hasErrorT = true;
+  reportErrorS(ctx, "Cannot translate: Code contains a float constant at Line %d.\n", line);
 }
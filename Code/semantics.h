@@ -45,8 +45,16 @@ typedef struct STError {
   const char *message2;
 } STError;
 
-void semanticScan();
-void checkSemantics(STNode *node, STNode *parent);
-void throwErrorS(enum SemanticErrors id, int line, const char *name);
+struct CCContext;
+
+void semanticScan(struct CCContext *ctx);
+void semanticPrepare(struct CCContext *ctx);
+void semanticExtDef(struct CCContext *ctx, STNode *edef);
+void semanticFinish(struct CCContext *ctx);
+void holdErrorsS(struct CCContext *ctx);
+void releaseErrorsS(struct CCContext *ctx, bool print);
+void checkSemantics(struct CCContext *ctx, STNode *node, STNode *parent);
+void throwErrorS(struct CCContext *ctx, enum SemanticErrors id, int line, const char *name);
+void throwErrorT(struct CCContext *ctx, int line);
 
 #endif // SEMANTIC_H
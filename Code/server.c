@@ -0,0 +1,301 @@
+#define _POSIX_C_SOURCE 200809L // pthreads, sockets, sigwait
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "compiler.h"
+#include "debug.h"
+#include "server.h"
+#include "source.h"
+
+// Read exactly size bytes. Return false on end of file or error.
+static bool SVReadAll(int fd, void *data, size_t size) {
+  char *p = (char *)data;
+  while (size > 0) {
+    ssize_t count = read(fd, p, size);
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    p += count;
+    size -= count;
+  }
+  return true;
+}
+
+// Write exactly size bytes. Return false on error.
+static bool SVWriteAll(int fd, const void *data, size_t size) {
+  const char *p = (const char *)data;
+  while (size > 0) {
+    ssize_t count = write(fd, p, size);
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0) return false;
+    p += count;
+    size -= count;
+  }
+  return true;
+}
+
+// Fill in the address of the socket at path.
+static bool SVAddress(const char *path, struct sockaddr_un *address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address->sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  strcpy(address->sun_path, path);
+  return true;
+}
+
+// Answer the requests of one client until it hangs up.
+static void SVServeClient(CCContext *ctx, int fd) {
+  char *source = NULL;
+  size_t capacity = 0;
+  SVRequestHeader request;
+  while (SVReadAll(fd, &request, sizeof(request))) {
+    if (request.magic != SV_MAGIC || request.sourceSize > SV_MAX_SOURCE) {
+      Log("bad request from client %d", fd);
+      break;
+    }
+    size_t size = (size_t)request.sourceSize;
+    if (size + 2 > capacity) {
+      capacity = size + 2;
+      free(source);
+      source = (char *)malloc(capacity);
+      Assert(source != NULL, "out of memory for request");
+    }
+    if (!SVReadAll(fd, source, size)) break;
+    source[size] = source[size + 1] = '\0';
+    SVResponseHeader response;
+    response.magic = SV_MAGIC;
+    response.status = CCCompileBuffer(ctx, source, size, NULL);
+    response.outputSize = request.options & SV_CHECK_ONLY ? 0 : ctx->outputSize;
+    response.errorsSize = ctx->errorsSize;
+    if (!SVWriteAll(fd, &response, sizeof(response)) ||
+        !SVWriteAll(fd, ctx->output, response.outputSize) ||
+        !SVWriteAll(fd, ctx->errors, response.errorsSize)) {
+      break;
+    }
+  }
+  free(source);
+}
+
+typedef struct SVServer {
+  int listener;
+  const char *cache; // directory of the code cache, NULL: none
+  pthread_mutex_t lock; // guards stopping and the clients of the threads
+  bool stopping;
+  struct SVThread *threads;
+} SVServer;
+
+typedef struct SVThread {
+  pthread_t thread;
+  SVServer *server;
+  int client; // -1 if none
+} SVThread;
+
+// Take clients one at a time, with a context that stays warm.
+static void *SVLoop(void *arg) {
+  SVThread *self = (SVThread *)arg;
+  SVServer *server = self->server;
+  CCContext *ctx = CCNew(0); // the other server threads keep the processors busy
+  ctx->cache = server->cache;
+  for (;;) {
+    int fd = accept(server->listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break; // the listener is shut down
+    }
+    pthread_mutex_lock(&server->lock);
+    bool stopping = server->stopping;
+    if (!stopping) self->client = fd;
+    pthread_mutex_unlock(&server->lock);
+    if (stopping) {
+      close(fd);
+      break;
+    }
+    SVServeClient(ctx, fd);
+    pthread_mutex_lock(&server->lock);
+    self->client = -1;
+    pthread_mutex_unlock(&server->lock);
+    close(fd);
+  }
+  CCFree(ctx);
+  return NULL;
+}
+
+// Listen on the socket at path, taking over a stale one.
+static int SVListen(const char *path) {
+  struct sockaddr_un address;
+  if (!SVAddress(path, &address)) return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    int probe = errno != EADDRINUSE ? -1 : socket(AF_UNIX, SOCK_STREAM, 0);
+    bool stale = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) < 0 &&
+                 errno == ECONNREFUSED;
+    if (probe >= 0) close(probe);
+    if (!stale || unlink(path) < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+      errno = stale ? errno : EADDRINUSE;
+      close(fd);
+      return -1;
+    }
+  }
+  if (listen(fd, 64) < 0) {
+    close(fd);
+    unlink(path);
+    return -1;
+  }
+  return fd;
+}
+
+// Serve clients on listener with workers threads until SIGINT or SIGTERM,
+// which are blocked already.
+static int SVRun(int listener, const char *path, int workers, const char *cache,
+                 const sigset_t *stop) {
+  SVServer server;
+  server.listener = listener;
+  server.cache = cache;
+  server.stopping = false;
+  server.threads = (SVThread *)calloc(workers, sizeof(SVThread));
+  Assert(server.threads != NULL, "out of memory for server");
+  pthread_mutex_init(&server.lock, NULL);
+  int started = 0;
+  for (; started < workers; ++started) {
+    server.threads[started].server = &server;
+    server.threads[started].client = -1;
+    if (pthread_create(&server.threads[started].thread, NULL, SVLoop, &server.threads[started]) != 0) break;
+  }
+  int status = 0;
+  if (started == 0) {
+    perror("pthread_create");
+    status = 2;
+  } else {
+    Log("serving on %s with %d threads", path, started);
+    int signo;
+    while (sigwait(stop, &signo) != 0) {}
+    // Stop taking clients, and cut off the connected ones: a request in
+    // progress is finished, but its answer is lost.
+    unlink(path);
+    pthread_mutex_lock(&server.lock);
+    server.stopping = true;
+    shutdown(listener, SHUT_RDWR);
+    for (int i = 0; i < started; ++i) {
+      if (server.threads[i].client >= 0) shutdown(server.threads[i].client, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&server.lock);
+    for (int i = 0; i < started; ++i) {
+      pthread_join(server.threads[i].thread, NULL);
+    }
+  }
+  pthread_mutex_destroy(&server.lock);
+  free(server.threads);
+  return status;
+}
+
+// Serve compile requests on the socket at path with workers threads
+// (0: one for each processor) and a code cache unless it is NULL,
+// until SIGINT or SIGTERM.
+// The threads serve in a child process. A request which brings the
+// compiler down ends the child and the connections of its clients, not
+// the server: the socket stays open here and a new child takes over.
+int SVServe(const char *path, int workers, const char *cache) {
+  // The signals are taken by sigwait below, the threads inherit the mask.
+  sigset_t stop, watch;
+  sigemptyset(&stop);
+  sigaddset(&stop, SIGINT);
+  sigaddset(&stop, SIGTERM);
+  watch = stop;
+  sigaddset(&watch, SIGCHLD);
+  pthread_sigmask(SIG_BLOCK, &watch, NULL);
+  signal(SIGPIPE, SIG_IGN); // a client which hangs up only ends its connection
+
+  int listener = SVListen(path);
+  if (listener < 0) {
+    perror(path);
+    return 2;
+  }
+  if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers <= 0) workers = 1;
+  int status = 0;
+  for (;;) {
+    pid_t child = fork();
+    if (child < 0) {
+      perror("fork");
+      status = 2;
+      break;
+    }
+    if (child == 0) {
+      _exit(SVRun(listener, path, workers, cache, &stop));
+    }
+    int signo, wstatus;
+    while (sigwait(&watch, &signo) != 0 ||
+           (signo == SIGCHLD && waitpid(child, &wstatus, WNOHANG) <= 0)) {}
+    if (signo != SIGCHLD) {
+      kill(child, SIGTERM);
+      while (waitpid(child, &wstatus, 0) < 0 && errno == EINTR) {}
+    } else if (WIFSIGNALED(wstatus)) {
+      fprintf(stderr, "%s: a request brought the server down (signal %d), restarting\n", path,
+              WTERMSIG(wstatus));
+      continue;
+    }
+    status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 2;
+    unlink(path);
+    break;
+  }
+  close(listener);
+  if (status != 0) unlink(path);
+  return status;
+}
+
+// Compile a source on the server at path, writing the output file and
+// the diagnostics like the parser does. Return the status of the parser.
+int SVRequest(const char *path, const char *source, const char *output) {
+  SRSource input = {NULL, 0, 0};
+  if (!(SRMMAP && SRMap(source, &input)) && !SRRead(source, &input)) {
+    perror(source);
+    return 2;
+  }
+  FILE *fout = fopen(output, "w+");
+  if (fout == NULL) {
+    perror(output);
+    SRRelease(&input);
+    return 2;
+  }
+  struct sockaddr_un address;
+  int fd = -1;
+  if (!SVAddress(path, &address) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    perror(path);
+    if (fd >= 0) close(fd);
+    fclose(fout);
+    SRRelease(&input);
+    return 2;
+  }
+
+  SVRequestHeader request = { SV_MAGIC, 0, input.size };
+  SVResponseHeader response;
+  int status = 2;
+  char *text = NULL;
+  if (SVWriteAll(fd, &request, sizeof(request)) && SVWriteAll(fd, input.base, input.size) &&
+      SVReadAll(fd, &response, sizeof(response)) && response.magic == SV_MAGIC &&
+      (text = (char *)malloc(response.outputSize + response.errorsSize + 1)) != NULL &&
+      SVReadAll(fd, text, response.outputSize + response.errorsSize)) {
+    fwrite(text + response.outputSize, 1, response.errorsSize, stderr);
+    fwrite(text, 1, response.outputSize, fout);
+    status = (int)response.status;
+  } else {
+    fprintf(stderr, "%s: no answer from the server\n", path);
+  }
+  free(text);
+  close(fd);
+  fclose(fout);
+  SRRelease(&input);
+  return status;
+}
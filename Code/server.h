@@ -0,0 +1,44 @@
+/**
+ * The compile server: a long-lived parser on a Unix domain socket.
+ * A client connects, then sends any number of requests, one at a time:
+ * a SVRequestHeader and the source bytes. Each request is answered with
+ * a SVResponseHeader, the assembly and the diagnostics, exactly what the
+ * parser would write to the output file and to stderr.
+ * Every server thread keeps a compiler context of its own, which stays
+ * warm between requests: its arenas, the intern table and the spare node
+ * chunks are reused instead of being built up again for each source.
+ * The threads run in a child process, which the server starts again if
+ * a request brings it down; only the clients connected then are cut off.
+ * The headers are in the byte order of the machine, the socket is local.
+ * */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+#define SV_MAGIC 0x434d4d31u // "CMM1"
+#define SV_MAX_SOURCE (1u << 30) // larger requests are refused
+
+// Options of a request.
+enum SVOption {
+  SV_CHECK_ONLY = 1, // diagnostics only, no assembly is sent back
+};
+
+typedef struct SVRequestHeader {
+  uint32_t magic;
+  uint32_t options;    // SVOption bits
+  uint64_t sourceSize; // followed by the source
+} SVRequestHeader;
+
+typedef struct SVResponseHeader {
+  uint32_t magic;
+  uint32_t status;     // exit status of the parser
+  uint64_t outputSize; // followed by the assembly
+  uint64_t errorsSize; // then by the diagnostics
+} SVResponseHeader;
+
+int SVServe(const char *path, int workers, const char *cache);
+int SVRequest(const char *path, const char *source, const char *output);
+
+#endif // SERVER_H
@@ -0,0 +1,81 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+#include "debug.h"
+
+/**
+ * An anonymous mapping of size+2 bytes (rounded up to pages) is reserved
+ * first, then the file is mapped over its beginning. Bytes past the end
+ * of file are zero in both mappings, which gives the NUL padding for free.
+ * The mapping is private and writable: flex temporarily writes a NUL
+ * after each token, which only copies the touched pages.
+ * */
+bool SRMap(const char *path, SRSource *source) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t size = (size_t)st.st_size;
+  size_t length = (size + 2 + page - 1) / page * page;
+  char *base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  if (size > 0 &&
+      mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(base, length);
+    close(fd);
+    return false;
+  }
+  close(fd); // the mapping keeps the file alive
+  Log("mapped %s: %zu bytes at %p", path, size, base);
+  source->base = base;
+  source->size = size;
+  source->length = length;
+  return true;
+}
+
+// Read the whole source file into a malloc'd buffer.
+bool SRRead(const char *path, SRSource *source) {
+  FILE *fin = fopen(path, "r");
+  if (fin == NULL) return false;
+  size_t capacity = 4096, size = 0, count;
+  char *base = (char *)malloc(capacity);
+  Assert(base != NULL, "out of memory for source");
+  while ((count = fread(base + size, 1, capacity - size - 2, fin)) > 0) {
+    size += count;
+    if (capacity - size - 2 == 0) {
+      capacity *= 2;
+      base = (char *)realloc(base, capacity);
+      Assert(base != NULL, "out of memory for source");
+    }
+  }
+  fclose(fin);
+  base[size] = base[size + 1] = '\0';
+  source->base = base;
+  source->size = size;
+  source->length = 0;
+  return true;
+}
+
+// Release the source buffer.
+void SRRelease(SRSource *source) {
+  if (source->base == NULL) return;
+  if (source->length != 0) {
+    munmap(source->base, source->length);
+  } else {
+    free(source->base);
+  }
+  source->base = NULL;
+}
@@ -0,0 +1,28 @@
+/**
+ * The memory-mapped source input.
+ * The whole source file is mapped into memory and followed by the two
+ * NUL bytes that flex's yy_scan_buffer needs, so the lexer scans the
+ * mapped pages directly without read() or buffer copies.
+ * Inputs which cannot be mapped (pipes, or with the switch off) are read
+ * into a malloc'd buffer with the same padding.
+ * */
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SRMMAP true // <- mmap input switch (false: read into memory)
+
+typedef struct SRSource {
+  char *base;    // contents, base[size] == base[size + 1] == '\0'
+  size_t size;   // size of the file
+  size_t length; // length of the whole mapping, 0 if malloc'd
+} SRSource;
+
+bool SRMap(const char *path, SRSource *source);
+bool SRRead(const char *path, SRSource *source);
+void SRRelease(SRSource *source);
+
+#endif // SOURCE_H
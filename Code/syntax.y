@@ -5,68 +5,110 @@
 
 %locations
 %token-table
+%define api.pure full
+%code requires { struct SCScanner; }
+%param { struct SCScanner *scanner }
 
 %{
   #include <stdio.h>
   #include <stdbool.h>
   #include "token.h"
   #include "tree.h"
+  #include <pthread.h>
+  #include "scanner.h"
+  #include "worker.h"
+  #include "compiler.h"
+  #include "debug.h"
 
-  /* Macro function to create STNodes for nterms */
+  /**
+   * Macro function to create STNodes for nterms.
+   * Left-recursive lists are flattened into one node: the items of
+   * "List: List Item" are appended to the children of the list on the
+   * left (its tail is kept in the node) instead of nesting a new node.
+   * */
   #define YYLLOC_DEFAULT(Cur, Rhs, N)                                                     \
     do {                                                                                  \
       /* check that all children are healthy */                                           \
       bool healthy = true;                                                                \
       for (int child = 1; child <= N; ++child) {                                          \
-        if ((YYRHSLOC(Rhs, child).st_node) == NULL) {                                     \
+        if ((YYRHSLOC(Rhs, child).st_node) == 0) {                                        \
           healthy = false;                                                                \
           break;                                                                          \
         }                                                                                 \
       }                                                                                   \
-      if (N != 0 && healthy) {                                                            \
-        (Cur).first_line   = YYRHSLOC(Rhs, 1).first_line;                                 \
-        (Cur).first_column = YYRHSLOC(Rhs, 1).first_column;                               \
+      /* yyn is a rule when reducing, but a state when shifting the error token */        \
+      STKind kind = (Rhs) == &yyerror_range[0] ? ST_TOKEN                                 \
+                                                : stkinds[yyr1[yyn] - YYNTOKENS];         \
+      STIndex list = N != 0 ? YYRHSLOC(Rhs, 1).st_node : 0;                               \
+      if (N >= 2 && healthy && STIsList(kind) && STNodeAt(list)->kind == kind) {          \
+        /* left recursion: append the items to the list on the left */                    \
+        STNode *node = STNodeAt(list);                                                    \
+        int first = node->child == 0 ? 2 : 1; /* skip an empty list */                    \
+        (Cur).first_line   = YYRHSLOC(Rhs, first).first_line;                             \
+        (Cur).first_column = YYRHSLOC(Rhs, first).first_column;                           \
         (Cur).last_line    = YYRHSLOC(Rhs, N).last_line;                                  \
         (Cur).last_column  = YYRHSLOC(Rhs, N).last_column;                                \
+        for (int child = 2; child <= N - 1; ++child) {                                    \
+          STIndex next = YYRHSLOC(Rhs, child + 1).st_node;                                \
+          STNodeAt(YYRHSLOC(Rhs, child).st_node)->next = next;                            \
+        }                                                                                 \
+        if (node->child == 0) {                                                           \
+          node->line   = (Cur).first_line;                                                \
+          node->column = (Cur).first_column;                                              \
+          node->empty  = false;                                                           \
+          node->child  = YYRHSLOC(Rhs, 2).st_node;                                        \
+        } else {                                                                          \
+          STNodeAt(node->tail)->next = YYRHSLOC(Rhs, 2).st_node;                          \
+        }                                                                                 \
+        node->tail = YYRHSLOC(Rhs, N).st_node;                                            \
+        (Cur).st_node = list;                                                             \
       } else {                                                                            \
-        (Cur).first_line   = (Cur).last_line  = yylineno;                                 \
-        (Cur).first_column = (Cur).last_column = yycolumn;                                \
-      }                                                                                   \
-      STNode *node  = (STNode *)malloc(sizeof(STNode));                                   \
-      node->line    = (Cur).first_line;                                                   \
-      node->column  = (Cur).first_column;                                                 \
-      node->token   = -1; /* nterm is not a token */                                      \
-      node->symbol  = yyr1[yyn];                                                          \
-      node->name    = yytname[node->symbol];                                              \
-      node->empty   = N == 0;                                                             \
-      node->ir.head = NULL;   /* IR code */                                               \
-      node->ir.tail = NULL;                                                               \
-      if (N != 0 && healthy) {                                                            \
-        for (int child = 1; child <= N; ++child) {                                        \
-          if ((YYRHSLOC(Rhs, child).st_node)->symbol == -1) {                             \
-            /* translate from token to symbol */                                          \
-            int symbol = YYTRANSLATE((YYRHSLOC(Rhs, child).st_node)->token);              \
-            (YYRHSLOC(Rhs, child).st_node)->symbol = symbol;                              \
-            (YYRHSLOC(Rhs, child).st_node)->name   = yytname[symbol];                     \
-            (YYRHSLOC(Rhs, child).st_node)->child  = NULL;                                \
-            (YYRHSLOC(Rhs, child).st_node)->next   = NULL;                                \
+        if (N != 0 && healthy) {                                                          \
+          (Cur).first_line   = YYRHSLOC(Rhs, 1).first_line;                               \
+          (Cur).first_column = YYRHSLOC(Rhs, 1).first_column;                             \
+          (Cur).last_line    = YYRHSLOC(Rhs, N).last_line;                                \
+          (Cur).last_column  = YYRHSLOC(Rhs, N).last_column;                              \
+        } else {                                                                          \
+          (Cur).first_line   = (Cur).last_line  = scanner->lineno;                        \
+          (Cur).first_column = (Cur).last_column = scanner->column;                       \
+        }                                                                                 \
+        STIndex index = STNewNode(scanner->pool);                                         \
+        STNode *node  = STNodeAt(index);                                                  \
+        node->line    = (Cur).first_line;                                                 \
+        node->column  = (Cur).first_column;                                               \
+        node->token   = -1; /* nterm is not a token */                                    \
+        node->kind    = kind;                                                             \
+        node->empty   = N == 0;                                                           \
+        node->ival    = 0;  /* no payload */                                              \
+        if (N != 0 && healthy) {                                                          \
+          for (int child = 1; child <= N - 1; ++child) { /* link all but the last child */\
+            STIndex next = YYRHSLOC(Rhs, child + 1).st_node;                              \
+            STNodeAt(YYRHSLOC(Rhs, child).st_node)->next = next;                          \
           }                                                                               \
+          node->child = YYRHSLOC(Rhs, 1).st_node, node->next = 0;                         \
+        } else {                                                                          \
+          node->child = node->next = 0;                                                   \
         }                                                                                 \
-        for (int child = 1; child <= N - 1; ++child) { /* link all but the last child */  \
-          (YYRHSLOC(Rhs, child).st_node)->next = YYRHSLOC(Rhs, child + 1).st_node;        \
+        if (STIsList(kind)) {                                                             \
+          node->tail = node->child ? YYRHSLOC(Rhs, N).st_node : 0;                        \
         }                                                                                 \
-        node->child = YYRHSLOC(Rhs, 1).st_node, node->next = NULL;                        \
-      } else {                                                                            \
-        node->child = node->next = NULL;                                                  \
+        (Cur).st_node = index;                                                            \
       }                                                                                   \
-      (Cur).st_node = node;                                                               \
     } while (0)
 
+  /* STKind of each nonterminal symbol, see STPrepareKinds */
+  static signed char stkinds[ST_KIND_COUNT];
+
+  /* Deeply nested expressions need a deep parser stack, it grows on demand */
+  #define YYMAXDEPTH 10000000
+
   /* Custom error template */
   #define YY_(Msg) Msg
 
   #include "lex.yy.c"
-  void yyerror(char *);
+  void yyerror(YYLTYPE *, SCScanner *, const char *);
+  static void STStreamExtDef(SCScanner *, STIndex list, YYLTYPE *lookahead);
+  static void STJoinStmts(STIndex comp);
 %}
 
 %token TYPE ID
@@ -88,15 +130,15 @@
 %right NOT NEG
 %left  DOT LB RB LP RP
 
-%printer { fprintf(stderr, "%u", yylval.ival); } INT
-%printer { fprintf(stderr, "%f", yylval.fval); } FLOAT
-%printer { fprintf(stderr, "%s", yytext); }      RELOP
+%printer { fprintf(stderr, "%u", $$.ival); } INT
+%printer { fprintf(stderr, "%f", $$.fval); } FLOAT
+%printer { fprintf(stderr, "%s", scanner->text); } RELOP
 
 %%
 /* A.1.2 High-level Definitions */
-Program: ExtDefList { stroot = @$.st_node; }
+Program: ExtDefList { scanner->root = @$.st_node; }
   ;
-ExtDefList: ExtDef ExtDefList
+ExtDefList: ExtDefList ExtDef { STStreamExtDef(scanner, @$.st_node, yychar != YYEMPTY ? &yylloc : NULL); }
   | /* empty */
   ;
 ExtDef: Specifier ExtDecList SEMI
@@ -107,7 +149,7 @@ ExtDef: Specifier ExtDecList SEMI
   | error FunDec CompSt
   ;
 ExtDecList: VarDec
-  | VarDec COMMA ExtDecList
+  | ExtDecList COMMA VarDec
   ;
 
 /* A.1.3 Specifiers */
@@ -132,18 +174,23 @@ FunDec: ID LP VarList RP
   | ID LP RP
   | error RP /* either ID or VarList */
   ;
-VarList: ParamDec COMMA VarList
+VarList: VarList COMMA ParamDec
   | ParamDec
   ;
 ParamDec: Specifier VarDec
   ;
 
 /* A.1.5 Statements */
+/* The statements follow an empty StmtList, so that only an error before
+   the first one may end at RC, as with a right-recursive StmtList */
 CompSt: LC DefList StmtList RC
-  | LC DefList error RC
+  | LC DefList StmtList Stmts RC { STJoinStmts(@$.st_node); }
+  | LC DefList StmtList error RC
   ;
-StmtList: Stmt StmtList
-  | /* EMPTY */
+StmtList: /* EMPTY */
+  ;
+Stmts: Stmts Stmt
+  | Stmt
   ;
 Stmt: Exp SEMI
   | CompSt
@@ -159,14 +206,14 @@ Stmt: Exp SEMI
   ;
 
 /* A.1.6 Local Definitions */
-DefList: Def DefList
+DefList: DefList Def
   | /* EMPTY */
   ;
 Def: Specifier DecList SEMI
   | Specifier error SEMI
   ;
 DecList: Dec
-  | Dec COMMA DecList
+  | DecList COMMA Dec
   ;
 Dec: VarDec
   | VarDec ASSIGNOP Exp
@@ -202,22 +249,207 @@ Exp: Exp ASSIGNOP Exp
   | INT
   | FLOAT
   ;
-Args: Exp COMMA Args
+Args: Args COMMA Exp
   | Exp
   ;
 
 %%
-extern int  errLineno;
-extern bool hasErrorB;
-void yyerror(char *msg) {
-  hasErrorB = true;
-  if (errLineno == yylineno) return; // one error per line
-  else errLineno = yylineno;
-  fprintf(stderr, "Error type B at Line %d: %s near '%s'.\n", yylineno, msg, yytext);
+void yyerror(YYLTYPE *lloc, SCScanner *scanner, const char *msg) {
+  (void)lloc;
+  scanner->failed = true;
+  if (scanner->quiet) return;
+  CCContext *ctx = scanner->ctx;
+  ctx->hasErrorB = true;
+  if (ctx->errLineno == scanner->lineno) return; // one error per line
+  else ctx->errLineno = scanner->lineno;
+  fprintf(ctx->err, "Error type B at Line %d: %s near '%s'.\n", scanner->lineno, msg, scanner->text);
+}
+// Hand the ExtDef just appended to the list to the hook, then take it
+// out of the list and give its nodes back to the pool. The lookahead
+// token, if any, is the last node, it moves down to the first free one.
+static void STStreamExtDef(SCScanner *scanner, STIndex list, YYLTYPE *lookahead) {
+  CCContext *ctx = scanner->ctx;
+  if (!scanner->stream || ctx->hasErrorA || ctx->hasErrorB) return;
+  STNode *node = STNodeAt(list);
+  ctx->hook(ctx, STNodeAt(node->tail));
+  node->child = node->tail = 0;
+  node->empty = true;
+  size_t first = STPoolOffset(scanner->pool, list) + 1;
+  if (scanner->streamed > first) first = scanner->streamed;
+  if (lookahead != NULL && lookahead->st_node != 0) {
+    size_t offset = STPoolOffset(scanner->pool, lookahead->st_node);
+    Assert(offset == STPoolSize(scanner->pool) - 1, "lookahead is not the last node");
+    if (offset >= first) {
+      STIndex index = STPoolIndex(scanner->pool, first++);
+      *STNodeAt(index) = *STNodeAt(lookahead->st_node);
+      lookahead->st_node = index;
+    }
+  }
+  STRelease(scanner->pool, first);
+  scanner->streamed = first;
+}
+const char *STTokenName(int token) {
+  return yytname[YYTRANSLATE(token)];
 }
-int yyparse_wrap() {
+// Map the nonterminals of the grammar to STKind by name.
+static void STPrepareKinds() {
+  Assert(YYNNTS == ST_KIND_COUNT, "ST_NTERMS does not match the grammar");
+  stkinds[0] = ST_TOKEN; // $accept
+  for (int symbol = 1; symbol < YYNNTS; ++symbol) {
+    int kind = 1;
+    while (kind < ST_KIND_COUNT && strcmp(yytname[YYNTOKENS + symbol], STKindNames[kind])) ++kind;
+    Assert(kind < ST_KIND_COUNT, "nonterminal %s not in ST_NTERMS", yytname[YYNTOKENS + symbol]);
+    stkinds[symbol] = kind;
+  }
+}
+static pthread_once_t stkindsOnce = PTHREAD_ONCE_INIT;
+// Append the items of list from to the list to.
+static void STAppendList(STNode *to, STNode *from) {
+  if (from->child == 0) return;
+  if (to->child == 0) {
+    to->line   = from->line;
+    to->column = from->column;
+    to->empty  = false;
+    to->child  = from->child;
+  } else {
+    STNodeAt(to->tail)->next = from->child;
+  }
+  to->tail = from->tail;
+}
+// Move the Stmts of comp into its empty StmtList.
+static void STJoinStmts(STIndex comp) {
+  STNode *node = STNodeAt(comp);
+  if (node->child == 0) return; // not healthy
+  STNode *list = STNext(STNext(STNodeAt(node->child)));
+  STNode *stmts = STNext(list);
+  STAppendList(list, stmts);
+  list->next = stmts->next;
+}
+// Take the Program parsed by a scanner as the root, or append its
+// ExtDefs to the root if there is one.
+static void STTakeRoot(CCContext *ctx, STIndex root) {
+  if (ctx->root == NULL) {
+    ctx->root = STNodeAt(root);
+  } else {
+    STAppendList(STChild(ctx->root), STChild(STNodeAt(root)));
+  }
+}
+#if SCSPLIT && SCHAND && STARENA
+// Hand the ExtDefs of a parsed Program to the hook, or collect them
+// under the root if there is none.
+static void STTakeProgram(CCContext *ctx, STIndex root) {
+  if (ctx->hook != NULL) {
+    STNode *list = STChild(STNodeAt(root));
+    for (STNode *edef = STChild(list), *next = NULL; edef != NULL; edef = next) {
+      next = STNext(edef);
+      edef->next = 0;
+      ctx->hook(ctx, edef);
+    }
+  } else {
+    STTakeRoot(ctx, root);
+  }
+}
+/**
+ * The source is split into chunks of whole ExtDefs, each parsed on a
+ * worker into a pool of its own. Chunks are taken over in order, as if
+ * parsed one after another: their ExtDefs go to the hook (and the pool
+ * is given back) or are collected under the root. Parsing a chunk does
+ * not report errors. From the first chunk with an error on, the source
+ * is parsed once more on this thread, which then reports them as usual.
+ * */
+typedef struct STChunkJob {
+  WKJob job;
+  CCContext *ctx;
+  SCScanner scanner;
+  STPool pool;
+  const char *source;
+  size_t size;
+  SCChunk chunk;
+} STChunkJob;
+#define ST_CHUNKS_AHEAD 8 // chunks parsed but not taken over at most
+// Parse a chunk, on a worker.
+static void runChunkJob(WKJob *job) {
+  STChunkJob *parse = (STChunkJob *)job;
+  parse->scanner.ctx = parse->ctx;
+  parse->scanner.pool = &parse->pool;
+  parse->scanner.quiet = true;
+  parse->scanner.stream = false;
+  SCStartCopy(&parse->scanner, parse->source, parse->size,
+              parse->chunk.lineno, parse->chunk.column);
+  yyparse(&parse->scanner);
+  SCFinish(&parse->scanner);
+}
+// Take a parsed chunk over, in the order of the source.
+static void retireChunkJob(WKJob *job) {
+  STChunkJob *parse = (STChunkJob *)job;
+  CCContext *ctx = parse->ctx;
+  --ctx->splitAhead;
+  if (!ctx->splitFailed && !parse->scanner.failed) {
+    STTakeProgram(ctx, parse->scanner.root);
+  } else if (!ctx->splitFailed) {
+    ctx->splitFailed = true;
+    ctx->splitResume = parse->chunk;
+  }
+  if (ctx->hook != NULL || ctx->splitFailed) {
+    STFreePool(&parse->pool);
+  } else {
+    STKeepPool(&parse->pool, &ctx->kept);
+  }
+  free(parse);
+}
+// Parse the chunks of source on the workers. Return false if the rest
+// from resume on is left to parse, which is all for a single chunk.
+static bool STParseChunks(CCContext *ctx, const char *source, size_t size, SCChunk *resume) {
+  SCChunk *chunks = NULL;
+  size_t count = SCSplit(source, size, SC_SPLIT_SIZE, &chunks);
+  ctx->splitFailed = count < 2;
+  ctx->splitAhead = 0;
+  if (count >= 2) {
+    for (size_t i = 0; i < count && !ctx->splitFailed; ++i) {
+      while (ctx->splitAhead >= ST_CHUNKS_AHEAD && WKRetireFirst(&ctx->workers)) continue;
+      ++ctx->splitAhead;
+      STChunkJob *parse = (STChunkJob *)malloc(sizeof(STChunkJob));
+      Assert(parse != NULL, "out of memory for chunks");
+      parse->job.run = runChunkJob;
+      parse->job.retire = retireChunkJob;
+      parse->ctx = ctx;
+      parse->pool = (STPool)ST_POOL_INIT;
+      parse->source = source + chunks[i].begin;
+      parse->size = (i + 1 < count ? chunks[i + 1].begin : size) - chunks[i].begin;
+      parse->chunk = chunks[i];
+      WKSubmit(&ctx->workers, &parse->job);
+    }
+    WKDrain(&ctx->workers);
+    if (ctx->splitFailed) *resume = ctx->splitResume;
+  }
+  free(chunks);
+  return !ctx->splitFailed;
+}
+#endif
+// Parse source[0..size) into the pool of ctx, handing the ExtDefs to
+// the hook of ctx or collecting them under the root. The chunks are
+// scanned in copies, the rest in place in buffer unless it is NULL.
+int yyparse_wrap(CCContext *ctx, const char *source, char *buffer, size_t size) {
+  pthread_once(&stkindsOnce, STPrepareKinds);
 #if YYDEBUG
   yydebug = 1;
 #endif
-  return yyparse();
+  SCChunk resume = {0, 1, 1};
+#if SCSPLIT && SCHAND && STARENA
+  if (STParseChunks(ctx, source, size, &resume)) return 0;
+#endif
+  SCScanner scanner;
+  scanner.ctx = ctx;
+  scanner.pool = &ctx->pool;
+  scanner.quiet = false;
+  scanner.stream = ctx->hook != NULL;
+  if (buffer != NULL) {
+    SCStart(&scanner, buffer + resume.begin, size - resume.begin, resume.lineno, resume.column);
+  } else {
+    SCStartCopy(&scanner, source + resume.begin, size - resume.begin, resume.lineno, resume.column);
+  }
+  int result = yyparse(&scanner);
+  SCFinish(&scanner);
+  if (scanner.root != 0) STTakeRoot(ctx, scanner.root);
+  return result;
 }
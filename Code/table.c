@@ -1,151 +1,206 @@
+#include <stdint.h>
 #include <string.h>
 #include "type.h"
 #include "table.h"
+#include "compiler.h"
 #include "semantics.h"
 #include "syntax.tab.h"
 #include "debug.h"
 
-STStack *struStack = NULL;
-STStack *funcStack = NULL;
-STStack *currStack = NULL;
+#define ST_INIT_CAPACITY 1024 // must be a power of 2
+
+enum { ST_GLOBAL_STRU, ST_GLOBAL_FUNC };
+
+// Grow an array of count items to hold one more.
+#define STReserve(array, count, capacity)                                      \
+  do {                                                                         \
+    if ((count) == (capacity)) {                                               \
+      (capacity) = (capacity) ? (capacity) * 2 : 64;                           \
+      (array) = realloc((array), sizeof(*(array)) * (capacity));               \
+      Assert((array) != NULL, "out of memory for symbol table");               \
+    }                                                                          \
+  } while (0)
+
+// Hash an interned name by its address.
+static size_t STHash(const char *id) {
+  uint64_t hash = (uint64_t)(uintptr_t)id;
+  hash ^= hash >> 4;
+  hash *= 0x9E3779B97F4A7C15ull;
+  return (size_t)(hash >> 32);
+}
+
+// Double the capacity of the table and rehash all symbols.
+static void STGrow(STTable *table) {
+  size_t capacity = table->capacity * 2;
+  STSymbol *symbols = (STSymbol *)calloc(capacity, sizeof(STSymbol));
+  Assert(symbols != NULL, "out of memory for symbol table");
+  for (size_t i = 0; i < table->capacity; ++i) {
+    if (table->symbols[i].id == NULL) continue;
+    size_t j = STHash(table->symbols[i].id) & (capacity - 1);
+    while (symbols[j].id != NULL) j = (j + 1) & (capacity - 1);
+    symbols[j] = table->symbols[i];
+  }
+  free(table->symbols);
+  table->symbols = symbols;
+  table->capacity = capacity;
+}
+
+// Find the slot of a name, create it if asked. Valid until next creation.
+static STSymbol *STFind(STTable *table, const char *id, bool create) {
+  size_t i = STHash(id) & (table->capacity - 1);
+  while (table->symbols[i].id != NULL) {
+    if (table->symbols[i].id == id) return &table->symbols[i];
+    i = (i + 1) & (table->capacity - 1);
+  }
+  if (!create) return NULL;
+  if ((table->count + 1) * 2 > table->capacity) { // keep load factor below 1/2
+    STGrow(table);
+    i = STHash(id) & (table->capacity - 1);
+    while (table->symbols[i].id != NULL) i = (i + 1) & (table->capacity - 1);
+  }
+  ++table->count;
+  table->symbols[i].id = id;
+  return &table->symbols[i];
+}
+
+// Allocate an entry from the arena.
+static STEntry *STNewEntry(Arena *arena, const char *id, SEType *type) {
+  STEntry *entry = (STEntry *)ARAlloc(arena, sizeof(STEntry));
+  entry->id = id;
+  entry->type = type;
+  entry->shadow = NULL;
+  entry->depth = 0;
+  return entry;
+}
+
+// Record a structure or a function, return the entry.
+static STEntry *STInsertGlobal(STTable *table, int kind, const char *id, SEType *type) {
+  STEntry *entry = STNewEntry(&table->arena, id, type);
+  entry->number = -1;
+  entry->allocate = false;
+  STReserve(table->globals[kind], table->globalCount[kind], table->globalCapacity[kind]);
+  table->globals[kind][table->globalCount[kind]++] = entry;
+  return entry;
+}
 
 // Prepare the base (global) symbol table.
-void STPrepare() {
-  currStack = NULL;
-  STPushStack(STACK_GLOBAL); // stack for structures
-  struStack = currStack;
-  STPushStack(STACK_GLOBAL); // stack for functions
-  funcStack = currStack;
-  STPushStack(STACK_LOCAL); // the global scope for variables
-  SEPrepare();
+void STPrepare(CCContext *ctx) {
+  STTable *table = &ctx->table;
+  *table = (STTable){ .arena = table->arena, .scopeArena = table->scopeArena };
+  table->capacity = ST_INIT_CAPACITY;
+  table->symbols = (STSymbol *)calloc(table->capacity, sizeof(STSymbol));
+  Assert(table->symbols != NULL, "out of memory for symbol table");
+  STPushStack(ctx, STACK_LOCAL); // the global scope for variables
+  SEPrepare(ctx);
 }
 
 // Destroy all symbol tables in system.
-void STDestroy() {
-  while (currStack != NULL) STPopStack();
+void STDestroy(CCContext *ctx) {
+  STTable *table = &ctx->table;
+  while (table->depth > 0) STPopStack(ctx);
+  for (size_t i = 0; i < table->globalCount[ST_GLOBAL_FUNC]; ++i) {
+    STEntry *entry = table->globals[ST_GLOBAL_FUNC][i];
+    if (!entry->type->function.defined) {
+      // undefined function detected when destroying the table
+      throwErrorS(ctx, SE_FUNCTION_DECLARED_NOT_DEFINED, entry->type->function.line, entry->id);
+    }
+  }
+  for (int kind = ST_GLOBAL_STRU; kind <= ST_GLOBAL_FUNC; ++kind) {
+    free(table->globals[kind]);
+  }
+  free(table->symbols);
+  free(table->stacks);
+  free(table->log);
+  ARReset(&table->arena); // kept for the next compilation, see CCFree
+  ARReset(&table->scopeArena);
+  *table = (STTable){ .arena = table->arena, .scopeArena = table->scopeArena };
+  SEDestroy(ctx);
 }
 
 // Get type of current ST stack.
-enum STStackType getCurrentStackType() {
-  return currStack->type;
+enum STStackType getCurrentStackType(CCContext *ctx) {
+  return ctx->table.stacks[ctx->table.depth - 1].type;
 }
 
-// Create a new syntax table and push it into chain.
-void STPushStack(enum STStackType type) {
-  STStack *top = (STStack *)malloc(sizeof(STStack));
-  Log("Push ST %p (type %d)", top, type);
-  top->type = type;
-  top->root = NULL;
-  top->prev = currStack;
-  currStack = top;
+// Open a new scope on top of the current one.
+void STPushStack(CCContext *ctx, enum STStackType type) {
+  STTable *table = &ctx->table;
+  STReserve(table->stacks, table->depth, table->stacksCapacity);
+  Log("Push ST %zu (type %d)", table->depth, type);
+  table->stacks[table->depth].type = type;
+  table->stacks[table->depth].mark = table->logCount;
+  table->stacks[table->depth].region = ARGetMark(&table->scopeArena);
+  ++table->depth;
 }
 
-// Pop the last syntax table in chain and destroy it.
-void STPopStack() {
-  if (currStack == NULL) return;
-  STStack *prev = currStack->prev;
-  Log("Pop ST %p", currStack);
-  RBDestroy(&(currStack->root), STRBDestroy);
-  free(currStack);
-  currStack = prev;
+// Close the current scope, undo its bindings and free its region.
+void STPopStack(CCContext *ctx) {
+  STTable *table = &ctx->table;
+  if (table->depth == 0) return;
+  STStack *top = &table->stacks[--table->depth];
+  Log("Pop ST %zu", table->depth);
+  for (size_t i = top->mark; i < table->logCount; ++i) {
+    STEntry *entry = table->log[i];
+    STFind(table, entry->id, false)->top = entry->shadow;
+  }
+  table->logCount = top->mark;
+  ARRelease(&table->scopeArena, top->region);
 }
 
 // Insert a symbol into stru (structure) ST.
-void STInsertStru(const char *id, SEType *type) {
-  STEntry *entry = (STEntry *)malloc(sizeof(STEntry));
-  entry->id = id;
-  entry->number = -1;
-  entry->allocate = false;
-  entry->type = type;
+void STInsertStru(CCContext *ctx, const char *id, SEType *type) {
+  STEntry *entry = STInsertGlobal(&ctx->table, ST_GLOBAL_STRU, id, type);
   Log("Insert to stru ST: %p %p \"%s\"", entry, type, id);
-  RBInsert(&(struStack->root), (void *)entry, STRBCompare);
+  STFind(&ctx->table, id, true)->stru = entry;
 }
 
 // Insert a symbol into func (function) ST.
-void STInsertFunc(const char *id, SEType *type) {
-  STEntry *entry = (STEntry *)malloc(sizeof(STEntry));
-  entry->id = id;
-  entry->number = -1;
-  entry->allocate = false;
-  entry->type = type;
+void STInsertFunc(CCContext *ctx, const char *id, SEType *type) {
+  STEntry *entry = STInsertGlobal(&ctx->table, ST_GLOBAL_FUNC, id, type);
   Log("Insert to func ST: %p %p \"%s\"", entry, type, id);
-  RBInsert(&(funcStack->root), (void *)entry, STRBCompare);
+  STFind(&ctx->table, id, true)->func = entry;
 }
 
 // Insert a symbol into current (local) ST.
-void STInsertCurr(const char *id, SEType *type, bool allocate) {
-  STEntry *entry = (STEntry *)malloc(sizeof(STEntry));
-  entry->id = id;
+void STInsertCurr(CCContext *ctx, const char *id, SEType *type, bool allocate) {
+  STTable *table = &ctx->table;
+  STEntry *entry = STNewEntry(&table->scopeArena, id, type);
   entry->number = 0;
   entry->allocate = allocate;
-  entry->type = type;
+  entry->depth = table->depth;
   Log("Insert to curr ST: %p %p \"%s\"", entry, type, id);
-  RBInsert(&(currStack->root), (void *)entry, STRBCompare);
+  STSymbol *symbol = STFind(table, id, true);
+  Assert(symbol->top == NULL || symbol->top->depth < table->depth,
+         "inserting existed symbol \"%s\"", id);
+  entry->shadow = symbol->top;
+  symbol->top = entry;
+  STReserve(table->log, table->logCount, table->logCapacity);
+  table->log[table->logCount++] = entry;
 }
 
-// Search a symbol name in all STs.
-STEntry *STSearch(const char *id) {
-  STEntry target;
-  target.id = id;
-
-  STStack *cur = currStack;
-  STEntry *result = NULL;
-  while (cur != NULL) {
-    result = STSearchAt(cur, &target);
-    if (result != NULL) break;
-    cur = cur->prev;
-  }
-  return result;
+// Search a symbol name in all STs: variables, then functions, then structures.
+STEntry *STSearch(CCContext *ctx, const char *id) {
+  STSymbol *symbol = STFind(&ctx->table, id, false);
+  if (symbol == NULL) return NULL;
+  if (symbol->top != NULL) return symbol->top;
+  return symbol->func != NULL ? symbol->func : symbol->stru;
 }
 
 // Search a symbol name in stru (structure) ST.
-STEntry *STSearchStru(const char *id) {
-  STEntry target;
-  target.id = id;
-  return STSearchAt(struStack, &target);
+STEntry *STSearchStru(CCContext *ctx, const char *id) {
+  STSymbol *symbol = STFind(&ctx->table, id, false);
+  return symbol != NULL ? symbol->stru : NULL;
 }
 
 // Search a symbol name in func (function) ST.
-STEntry *STSearchFunc(const char *id) {
-  STEntry target;
-  target.id = id;
-  return STSearchAt(funcStack, &target);
+STEntry *STSearchFunc(CCContext *ctx, const char *id) {
+  STSymbol *symbol = STFind(&ctx->table, id, false);
+  return symbol != NULL ? symbol->func : NULL;
 }
 
 // Search a symbol name in current (local) ST.
-STEntry *STSearchCurr(const char *id) {
-  STEntry target;
-  target.id = id;
-  return STSearchAt(currStack, &target);
-}
-
-// Search a symbol ENTRY in a specified ST **inner function**.
-STEntry *STSearchAt(STStack *stack, STEntry *target) {
-  RBNode *candidate = RBSearch(&(stack->root), target, STRBCompare);
-  if (candidate && !STRBCompare(candidate->value, target)) {
-    return (STEntry *)(candidate->value);
-  } else {
-    return NULL;
-  }
-}
-
-// Compare two ST entries.
-int STRBCompare(const void *p1, const void *p2) {
-  return strcmp(((const STEntry *)p1)->id, ((const STEntry *)p2)->id);
-}
-
-// Destroy an ST entry.
-void STRBDestroy(void *p) {
-  STEntry *entry = (STEntry *)p;
-  if (currStack->type == STACK_GLOBAL ||
-      (currStack->type == STACK_LOCAL && !entry->type->extended)) {
-    // only destroy types in global ST or non-struct in local ST
-    Log("Destroy from ST: %p %p \"%s\"", p, entry->type, entry->id);
-    SEDestroyType(entry->type);
-    if (entry->id[0] == ' ') {
-      // anonymous object, destroy its name
-      free((char *)entry->id);
-    }
-  }
-  free(p);
+STEntry *STSearchCurr(CCContext *ctx, const char *id) {
+  STSymbol *symbol = STFind(&ctx->table, id, false);
+  if (symbol == NULL || symbol->top == NULL) return NULL;
+  return symbol->top->depth == ctx->table.depth ? symbol->top : NULL;
 }
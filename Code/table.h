@@ -1,22 +1,39 @@
 /**
  * The symbol table/stack structure.
  * Copyright, Tianyun Zhang, 2020/03/30.
+ *
+ * All scopes share one open-addressing hash table keyed by interned name.
+ * A slot holds the structure and function of that name and the stack of
+ * its variable bindings, innermost first. Each scope remembers where it
+ * starts in an undo log of the bindings it made, so popping a scope only
+ * unlinks those bindings. Lookup cost does not depend on nesting depth.
+ * The bindings of a scope live in a region of an arena, which is freed
+ * in one step when the scope is popped.
  * */
 
 #ifndef TABLE_H
 #define TABLE_H
 
-#include "rbtree.h"
 #include "type.h"
+#include "arena.h"
 
 // Be careful, STNode is already taken in 'tree.c'.
 typedef struct STEntry {
-  const char *id;
+  const char *id; // interned
   unsigned int number; // used for IR variables
   bool allocate; // used for IR memblocks
   SEType *type;
+  struct STEntry *shadow; // binding of the same id in an outer scope
+  unsigned int depth; // scope of the binding
 } STEntry;
 
+// Slot of the hash table, id is NULL if empty.
+typedef struct STSymbol {
+  const char *id;
+  STEntry *stru, *func; // global names
+  STEntry *top; // innermost variable binding
+} STSymbol;
+
 enum STStackType {
   STACK_GLOBAL,    // global stack, destroy all contents.
   STACK_LOCAL,     // local stack, do NOT destroy structures.
@@ -24,29 +41,40 @@ enum STStackType {
 };
 typedef struct STStack {
   enum STStackType type;
-  struct RBNode *root;
-  struct STStack *prev; // no next
+  size_t mark; // undo log length when pushed
+  ARMark region; // top of the scope arena when pushed
 } STStack;
 
-void STPrepare();
-void STDestroy();
+// The symbol table of a compilation, see table.c.
+typedef struct STTable {
+  STSymbol *symbols;
+  size_t capacity, count;
+  STStack *stacks; // scopes of variables, the bottom one is the global scope
+  size_t depth, stacksCapacity;
+  STEntry **log; // undo log: variable bindings in the order they were made
+  size_t logCount, logCapacity;
+  STEntry **globals[2]; // structures and functions in the order they were declared
+  size_t globalCount[2], globalCapacity[2];
+  Arena arena; // entries of structures and functions
+  Arena scopeArena; // entries of variables, in the region of their scope
+} STTable;
+
+struct CCContext;
 
-enum STStackType getCurrentStackType();
-void STPushStack(enum STStackType type);
-void STPopStack();
+void STPrepare(struct CCContext *ctx);
+void STDestroy(struct CCContext *ctx);
 
-void STInsertStru(const char *id, SEType *type);
-void STInsertFunc(const char *id, SEType *type);
-void STInsertCurr(const char *id, SEType *type, bool allocate);
+enum STStackType getCurrentStackType(struct CCContext *ctx);
+void STPushStack(struct CCContext *ctx, enum STStackType type);
+void STPopStack(struct CCContext *ctx);
 
-STEntry *STSearch(const char *id);
-STEntry *STSearchStru(const char *id);
-STEntry *STSearchFunc(const char *id);
-STEntry *STSearchCurr(const char *id);
-STEntry *STSearchAt(STStack *stack, STEntry *target);
+void STInsertStru(struct CCContext *ctx, const char *id, SEType *type);
+void STInsertFunc(struct CCContext *ctx, const char *id, SEType *type);
+void STInsertCurr(struct CCContext *ctx, const char *id, SEType *type, bool allocate);
 
-// helpers
-int STRBCompare(const void *p1, const void *p2);
-void STRBDestroy(void *p);
+STEntry *STSearch(struct CCContext *ctx, const char *id);
+STEntry *STSearchStru(struct CCContext *ctx, const char *id);
+STEntry *STSearchFunc(struct CCContext *ctx, const char *id);
+STEntry *STSearchCurr(struct CCContext *ctx, const char *id);
 
 #endif // TABLE_H
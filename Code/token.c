@@ -1,5 +1,6 @@
 #include "token.h"
 #include "debug.h"
+#include "intern.h"
 #include <stdlib.h>
 
 enum ENUM_RELOP RELOP_REV(enum ENUM_RELOP relop) {
@@ -45,4 +46,4 @@ GETYYLVAL(enum ENUM_RELOP, r) {
   }
 }
 
-GETYYLVAL(void, s) { strcpy(yylval.sval, str); }
+GETYYLVAL(void, s) { yylval.atom = INAtom(str, len); }
@@ -32,19 +32,19 @@ typedef struct YYSTYPE {
     unsigned        ival;
     float           fval;
     enum ENUM_RELOP rval;
-    char            sval[64];
+    unsigned int    atom; // interned
   };
 } YYSTYPE;
 #define YYSTYPE_IS_DECLARED true
 #define YYSTYPE_IS_TRIVIAL  true
 extern YYSTYPE yylval;
 
-/* Custom YYLTYPE, add a pointer to STNode */
+/* Custom YYLTYPE, add an index of STNode (0 for none) */
 #define YYLTYPE YYLTYPE
 typedef struct YYLTYPE {
   int first_line, first_column;
   int last_line, last_column;
-  struct STNode *st_node;
+  unsigned int st_node;
 } YYLTYPE;
 #define YYLTYPE_IS_DECLARED true
 #define YYLTYPE_IS_TRIVIAL  true
@@ -1,22 +1,202 @@
+#include <pthread.h>
 #include <stdio.h>
 #include <assert.h>
 #include "tree.h"
+#include "debug.h"
 #include "syntax.tab.h"
 
-void printSyntaxTree() {
-  printSyntaxTreeAux(stroot, 0);
+/**
+ * The node table. Index 0 is reserved as the null node.
+ * With the arena, nodes are carved from fixed-size chunks which never
+ * move, so both indices and pointers stay valid until teardown. Pools
+ * take chunks from the bottom up, chunks given back are kept for reuse.
+ * Otherwise each node is malloc'd and only the index table grows.
+ * */
+#if STARENA
+STNode *stchunks[ST_CHUNK_COUNT];
+static unsigned int sttop = 1; // lowest chunk never taken, chunk 0 is not used
+static unsigned int *stspare = NULL, stspareCount = 0, stspareCapacity = 0;
+static pthread_mutex_t stlock = PTHREAD_MUTEX_INITIALIZER;
+#else
+STNode **stnodes = NULL;
+static size_t stnodeCapacity = 0;
+static STIndex stcount = 0;
+#endif
+
+const char *const STKindNames[ST_KIND_COUNT] = {
+  "token",
+#define ST_KIND_NAME(name) #name,
+  ST_NTERMS(ST_KIND_NAME)
+#undef ST_KIND_NAME
+};
+
+#if STARENA
+// Take a chunk for a pool.
+static unsigned int STTakeChunk() {
+  pthread_mutex_lock(&stlock);
+  Assert(stspareCount > 0 || sttop < ST_CHUNK_COUNT, "too many syntax tree nodes");
+  unsigned int chunk = stspareCount > 0 ? stspare[--stspareCount] : sttop++;
+  pthread_mutex_unlock(&stlock);
+  if (stchunks[chunk] == NULL) {
+    stchunks[chunk] = (STNode *)malloc(sizeof(STNode) << ST_CHUNK_BITS);
+    Assert(stchunks[chunk] != NULL, "out of memory for node pool");
+  }
+  return chunk;
+}
+
+// Give chunks back for reuse.
+static void STGiveChunks(const unsigned int *chunks, unsigned int count) {
+  pthread_mutex_lock(&stlock);
+  for (unsigned int i = 0; i < count; ++i) {
+    if (stspareCount == stspareCapacity) {
+      stspareCapacity = stspareCapacity ? stspareCapacity * 2 : 64;
+      stspare = (unsigned int *)realloc(stspare, sizeof(unsigned int) * stspareCapacity);
+      Assert(stspare != NULL, "out of memory for node pool");
+    }
+    stspare[stspareCount++] = chunks[i];
+  }
+  pthread_mutex_unlock(&stlock);
+}
+
+// Make room for one more chunk in a pool.
+static void STReserveChunk(STPool *pool) {
+  if (pool->count == pool->capacity) {
+    pool->capacity = pool->capacity ? pool->capacity * 2 : 16;
+    pool->chunks = (unsigned int *)realloc(pool->chunks, sizeof(unsigned int) * pool->capacity);
+    Assert(pool->chunks != NULL, "out of memory for node pool");
+  }
+}
+
+// Allocate a new (uninitialized) STNode from a pool, return its index.
+STIndex STNewNode(STPool *pool) {
+  if (pool->left == 0) {
+    STReserveChunk(pool);
+    unsigned int chunk = STTakeChunk();
+    pool->chunks[pool->count++] = chunk;
+    pool->next = chunk << ST_CHUNK_BITS;
+    pool->left = 1u << ST_CHUNK_BITS;
+  }
+  --pool->left;
+  return pool->next++;
+}
+
+// Get the number of nodes taken from a pool, the offset of the next one.
+size_t STPoolSize(const STPool *pool) {
+  return ((size_t)pool->count << ST_CHUNK_BITS) - pool->left;
+}
+
+// Get the offset of a node in its pool.
+size_t STPoolOffset(const STPool *pool, STIndex index) {
+  for (unsigned int i = pool->count; i-- > 0;) { // recent nodes first
+    if (pool->chunks[i] == index >> ST_CHUNK_BITS) {
+      return ((size_t)i << ST_CHUNK_BITS) | (index & ST_CHUNK_MASK);
+    }
+  }
+  Panic("node %u not in pool", index);
+  return 0;
+}
+
+// Get the index of the node at offset of a pool.
+STIndex STPoolIndex(const STPool *pool, size_t offset) {
+  Assert(offset < STPoolSize(pool), "offset %zu out of pool", offset);
+  return (pool->chunks[offset >> ST_CHUNK_BITS] << ST_CHUNK_BITS) | (offset & ST_CHUNK_MASK);
+}
+
+// Give the nodes of a pool from offset on back.
+void STRelease(STPool *pool, size_t offset) {
+  Assert(offset <= STPoolSize(pool), "releasing node %zu of %zu", offset, STPoolSize(pool));
+  unsigned int keep = (unsigned int)((offset + ST_CHUNK_MASK) >> ST_CHUNK_BITS);
+  STGiveChunks(pool->chunks + keep, pool->count - keep);
+  pool->count = keep;
+  if ((offset & ST_CHUNK_MASK) != 0) {
+    pool->next = (pool->chunks[keep - 1] << ST_CHUNK_BITS) | (offset & ST_CHUNK_MASK);
+    pool->left = (1u << ST_CHUNK_BITS) - (offset & ST_CHUNK_MASK);
+  } else {
+    pool->left = 0;
+  }
+}
+
+// Give all the nodes of a pool back and forget it.
+void STFreePool(STPool *pool) {
+  STGiveChunks(pool->chunks, pool->count);
+  free(pool->chunks);
+  *pool = (STPool)ST_POOL_INIT;
+}
+
+// Move the nodes of a pool to keep, which is only freed later on.
+void STKeepPool(STPool *pool, STPool *keep) {
+  for (unsigned int i = 0; i < pool->count; ++i) {
+    STReserveChunk(keep);
+    keep->chunks[keep->count++] = pool->chunks[i];
+  }
+  keep->left = 0; // nothing more is taken from keep
+  free(pool->chunks);
+  *pool = (STPool)ST_POOL_INIT;
+}
+#else
+// Allocate a new (uninitialized) STNode, return its index.
+STIndex STNewNode(STPool *pool) {
+  (void)pool;
+  STIndex index = ++stcount;
+  Assert(index != 0, "too many syntax tree nodes");
+  if (index >= stnodeCapacity) {
+    stnodeCapacity = stnodeCapacity ? stnodeCapacity * 2 : 1024;
+    stnodes = (STNode **)realloc(stnodes, sizeof(STNode *) * stnodeCapacity);
+    Assert(stnodes != NULL, "out of memory for node table");
+  }
+  stnodes[index] = (STNode *)malloc(sizeof(STNode));
+  return index;
+}
+
+size_t STPoolSize(const STPool *pool) {
+  (void)pool;
+  return stcount;
+}
+
+size_t STPoolOffset(const STPool *pool, STIndex index) {
+  (void)pool;
+  return index - 1;
+}
+
+STIndex STPoolIndex(const STPool *pool, size_t offset) {
+  (void)pool;
+  return (STIndex)offset + 1;
+}
+
+// Give the nodes from offset on back.
+void STRelease(STPool *pool, size_t offset) {
+  (void)pool;
+  Assert(offset <= stcount, "releasing node %zu of %u", offset, stcount);
+  for (STIndex index = offset + 1; index <= stcount; ++index) {
+    free(stnodes[index]);
+  }
+  stcount = offset;
+}
+
+void STFreePool(STPool *pool) {
+  STRelease(pool, 0);
+}
+
+void STKeepPool(STPool *pool, STPool *keep) {
+  (void)pool;
+  (void)keep;
+}
+#endif
+
+void printSyntaxTree(STNode *root) {
+  printSyntaxTreeAux(root, 0);
 }
 
 void printSyntaxTreeAux(STNode *node, int indent) {
   if (node->empty) return;
   for (int i = 0; i < indent; ++i) printf("  ");
 
-  assert(node->name != NULL);
-  printf("%s", node->name);
-  if (node->token == -1) {
+  assert(STName(node) != NULL);
+  printf("%s", STName(node));
+  if (node->kind != ST_TOKEN) {
     /* print lineno for symbols */
     printf(" (%d)", node->line);
-  } else /* (node->token != -1) */ {
+  } else {
     /* print value/name for tokens */
     switch (node->token) {
       case INT:
@@ -27,7 +207,7 @@ void printSyntaxTreeAux(STNode *node, int indent) {
         break;
       case ID:
       case TYPE:
-        printf(": %s", node->sval);
+        printf(": %s", STId(node));
         break;
       default:
         break;
@@ -35,15 +215,26 @@ void printSyntaxTreeAux(STNode *node, int indent) {
   }
   printf("\n");
 
-  for (STNode *child = node->child; child != NULL; child = child->next) {
+  for (STNode *child = STChild(node); child != NULL; child = STNext(child)) {
     printSyntaxTreeAux(child, indent + 1);
   }
 }
 
-void teardownSyntaxTree(STNode *node) {
-  for (STNode *child = node->child, *next = NULL; child != NULL; child = next) {
-    next = child->next; // child will be freed
-    teardownSyntaxTree(child);
+// Destroy the node table, no pool must be in use.
+void teardownSyntaxTree() {
+#if STARENA
+  for (size_t chunk = 1; chunk < sttop; ++chunk) {
+    free(stchunks[chunk]);
+    stchunks[chunk] = NULL;
   }
-  free(node);
+  free(stspare);
+  stspare = NULL;
+  stspareCount = stspareCapacity = 0;
+  sttop = 1;
+#else
+  free(stnodes);
+  stnodes = NULL;
+  stnodeCapacity = 0;
+  stcount = 0;
+#endif
 }
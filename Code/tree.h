@@ -7,34 +7,113 @@
 #define TREE_H
 
 #define STDEBUG false // <- syntax tree debugger switch
+#define STARENA true  // <- syntax tree arena switch (false: malloc per node)
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "token.h"
+#include "intern.h"
 
-struct IRCode *code;
+/**
+ * Kinds of nonterminal nodes, one for each nonterminal of syntax.y in the
+ * order they appear there. The list is checked against the grammar when
+ * the parser starts (see STPrepareKinds in syntax.y). Token leaves are of
+ * kind ST_TOKEN and told apart by their token.
+ * */
+#define ST_NTERMS(X)                                                   \
+  X(Program) X(ExtDefList) X(ExtDef) X(ExtDecList) X(Specifier)        \
+  X(StructSpecifier) X(OptTag) X(Tag) X(VarDec) X(FunDec) X(VarList)   \
+  X(ParamDec) X(CompSt) X(StmtList) X(Stmts) X(Stmt) X(DefList)       \
+  X(Def) X(DecList) X(Dec) X(Exp) X(Args)
+
+typedef enum STKind {
+  ST_TOKEN,
+#define ST_KIND(name) ST_##name,
+  ST_NTERMS(ST_KIND)
+#undef ST_KIND
+  ST_KIND_COUNT,
+} STKind;
+
+/**
+ * Nodes are linked by 32-bit indices into the node pool, index 0 is
+ * the null node. Payloads are 4 bytes: literals are stored inline,
+ * identifiers as atoms of the intern table. A node takes 24 bytes.
+ * */
+typedef unsigned int STIndex;
 
 typedef struct STNode {
   int line, column;
-  int token, symbol;
-  const char* name;
+  short token;        // -1 for nterms
+  signed char kind;   // STKind
   bool empty;
+  STIndex child, next;
   union {
     unsigned int    ival;
     float           fval;
     enum ENUM_RELOP rval;
-    char            sval[64];
+    unsigned int    atom; // ID and TYPE
+    STIndex         tail; // last child of a list
   };
-  struct {
-    struct IRCode *head, *tail;
-  } ir;
-  struct STNode *child, *next;
 } STNode;
 
-extern STNode *stroot;
+/**
+ * Lists are left-recursive in syntax.y and flattened by YYLLOC_DEFAULT:
+ * a list node has all its items (and separators) as direct children,
+ * so every list is walked with a loop. Empty lists have no children.
+ * Stmts are moved into the StmtList of their CompSt once it is parsed.
+ * */
+#define ST_LIST_MASK                                                  \
+  ((1u << ST_ExtDefList) | (1u << ST_ExtDecList) | (1u << ST_VarList) | \
+   (1u << ST_StmtList) | (1u << ST_Stmts) | (1u << ST_DefList) |        \
+   (1u << ST_DecList) | (1u << ST_Args))
+#define STIsList(kind) ((ST_LIST_MASK >> (kind)) & 1u)
 
-void printSyntaxTree();
-void printSyntaxTreeAux(STNode *node, int indent);
-void teardownSyntaxTree(STNode *node);
+#define ST_CHUNK_BITS 16
+#define ST_CHUNK_MASK ((1u << ST_CHUNK_BITS) - 1)
+#define ST_CHUNK_COUNT (1u << (32 - ST_CHUNK_BITS))
 
+/**
+ * A pool of nodes, one for each parse. It takes whole chunks of the node
+ * table under a lock, so several parsers can run at once, and its nodes
+ * can be read anywhere once the parser is done. Nodes are numbered by
+ * their offset in the pool in the order they are taken, the pool can be
+ * released from an offset on. Without STARENA there is only one pool at
+ * a time, and offsets are indices.
+ * */
+typedef struct STPool {
+  STIndex next;       // next node in the current chunk
+  unsigned int left;  // nodes left in the current chunk
+  unsigned int *chunks, count, capacity;
+} STPool;
+
+#define ST_POOL_INIT { 0, 0, NULL, 0, 0 }
+
+#if STARENA
+extern STNode *stchunks[ST_CHUNK_COUNT];
+#define STNodeAt(index) (&stchunks[(index) >> ST_CHUNK_BITS][(index) & ST_CHUNK_MASK])
+#else
+extern STNode **stnodes;
+#define STNodeAt(index) (stnodes[index])
 #endif
 
+#define STChild(node) ((node)->child ? STNodeAt((node)->child) : NULL)
+#define STNext(node)  ((node)->next  ? STNodeAt((node)->next)  : NULL)
+#define STId(node)    INName((node)->atom)
+#define STNextItem(node) ((node)->next ? STNext(STNodeAt((node)->next)) : NULL) // skip a COMMA
+#define STName(node)  ((node)->kind == ST_TOKEN ? STTokenName((node)->token) : STKindNames[(node)->kind])
+
+extern const char *const STKindNames[ST_KIND_COUNT];
+
+STIndex STNewNode(STPool *pool);
+size_t STPoolSize(const STPool *pool);
+size_t STPoolOffset(const STPool *pool, STIndex index);
+STIndex STPoolIndex(const STPool *pool, size_t offset);
+void STRelease(STPool *pool, size_t offset);
+void STFreePool(STPool *pool);
+void STKeepPool(STPool *pool, STPool *keep);
+const char *STTokenName(int token); // defined in syntax.y
+void printSyntaxTree(STNode *root);
+void printSyntaxTreeAux(STNode *node, int indent);
+void teardownSyntaxTree();
+
+#endif
@@ -1,243 +1,1085 @@
+#include <stdint.h>
 #include <string.h>
+#include "arena.h"
 #include "tree.h"
 #include "type.h"
 #include "table.h"
 #include "ir.h"
+#include "intern.h"
 #include "semantics.h"
+#include "compiler.h"
 #include "syntax.tab.h"
 #include "debug.h"
 
 #ifdef DEBUG
-#define AssertSTNode(node, str) \
+#define AssertSTNode(node, nterm) \
   Assert(node, "node is null"); \
-  Assert(!strcmp(node->name, str), "not a " str);
+  Assert((node)->kind == ST_##nterm, "not a " #nterm);
 #else
-#define AssertSTNode(node, str)
+#define AssertSTNode(node, nterm)
 #endif
 
-extern bool hasErrorS;
-
-int anonymous = 0; // anonymous structure counter
-SEType _STATIC_TYPE_VOID, _STATIC_TYPE_INT, _STATIC_TYPE_FLOAT;
-SEType *STATIC_TYPE_VOID, *STATIC_TYPE_INT, *STATIC_TYPE_FLOAT;
-SEField STATIC_FIELD_VOID, STATIC_FIELD_INT, DUMMY_FIELD;
-const SEFieldChain DUMMY_FIELD_CHAIN = { &DUMMY_FIELD, &DUMMY_FIELD };
-
-void SEPrepare() {
-  // Prepare basic types
-  STATIC_TYPE_VOID = &_STATIC_TYPE_VOID;
-  STATIC_TYPE_VOID->kind = VOID;
-  STATIC_TYPE_VOID->size = -1;
-  STATIC_TYPE_VOID->parent = STATIC_TYPE_VOID;
-  STATIC_FIELD_VOID.type = STATIC_TYPE_VOID;
-  STATIC_FIELD_VOID.next = NULL;
-  STATIC_TYPE_INT = &_STATIC_TYPE_INT;
-  STATIC_TYPE_INT->kind = BASIC;
-  STATIC_TYPE_INT->size = 4;
-  STATIC_TYPE_INT->basic = INT;
-  STATIC_TYPE_INT->parent = STATIC_TYPE_INT;
-  STATIC_FIELD_INT.type = STATIC_TYPE_INT;
-  STATIC_FIELD_INT.next = NULL;
-  STATIC_TYPE_FLOAT = &_STATIC_TYPE_FLOAT;
-  STATIC_TYPE_FLOAT->kind = BASIC;
-  STATIC_TYPE_FLOAT->size = 4;
-  STATIC_TYPE_FLOAT->basic = FLOAT;
-  STATIC_TYPE_FLOAT->parent = STATIC_TYPE_FLOAT;
+// Basic types are the same for every compilation and never change.
+static SEType _STATIC_TYPE_VOID  = { .size = -1, .kind = VOID, .canon = &_STATIC_TYPE_VOID };
+static SEType _STATIC_TYPE_INT   = { .size = 4, .kind = BASIC, .canon = &_STATIC_TYPE_INT, .basic = INT };
+static SEType _STATIC_TYPE_FLOAT = { .size = 4, .kind = BASIC, .canon = &_STATIC_TYPE_FLOAT, .basic = FLOAT };
+SEType *const STATIC_TYPE_VOID  = &_STATIC_TYPE_VOID;
+SEType *const STATIC_TYPE_INT   = &_STATIC_TYPE_INT;
+SEType *const STATIC_TYPE_FLOAT = &_STATIC_TYPE_FLOAT;
+static SEField STATIC_FIELD_VOID = { .type = &_STATIC_TYPE_VOID };
+static SEField STATIC_FIELD_INT  = { .type = &_STATIC_TYPE_INT };
+
+// The chain of a variable, only its type is used, see SEParseVarDec.
+#define SE_DUMMY_CHAIN(ctx) ((SEFieldChain){ &(ctx)->se.dummy, &(ctx)->se.dummy })
+
+/**
+ * Type factory. Structurally equal types share one canonical type, which
+ * every type points to with canon, so comparing types is comparing two
+ * pointers. The parts of a type are canonical before the type is made,
+ * so finding its canonical type in the hash table compares pointers only.
+ *   ARRAY      interned by element and size, the canonical type ignores
+ *              the size (array size is not part of type equality).
+ *   STRUCTURE  one type per definition as field names differ, canonical
+ *              type chosen by the types of the fields.
+ *   FUNCTION   one type per function, canonical type chosen by the return
+ *              type and the types of the parameters.
+ * Types live in an arena until the end of the semantic scan.
+ * */
+#define SE_INIT_CAPACITY 256 // must be a power of 2
+
+// Mix a pointer or a number into a hash.
+static uint64_t SEMix(uint64_t hash, uintptr_t value) {
+  hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+  return hash ^ (hash >> 29);
+}
+
+// Hash the canonical parts of a field chain.
+static uint64_t SEHashField(uint64_t hash, const SEField *field) {
+  for (; field != NULL; field = field->next) {
+    hash = SEMix(hash, (uintptr_t)field->type->canon);
+  }
+  return hash;
+}
+
+// Hash a type by the parts that decide whether two types are the same.
+static size_t SEHashType(const SEType *type) {
+  uint64_t hash = SEMix(0, type->kind);
+  switch (type->kind) {
+    case ARRAY:
+      hash = SEMix(hash, (uintptr_t)type->array.type);
+      hash = SEMix(hash, type->array.size);
+      break;
+    case STRUCTURE:
+      hash = SEHashField(hash, type->structure.fields);
+      break;
+    case FUNCTION:
+      hash = SEMix(hash, (uintptr_t)type->function.type->canon);
+      hash = SEHashField(hash, type->function.signature);
+      break;
+    default:
+      Panic("hash %p (kind %d) not implemented", type, type->kind);
+  }
+  return (size_t)(hash >> 32);
+}
+
+// Whether two types share their entry in the table.
+static bool SESameType(const SEType *t1, const SEType *t2) {
+  if (t1->kind != t2->kind) return false;
+  switch (t1->kind) {
+    case ARRAY:
+      return t1->array.type == t2->array.type && t1->array.size == t2->array.size;
+    case STRUCTURE:
+      return SECompareField(t1->structure.fields, t2->structure.fields);
+    case FUNCTION:
+      return SECompareType(t1->function.type, t2->function.type) &&
+             SECompareField(t1->function.signature, t2->function.signature);
+    default:
+      Panic("compare %p (kind %d) not implemented", t1, t1->kind);
+  }
+  return false;
+}
+
+// Find the type in the table which is the same as type, insert type if none.
+static SEType *SEInternType(CCContext *ctx, SEType *type) {
+  size_t i = SEHashType(type) & (ctx->se.capacity - 1);
+  while (ctx->se.table[i] != NULL) {
+    if (SESameType(ctx->se.table[i], type)) return ctx->se.table[i];
+    i = (i + 1) & (ctx->se.capacity - 1);
+  }
+  if ((ctx->se.count + 1) * 2 > ctx->se.capacity) { // keep load factor below 1/2
+    size_t capacity = ctx->se.capacity * 2;
+    SEType **table = (SEType **)calloc(capacity, sizeof(SEType *));
+    Assert(table != NULL, "out of memory for type table");
+    for (size_t j = 0; j < ctx->se.capacity; ++j) {
+      if (ctx->se.table[j] == NULL) continue;
+      size_t k = SEHashType(ctx->se.table[j]) & (capacity - 1);
+      while (table[k] != NULL) k = (k + 1) & (capacity - 1);
+      table[k] = ctx->se.table[j];
+    }
+    free(ctx->se.table);
+    ctx->se.table = table;
+    ctx->se.capacity = capacity;
+    i = SEHashType(type) & (ctx->se.capacity - 1);
+    while (ctx->se.table[i] != NULL) i = (i + 1) & (ctx->se.capacity - 1);
+  }
+  ++ctx->se.count;
+  return ctx->se.table[i] = type;
+}
+
+// Get the array of size elements of type.
+SEType *SENewArrayType(CCContext *ctx, SEType *type, int size) {
+  SEType key;
+  key.kind = ARRAY;
+  key.array.size = size;
+  key.array.type = type;
+  size_t i = SEHashType(&key) & (ctx->se.capacity - 1);
+  while (ctx->se.table[i] != NULL) {
+    if (SESameType(ctx->se.table[i], &key)) return ctx->se.table[i];
+    i = (i + 1) & (ctx->se.capacity - 1);
+  }
+  SEType *array = (SEType *)ARAlloc(&ctx->se.arena, sizeof(SEType));
+  *array = key;
+  array->size = type->size * size;
+  if (type->canon == type && size == 0) {
+    array->canon = array;
+  } else {
+    array->canon = SENewArrayType(ctx, type->canon, 0);
+  }
+  return SEInternType(ctx, array);
+}
+
+// Create a structure of the fields, and lay the fields out once for all.
+// The layout is a hash table of fields by name, the first field wins.
+SEType *SENewStructType(CCContext *ctx, SEField *structure) {
+  SEType *type = (SEType *)ARAlloc(&ctx->se.arena, sizeof(SEType));
+  type->kind = STRUCTURE;
+  type->size = 0;
+  size_t count = 0;
+  for (SEField *field = structure; field; field = field->next) {
+    field->offset = type->size;
+    type->size += field->type->size;
+    ++count;
+  }
+  size_t capacity = 2;
+  while (capacity < count * 2) capacity *= 2; // keep load factor below 1/2
+  SEField **layout = (SEField **)ARAlloc(&ctx->se.arena, sizeof(SEField *) * capacity);
+  memset(layout, 0, sizeof(SEField *) * capacity);
+  for (SEField *field = structure; field; field = field->next) {
+    size_t i = SEMix(0, (uintptr_t)field->name) & (capacity - 1);
+    while (layout[i] != NULL && layout[i]->name != field->name) i = (i + 1) & (capacity - 1);
+    if (layout[i] == NULL) layout[i] = field;
+  }
+  type->structure.fields = structure;
+  type->structure.layout = layout;
+  type->structure.mask = capacity - 1;
+  type->canon = SEInternType(ctx, type);
+  return type;
+}
+
+// Find a field of a structure by its interned name, NULL if none.
+SEField *SEFindField(const SEType *type, const char *name) {
+  size_t i = SEMix(0, (uintptr_t)name) & type->structure.mask;
+  SEField *field = NULL;
+  while ((field = type->structure.layout[i]) != NULL && field->name != name) {
+    i = (i + 1) & type->structure.mask;
+  }
+  return field;
+}
+
+// Create the type of a function declared at line.
+SEType *SENewFunctionType(CCContext *ctx, SEType *ret, SEField *signature, int line, bool defined) {
+  SEType *type = (SEType *)ARAlloc(&ctx->se.arena, sizeof(SEType));
+  type->kind = FUNCTION;
+  type->size = ret->size;
+  type->function.line = line;
+  type->function.defined = defined;
+  type->function.type = ret;
+  type->function.signature = signature;
+  type->canon = SEInternType(ctx, type);
+  return type;
+}
+
+// Create a field of a structure or a function signature.
+SEField *SENewField(CCContext *ctx, const char *name, SEType *type) {
+  SEField *field = (SEField *)ARAlloc(&ctx->se.arena, sizeof(SEField));
+  field->name = name;
+  field->type = type;
+  field->offset = 0;
+  field->next = NULL;
+  return field;
+}
+
+void SEPrepare(CCContext *ctx) {
+  SEState *se = &ctx->se;
+  *se = (SEState){ .arena = se->arena };
+  se->capacity = SE_INIT_CAPACITY;
+  se->table = (SEType **)calloc(se->capacity, sizeof(SEType *));
+  Assert(se->table != NULL, "out of memory for type table");
 
   // Add READ and WRITE functions
-  SEType *readType = (SEType *)malloc(sizeof(SEType));
-  readType->kind = FUNCTION;
-  readType->size = 4;
-  readType->function.defined = true;
-  readType->function.node = NULL;
-  readType->function.type = STATIC_TYPE_INT;
-  readType->function.signature = &STATIC_FIELD_VOID;
-  STInsertFunc("read", readType);
-
-  SEType *writeType = (SEType *)malloc(sizeof(SEType));
-  writeType->kind = FUNCTION;
-  writeType->size = 4;
-  writeType->function.defined = true;
-  writeType->function.node = NULL;
-  writeType->function.type = STATIC_TYPE_INT;
-  writeType->function.signature = &STATIC_FIELD_INT;
-  STInsertFunc("write", writeType);
-}
-
-// Parse an expression. Only one type so we don't need a chain.
+  STInsertFunc(ctx, INTERN_READ, SENewFunctionType(ctx, STATIC_TYPE_INT, &STATIC_FIELD_VOID, 0, true));
+  STInsertFunc(ctx, INTERN_WRITE, SENewFunctionType(ctx, STATIC_TYPE_INT, &STATIC_FIELD_INT, 0, true));
+}
+
+// Release all types, they are no longer valid.
+void SEDestroy(CCContext *ctx) {
+  free(ctx->se.table);
+  free(ctx->se.frames);
+  ARReset(&ctx->se.arena); // kept for the next compilation, see CCFree
+  ctx->se = (SEState){ .arena = ctx->se.arena };
+}
+
+/**
+ * Expressions are checked and translated together by an explicit stack
+ * machine, so nesting depth costs heap frames rather than native stack.
+ * Statements and CompSts run on the same stack, however deep blocks nest.
+ * A frame is one pending Exp, Cond, CondPre, Stmt or CompSt; a frame that needs a
+ * subexpression records where to resume in state and pushes a frame for
+ * it, and the finished frame leaves its code and type in the result.
+ * Errors are thrown in the same order as a recursive check. Once there is
+ * an error no code is generated any more, it would be thrown away anyway.
+ * */
+typedef enum SETask {
+  SE_TASK_EXP,
+  SE_TASK_COND,
+  SE_TASK_COND_PRE,
+  SE_TASK_STMT,
+  SE_TASK_COMPST,
+} SETask;
+
+typedef struct SEFrame {
+  SETask task;
+  int state;            // where to resume, 0 at entry
+  STNode *exp;
+  IROperand place;      // EXP, COND_PRE
+  bool deref;           // EXP
+  IROperand l1, l2;     // COND: true and false labels, COND_PRE: its labels
+  IROperand t1, t2, t3; // operands kept across subexpressions
+  IRCodePair pair;      // code and type of the left operand
+  STEntry *entry;       // called function
+  STNode *arg;          // current argument of a call
+  SEField *param;       // its parameter
+  bool mismatch;        // an argument does not match its parameter
+  IRCodeList arg_list;  // ARG codes of a call, in reverse order
+  SEType *type;         // STMT, COMPST: return type of the function
+  IRCodeList list;      // STMT: code of the first branch, COMPST: code so far
+  int floatLine;        // COMPST: see SEState, of the enclosing CompSt
+} SEFrame;
+
+// Push a frame for a subexpression, the pointer is valid until next push.
+static SEFrame *SEPushFrame(CCContext *ctx, SETask task, STNode *exp) {
+  if (ctx->se.frameCount == ctx->se.frameCapacity) {
+    ctx->se.frameCapacity = ctx->se.frameCapacity ? ctx->se.frameCapacity * 2 : 64;
+    ctx->se.frames = (SEFrame *)realloc(ctx->se.frames, sizeof(SEFrame) * ctx->se.frameCapacity);
+    Assert(ctx->se.frames != NULL, "out of memory for SE frames");
+  }
+  SEFrame *frame = &ctx->se.frames[ctx->se.frameCount++];
+  frame->task = task;
+  frame->state = 0;
+  frame->exp = exp;
+  return frame;
+}
+
+static void SEPushExp(CCContext *ctx, STNode *exp, IROperand place, bool deref) {
+  SEFrame *frame = SEPushFrame(ctx, SE_TASK_EXP, exp);
+  frame->place = place;
+  frame->deref = deref;
+}
+
+static void SEPushCond(CCContext *ctx, STNode *exp, IROperand label_true, IROperand label_false) {
+  SEFrame *frame = SEPushFrame(ctx, SE_TASK_COND, exp);
+  frame->l1 = label_true;
+  frame->l2 = label_false;
+}
+
+static void SEPushStmt(CCContext *ctx, STNode *stmt, SEType *type) {
+  SEFrame *frame = SEPushFrame(ctx, SE_TASK_STMT, stmt);
+  frame->type = type;
+}
+
+static void SEPushCompSt(CCContext *ctx, STNode *comp, SEType *type) {
+  SEFrame *frame = SEPushFrame(ctx, SE_TASK_COMPST, comp);
+  frame->type = type;
+}
+
+// Temporaries and labels are only numbered while code is generated.
+static IROperand SENewTemp(CCContext *ctx) {
+  return ctx->hasErrorS ? IRNewNullOperand() : IRNewTempOperand(ctx);
+}
+
+static IROperand SENewLabel(CCContext *ctx) {
+  return ctx->hasErrorS ? IRNewNullOperand() : IRNewLabelOperand(ctx);
+}
+
 #define malloc(s) NO_MALLOC_ALLOWED_EXP(s)
-SEType *SEParseExp(STNode *exp) {
-  AssertSTNode(exp, "Exp");
-  STNode *e1 = exp->child;
-  STNode *e2 = e1 ? e1->next : NULL;
-  STNode *e3 = e2 ? e2->next : NULL;
+// Check the types and the left side of Exp1 ASSIGNOP Exp2.
+static void SECheckAssign(CCContext *ctx, STNode *e1, STNode *e2, SEType *t1, SEType *t2) {
+  bool lvalue = false;
+  CLog(FG_CYAN, "Exp ASSIGNOP Exp");
+  Log("DUMP LEFT:"); SEDumpType(t1);
+  Log("DUMP RIGHT:"); SEDumpType(t2);
+  if (!SECompareType(t1, t2)) {
+    throwErrorS(ctx, SE_MISMATCHED_ASSIGNMENT, e2->line, NULL);
+  }
+  if (STChild(e1)->token == ID) lvalue = STChild(e1)->next == 0;
+  if (!lvalue && STChild(e1)->next != 0) {
+    lvalue = STNext(STChild(e1))->token == LB
+          || STNext(STChild(e1))->token == DOT;
+  }
+  if (!lvalue) {
+    // Not any of ID / Exp LB Exp RB / Exp DOT ID
+    throwErrorS(ctx, SE_RVALUE_ASSIGNMENT, e2->line, NULL);
+  }
+}
+
+// Run an Exp frame, return false if a frame is pushed or it continues.
+static bool SEStepExp(CCContext *ctx, SEFrame *frame, IRCodePair *result) {
+  STNode *exp = frame->exp;
+  AssertSTNode(exp, Exp);
+  STNode *e1 = STChild(exp);
+  STNode *e2 = e1 ? STNext(e1) : NULL;
+  STNode *e3 = e2 ? STNext(e2) : NULL;
+  IROperand place = frame->place;
+  bool deref = frame->deref;
   switch (e1->token) {
     case LP: // LP Exp RP
-      return SEParseExp(e2);
+      frame->exp = e2;
+      return false;
     case MINUS: {
-      CLog(FG_CYAN, "MINUS Exp");
-      SEType *type = SEParseExp(e2);
-      if (type->kind != BASIC) {
-        throwErrorS(SE_MISMATCHED_OPERANDS, e1->line, NULL);
+      if (frame->state == 0) {
+        CLog(FG_CYAN, "MINUS Exp");
+        frame->t1 = SENewTemp(ctx);
+        frame->state = 1;
+        SEPushExp(ctx, e2, frame->t1, true);
+        return false;
       }
-      return type;
-    }
-    case NOT: {
-      CLog(FG_CYAN, "NOT Exp");
-      SEType *type = SEParseExp(e2);
-      if (!SECompareType(type, STATIC_TYPE_INT)) {
-        throwErrorS(SE_MISMATCHED_OPERANDS, e1->line, NULL);
+      if (result->type->kind != BASIC) {
+        throwErrorS(ctx, SE_MISMATCHED_OPERANDS, e1->line, NULL);
       }
-      return type;
+      if (!ctx->hasErrorS && place.kind != IR_OP_NULL) {
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_SUB);
+        code->binop.result = place;
+        code->binop.op1 = IRNewConstantOperand(0);
+        code->binop.op2 = frame->t1;
+        result->list = IRAppendCode(result->list, code);
+      }
+      return true;
     }
+    case NOT:
+      frame->task = SE_TASK_COND_PRE;
+      return false;
     case ID: {
       if (e2 == NULL) {
-        STEntry *entry = STSearch(e1->sval);
-        if (entry == NULL || STSearchStru(e1->sval) != NULL) {
+        STEntry *entry = STSearch(ctx, STId(e1));
+        if (entry == NULL || STSearchStru(ctx, STId(e1)) != NULL) {
           // undefined variable or same name as struct, treat as int
-          throwErrorS(SE_VARIABLE_UNDEFINED, e1->line, e1->sval);
-          return STATIC_TYPE_INT;
+          throwErrorS(ctx, SE_VARIABLE_UNDEFINED, e1->line, STId(e1));
+          *result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
+        } else if (!ctx->hasErrorS && place.kind != IR_OP_NULL) {
+          IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+          code->assign.left = place;
+          code->assign.right = IRNewVariableOperand(ctx, entry);
+          *result = IRWrapPair(IRWrapCode(code), entry->type,
+                               entry->type->kind != BASIC);
         } else {
-          return entry->type;
+          *result = IRWrapPair(STATIC_EMPTY_IR_LIST, entry->type, false);
         }
-      } else {
-        STEntry *entry = NULL;
-        SEField *signature = NULL;
-        CLog(FG_CYAN, "%s", e3->next ? "ID LP Args RP" : "ID LP RP");
-        entry = STSearch(e1->sval);
+        return true;
+      }
+      if (frame->state == 0) {
+        CLog(FG_CYAN, "%s", e3->next != 0 ? "ID LP Args RP" : "ID LP RP");
+        STEntry *entry = STSearch(ctx, STId(e1));
         if (entry == NULL) {
           // undefined function, treat as int
-          throwErrorS(SE_FUNCTION_UNDEFINED, e1->line, e1->sval);
-          return STATIC_TYPE_INT;
+          throwErrorS(ctx, SE_FUNCTION_UNDEFINED, e1->line, STId(e1));
+          *result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
+          return true;
         } else if (entry->type->kind != FUNCTION) {
           // call to a non-function variable
-          throwErrorS(SE_ACCESS_TO_NON_FUNCTION, e1->line, e1->sval);
-          return STATIC_TYPE_INT;
+          throwErrorS(ctx, SE_ACCESS_TO_NON_FUNCTION, e1->line, STId(e1));
+          *result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
+          return true;
         }
-        signature = e3->next ? SEParseArgs(e3).head : &STATIC_FIELD_VOID;
-        if (!SECompareField(entry->type->function.signature, signature)) {
-          throwErrorS(SE_MISMATCHED_SIGNATURE, e1->line, e1->sval);
+        // function calls can't be ignored as they may have side effects!
+        // if place is empty, we need to create a temp variable.
+        if (place.kind == IR_OP_NULL) {
+          place = frame->place = SENewTemp(ctx);
         }
-        {
-          // memory leak fixed: manually free the allocated list
-          // do not call SEDestroyField because it frees types
-          if (signature != &STATIC_FIELD_VOID) {
-            SEField *field = signature;
-            SEField *next = NULL;
-            while (field != NULL) {
-              next = field->next;
-              free(field);
-              field = next;
-            }
-          }
+        frame->entry = entry;
+        frame->mismatch = false;
+        frame->pair.list = frame->arg_list = STATIC_EMPTY_IR_LIST;
+        frame->param = entry->type->function.signature;
+        frame->arg = e3->next != 0 ? STChild(e3) : NULL;
+        frame->state = 1;
+      } else {
+        // an argument is done, check it against its parameter
+        if (frame->param == NULL || !SECompareType(frame->param->type, result->type)) {
+          frame->mismatch = true;
+        }
+        if (!ctx->hasErrorS) {
+          frame->pair.list = IRConcatLists(frame->pair.list, result->list);
+          IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_ARG);
+          code->arg.variable = frame->t1;
+          frame->arg_list = IRConcatLists(IRWrapCode(code), frame->arg_list);
         }
-        return entry->type->function.type;
+        if (frame->param != NULL) frame->param = frame->param->next;
+        frame->arg = STNextItem(frame->arg);
       }
-      break;
+      if (frame->arg != NULL) {
+        SEField *param = frame->param;
+        frame->t1 = SENewTemp(ctx);
+        SEPushExp(ctx, frame->arg, frame->t1, param == NULL || param->type->kind == BASIC);
+        return false;
+      }
+
+      STEntry *entry = frame->entry;
+      SEType *type = entry->type->function.type;
+      bool mismatch = e3->next != 0 ? frame->mismatch || frame->param != NULL
+          : !SECompareField(entry->type->function.signature, &STATIC_FIELD_VOID);
+      if (mismatch) {
+        throwErrorS(ctx, SE_MISMATCHED_SIGNATURE, e1->line, STId(e1));
+      }
+      IRCodeList list = frame->pair.list;
+      IRCodeList arg_list = frame->arg_list;
+      if (ctx->hasErrorS) {
+        // no code
+      } else if (entry->id == INTERN_READ) {
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_READ);
+        code->read.variable = place;
+        list = IRWrapCode(code);
+      } else if (entry->id == INTERN_WRITE) {
+        Assert(arg_list.head != NULL, "empty arguments to WRITE");
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_WRITE);
+        code->write.variable = arg_list.head->arg.variable;
+        list = IRAppendCode(list, code);
+        // the argument list is dropped, it stays dead in the store
+      } else {
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_CALL);
+        code->call.result = place;
+        code->call.function = IRNewFunctionOperand(entry);
+        list = IRConcatLists(list, arg_list);
+        list = IRAppendCode(list, code);
+      }
+      *result = IRWrapPair(list, type, type->kind != BASIC);
+      return true;
+    }
+    case INT: {
+      if (!ctx->hasErrorS && place.kind != IR_OP_NULL) {
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+        code->assign.left = place;
+        code->assign.right = IRNewConstantOperand(e1->ival);
+        *result = IRWrapPair(IRWrapCode(code), STATIC_TYPE_INT, false);
+      } else {
+        *result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
+      }
+      return true;
     }
-    case INT:
     case FLOAT: {
-      return e1->token == INT ? STATIC_TYPE_INT : STATIC_TYPE_FLOAT;
+      if (ctx->se.floatLine == 0) ctx->se.floatLine = e1->line; // no code, see SEParseCompSt
+      *result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_FLOAT, false);
+      return true;
     }
-    default: {
-      SEType *t1 = SEParseExp(e1);
-      switch (e2->token) {
-        case LB: {
-          CLog(FG_CYAN, "Exp LB Exp RB");
-          if (t1->kind != ARRAY) {
-            throwErrorS(SE_ACCESS_TO_NON_ARRAY, e2->line, NULL);
-            return t1;
-          }
-          SEType *t2 = SEParseExp(e3);
-          if (t2->kind != BASIC || t2->basic != INT) {
-            throwErrorS(SE_NON_INTEGER_INDEX, e3->line, NULL);
-          }
-          return t1->array.type;
+    default:
+      break;
+  }
+
+  switch (e2->token) {
+    case LB: {
+      if (frame->state == 0) {
+        frame->state = 1;
+        SEPushExp(ctx, e1, place, false);
+        return false;
+      } else if (frame->state == 1) {
+        CLog(FG_CYAN, "Exp LB Exp RB");
+        if (result->type->kind != ARRAY) {
+          throwErrorS(ctx, SE_ACCESS_TO_NON_ARRAY, e2->line, NULL);
+          return true;
         }
-        case DOT: {
-          CLog(FG_CYAN, "Exp DOT ID");
-          if (t1->kind != STRUCTURE) {
-            throwErrorS(SE_ACCESS_TO_NON_STRUCT, e2->line, NULL);
-            return t1;
-          } else {
-            SEType *type = NULL;
-            SEField *field = t1->structure;
-            while (field != NULL) {
-              if (!strcmp(field->name, e3->sval)) {
-                type = field->type;
-                break;
-              }
-              field = field->next;
-            }
-            if (type == NULL) {
-              throwErrorS(SE_STRUCT_FIELD_UNDEFINED, e3->line, e3->sval);
-              type = STATIC_TYPE_INT; // treat as INT
-            }
-            return type;
-          }
+        frame->pair = *result;
+        frame->t1 = SENewTemp(ctx);
+        frame->state = 2;
+        SEPushExp(ctx, e3, frame->t1, true);
+        return false;
+      }
+      if (result->type->kind != BASIC || result->type->basic != INT) {
+        throwErrorS(ctx, SE_NON_INTEGER_INDEX, e3->line, NULL);
+      }
+      SEType *type = frame->pair.type->array.type;
+      IRCodeList list = STATIC_EMPTY_IR_LIST;
+      if (!ctx->hasErrorS) {
+        IROperand t1 = frame->t1;
+        list = IRConcatLists(frame->pair.list, result->list);
+
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_MUL);
+        code->binop.result = t1;
+        code->binop.op1 = t1;
+        code->binop.op2 = IRNewConstantOperand(type->size);
+        list = IRAppendCode(list, code);
+
+        if (place.kind != IR_OP_NULL) {
+          code = IRNewCode(&ctx->irstore, IR_CODE_ADD);
+          code->binop.result = place;
+          code->binop.op1 = place;
+          code->binop.op2 = t1;
+          list = IRAppendCode(list, code);
         }
-        case ASSIGNOP: {
-          bool lvalue = false;
-          SEType *t2 = SEParseExp(e3);
-          CLog(FG_CYAN, "Exp ASSIGNOP Exp");
-          Log("DUMP LEFT:"); SEDumpType(t1);
-          Log("DUMP RIGHT:"); SEDumpType(t2);
-          if (!SECompareType(t1, t2)) {
-            throwErrorS(SE_MISMATCHED_ASSIGNMENT, e2->line, NULL);
-          }
-          if (e1->child->token == ID) lvalue = e1->child->next == NULL;
-          if (!lvalue && e1->child->next) {
-            lvalue = e1->child->next->token == LB
-                  || e1->child->next->token == DOT;
+
+        if (deref && place.kind != IR_OP_NULL) {
+          code = IRNewCode(&ctx->irstore, IR_CODE_LOAD);
+          code->load.left = place;
+          code->load.right = place;
+          list = IRAppendCode(list, code);
+        }
+      }
+      *result = IRWrapPair(list, type, !deref);
+      return true;
+    }
+    case DOT: {
+      if (frame->state == 0) {
+        frame->state = 1;
+        SEPushExp(ctx, e1, place, false);
+        return false;
+      }
+      CLog(FG_CYAN, "Exp DOT ID");
+      if (result->type->kind != STRUCTURE) {
+        throwErrorS(ctx, SE_ACCESS_TO_NON_STRUCT, e2->line, NULL);
+        return true;
+      }
+      SEField *field = SEFindField(result->type, STId(e3));
+      if (field == NULL) {
+        throwErrorS(ctx, SE_STRUCT_FIELD_UNDEFINED, e3->line, STId(e3));
+        *result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false); // treat as INT
+        return true;
+      }
+      SEType *type = field->type;
+      IRCodeList list = result->list;
+      if (!ctx->hasErrorS && field->offset > 0 && place.kind != IR_OP_NULL) {
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_ADD);
+        code->binop.result = place;
+        code->binop.op1 = place;
+        code->binop.op2 = IRNewConstantOperand(field->offset);
+        list = IRAppendCode(list, code);
+      }
+
+      if (!ctx->hasErrorS && deref && place.kind != IR_OP_NULL) {
+        IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_LOAD);
+        code->load.left = place;
+        code->load.right = place;
+        list = IRAppendCode(list, code);
+      }
+      *result = IRWrapPair(list, type, !deref);
+      return true;
+    }
+    case ASSIGNOP: {
+      // t1 holds the value, t2 the variable (state 1) or its address
+      IRCodePair pair; // return value
+      switch (frame->state) {
+        case 0: {
+          STNode *id = STChild(e1);
+          STEntry *entry = NULL;
+          if (id->token == ID && id->next == 0) {
+            entry = STSearch(ctx, STId(id));
+            if (entry != NULL && STSearchStru(ctx, STId(id)) != NULL) entry = NULL;
           }
-          if (!lvalue) {
-            // Not any of ID / Exp LB Exp RB / Exp DOT ID
-            throwErrorS(SE_RVALUE_ASSIGNMENT, e2->line, NULL);
+          frame->t1 = SENewTemp(ctx);
+          if (entry != NULL && entry->type->kind == BASIC) {
+            // assign to a variable, which is checked here
+            frame->pair = IRWrapPair(STATIC_EMPTY_IR_LIST, entry->type, false);
+            frame->t2 = ctx->hasErrorS ? IRNewNullOperand() : IRNewVariableOperand(ctx, entry);
+            frame->state = 1;
+            SEPushExp(ctx, e3, frame->t1, true);
+          } else {
+            // assign to a address
+            frame->t2 = SENewTemp(ctx);
+            frame->state = 2;
+            SEPushExp(ctx, e1, frame->t2, false);
           }
-          return t1;
+          return false;
         }
-        case AND:
-        case OR: {
-          SEType *t2 = SEParseExp(e3);
-          CLog(FG_CYAN, "Exp AND/OR Exp");
-          Log("DUMP LEFT:"); SEDumpType(t1);
-          Log("DUMP RIGHT:"); SEDumpType(t2);
-          if (!SECompareType(t1, STATIC_TYPE_INT) ||
-              !SECompareType(t2, STATIC_TYPE_INT)) {
-            throwErrorS(SE_MISMATCHED_OPERANDS, e2->line, NULL);
+        case 1: {
+          SECheckAssign(ctx, e1, e2, frame->pair.type, result->type);
+          pair = IRWrapPair(result->list, frame->pair.type, result->addr);
+          if (!ctx->hasErrorS) {
+            IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+            code->assign.left = frame->t2;
+            code->assign.right = frame->t1;
+            pair.list = IRAppendCode(pair.list, code);
           }
-          return STATIC_TYPE_INT; // always return INT
+          break;
         }
-        case RELOP: {
-          CLog(FG_CYAN, "Exp RELOP Exp");
-          SEType *t2 = SEParseExp(e3);
-          if (t1->kind != BASIC || !SECompareType(t1, t2)) {
-            throwErrorS(SE_MISMATCHED_OPERANDS, e2->line, NULL);
+        case 2:
+          // we need the value stored in the memory for a word,
+          // copy memory area otherwise, we don't care about the value
+          frame->pair = *result;
+          frame->state = ctx->hasErrorS || result->type->size == 4 ? 3 : 4;
+          SEPushExp(ctx, e3, frame->t1, frame->state == 3);
+          return false;
+        case 3: {
+          SECheckAssign(ctx, e1, e2, frame->pair.type, result->type);
+          pair = IRWrapPair(frame->pair.list, frame->pair.type, false);
+          if (!ctx->hasErrorS) {
+            pair.list = IRConcatLists(pair.list, result->list);
+            IRCode *save = IRNewCode(&ctx->irstore, IR_CODE_SAVE);
+            save->save.left = frame->t2;
+            save->save.right = frame->t1;
+            pair.list = IRAppendCode(pair.list, save);
           }
-          return STATIC_TYPE_INT; // always return INT
+          break;
         }
         default: {
-          CLog(FG_CYAN, "Exp PLUS/MINUS/STAR/DIV Exp");
-          SEType *t2 = SEParseExp(e3);
-          if (t1->kind != BASIC || !SECompareType(t1, t2)) {
-            throwErrorS(SE_MISMATCHED_OPERANDS, e2->line, NULL);
+          SECheckAssign(ctx, e1, e2, frame->pair.type, result->type);
+          pair = frame->pair;
+          if (!ctx->hasErrorS) {
+            pair.list = IRConcatLists(pair.list, result->list);
+            pair.list = IRAppendCopy(ctx, pair.list, frame->t2, frame->t1, pair.type->size);
           }
-          return t1; // always treat as t1
+          break;
         }
       }
+
+      if (!ctx->hasErrorS && place.kind != IR_OP_NULL) {
+        IRCode *code2 = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+        code2->assign.left = place;
+        code2->assign.right = frame->t1; // var may be an address, use t1 instead
+        pair.list = IRAppendCode(pair.list, code2);
+      }
+      *result = pair;
+      return true;
+    }
+    case AND:
+    case OR:
+    case RELOP:
+      frame->task = SE_TASK_COND_PRE;
+      return false;
+    default: {
+      if (frame->state == 0) {
+        frame->t1 = SENewTemp(ctx);
+        frame->t2 = SENewTemp(ctx);
+        frame->state = 1;
+        SEPushExp(ctx, e1, frame->t1, true);
+        return false;
+      } else if (frame->state == 1) {
+        CLog(FG_CYAN, "Exp PLUS/MINUS/STAR/DIV Exp");
+        frame->pair = *result;
+        frame->state = 2;
+        SEPushExp(ctx, e3, frame->t2, true);
+        return false;
+      }
+      SEType *t1 = frame->pair.type;
+      if (t1->kind != BASIC || !SECompareType(t1, result->type)) {
+        throwErrorS(ctx, SE_MISMATCHED_OPERANDS, e2->line, NULL);
+      }
+      IRCodePair pair = frame->pair; // always treat as t1
+      if (!ctx->hasErrorS) {
+        pair.list = IRConcatLists(pair.list, result->list);
+        if (place.kind != IR_OP_NULL) {
+          pair.list = IRAppendArith(ctx, pair.list, e2->token, place, frame->t1, frame->t2);
+        }
+      }
+      *result = pair;
+      return true;
     }
   }
   Panic("should not reach here");
-  return NULL;
+  return true;
+}
+
+// Run a CondPre frame, which gives the value of a Cond to place.
+static bool SEStepCondPre(CCContext *ctx, SEFrame *frame, IRCodePair *result) {
+  AssertSTNode(frame->exp, Exp);
+  IROperand place = frame->place;
+  if (frame->state == 0) {
+    frame->l1 = SENewLabel(ctx);
+    frame->l2 = SENewLabel(ctx);
+    frame->pair.list = STATIC_EMPTY_IR_LIST;
+    if (!ctx->hasErrorS && place.kind != IR_OP_NULL) {
+      IRCode *code0 = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+      code0->assign.left = place;
+      code0->assign.right = IRNewConstantOperand(0);
+      frame->pair.list = IRWrapCode(code0);
+    }
+    frame->state = 1;
+    SEPushCond(ctx, frame->exp, frame->l1, frame->l2);
+    return false;
+  }
+
+  IRCodeList list = STATIC_EMPTY_IR_LIST;
+  if (!ctx->hasErrorS) {
+    list = IRConcatLists(frame->pair.list, result->list);
+
+    IRCode *label1 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+    label1->label.label = frame->l1;
+    list = IRAppendCode(list, label1);
+
+    if (place.kind != IR_OP_NULL) {
+      IRCode *code2 = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+      code2->assign.left = place;
+      code2->assign.right = IRNewConstantOperand(1);
+      list = IRAppendCode(list, code2);
+    }
+
+    IRCode *label2 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+    label2->label.label = frame->l2;
+    list = IRAppendCode(list, label2);
+  }
+  *result = IRWrapPair(list, result->type, false);
+  return true;
+}
+
+// Run a Cond frame, which jumps to l1 if the Exp holds and to l2 if not.
+static bool SEStepCond(CCContext *ctx, SEFrame *frame, IRCodePair *result) {
+  STNode *exp = frame->exp;
+  AssertSTNode(exp, Exp);
+  STNode *exp1 = STChild(exp);
+  STNode *exp2 = exp1->next != 0 ? STNext(STNext(exp1)) : NULL;
+  IROperand label_true = frame->l1;
+  IROperand label_false = frame->l2;
+  switch (frame->state) {
+    case 0:
+      if (exp1->token == NOT) {
+        // NOT Exp
+        CLog(FG_CYAN, "NOT Exp");
+        frame->state = 6;
+        SEPushCond(ctx, STNext(exp1), label_false, label_true);
+        return false;
+      } else if (exp1->token != MINUS && exp1->next != 0) {
+        Assert(exp2 != NULL, "invalid cond format");
+        switch (STNext(exp1)->token) {
+          case RELOP:
+            // Exp1 RELOP Exp2
+            CLog(FG_CYAN, "Exp RELOP Exp");
+            frame->t1 = SENewTemp(ctx);
+            frame->t2 = SENewTemp(ctx);
+            frame->state = 1;
+            SEPushExp(ctx, exp1, frame->t1, true);
+            return false;
+          case AND:
+            // Exp1 AND Exp2
+            frame->t3 = SENewLabel(ctx);
+            frame->state = 3;
+            SEPushCond(ctx, exp1, frame->t3, label_false);
+            return false;
+          case OR:
+            // Exp1 OR Exp2
+            frame->t3 = SENewLabel(ctx);
+            frame->state = 3;
+            SEPushCond(ctx, exp1, label_true, frame->t3);
+            return false;
+          default:
+            // go through to the general case
+            break;
+        }
+      }
+      // General case: Exp (like if(0), while(1))
+      frame->t1 = SENewTemp(ctx);
+      frame->state = 5;
+      SEPushExp(ctx, exp, frame->t1, true);
+      return false;
+    case 1:
+      frame->pair = *result;
+      frame->state = 2;
+      SEPushExp(ctx, exp2, frame->t2, true);
+      return false;
+    case 2: {
+      SEType *t1 = frame->pair.type;
+      if (t1->kind != BASIC || !SECompareType(t1, result->type)) {
+        throwErrorS(ctx, SE_MISMATCHED_OPERANDS, STNext(exp1)->line, NULL);
+      }
+      IRCodeList list = STATIC_EMPTY_IR_LIST;
+      if (!ctx->hasErrorS) {
+        list = IRConcatLists(frame->pair.list, result->list);
+
+        IRCode *jump1 = IRNewCode(&ctx->irstore, IR_CODE_JUMP_COND);
+        jump1->jump_cond.op1 = frame->t1;
+        jump1->jump_cond.op2 = frame->t2;
+        jump1->jump_cond.relop = IRNewRelopOperand(STNext(exp1)->rval);
+        jump1->jump_cond.dest = label_true;
+        list = IRAppendCode(list, jump1);
+
+        IRCode *jump2 = IRNewCode(&ctx->irstore, IR_CODE_JUMP);
+        jump2->jump.dest = label_false;
+        list = IRAppendCode(list, jump2);
+      }
+      *result = IRWrapPair(list, STATIC_TYPE_INT, false); // always return INT
+      return true;
+    }
+    case 3:
+      frame->pair = *result;
+      if (!ctx->hasErrorS) {
+        IRCode *label = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+        label->label.label = frame->t3;
+        frame->pair.list = IRAppendCode(frame->pair.list, label);
+      }
+      frame->state = 4;
+      SEPushCond(ctx, exp2, label_true, label_false);
+      return false;
+    case 4: {
+      SEType *t1 = frame->pair.type;
+      CLog(FG_CYAN, "Exp AND/OR Exp");
+      Log("DUMP LEFT:"); SEDumpType(t1);
+      Log("DUMP RIGHT:"); SEDumpType(result->type);
+      if (!SECompareType(t1, STATIC_TYPE_INT) ||
+          !SECompareType(result->type, STATIC_TYPE_INT)) {
+        throwErrorS(ctx, SE_MISMATCHED_OPERANDS, STNext(exp1)->line, NULL);
+      }
+      IRCodeList list = STATIC_EMPTY_IR_LIST;
+      if (!ctx->hasErrorS) list = IRConcatLists(frame->pair.list, result->list);
+      *result = IRWrapPair(list, STATIC_TYPE_INT, false); // always return INT
+      return true;
+    }
+    case 5:
+      if (!ctx->hasErrorS) {
+        IRCode *jump = IRNewCode(&ctx->irstore, IR_CODE_JUMP_COND);
+        jump->jump_cond.op1 = frame->t1;
+        jump->jump_cond.op2 = IRNewConstantOperand(0);
+        jump->jump_cond.relop = IRNewRelopOperand(RELOP_NE);
+        jump->jump_cond.dest = label_true;
+        result->list = IRAppendCode(result->list, jump);
+
+        jump = IRNewCode(&ctx->irstore, IR_CODE_JUMP);
+        jump->jump.dest = label_false;
+        result->list = IRAppendCode(result->list, jump);
+      }
+      result->addr = false;
+      return true;
+    default:
+      // NOT Exp has the type of Exp
+      if (!SECompareType(result->type, STATIC_TYPE_INT)) {
+        throwErrorS(ctx, SE_MISMATCHED_OPERANDS, exp1->line, NULL);
+      }
+      return true;
+  }
+}
+
+// Run a Stmt frame, whose code is left in the result.
+static bool SEStepStmt(CCContext *ctx, SEFrame *frame, IRCodePair *result) {
+  STNode *stmt = frame->exp;
+  AssertSTNode(stmt, Stmt);
+  STNode *first = STChild(stmt);
+  if (first->next == 0) { // CompSt
+    if (frame->state == 0) {
+      STPushStack(ctx, STACK_LOCAL);
+      frame->state = 1;
+      SEPushCompSt(ctx, first, frame->type);
+      return false;
+    }
+    STPopStack(ctx);
+    return true;
+  }
+  switch (first->token) {
+    case RETURN: { // RETURN Exp SEMI
+      if (frame->state == 0) {
+        frame->t1 = SENewTemp(ctx);
+        frame->state = 1;
+        SEPushExp(ctx, STNext(first), frame->t1, true);
+        return false;
+      }
+      if (!SECompareType(frame->type, result->type)) {
+        throwErrorS(ctx, SE_MISMATCHED_RETURN, first->line, NULL);
+      }
+      if (ctx->hasErrorS) {
+        result->list = STATIC_EMPTY_IR_LIST;
+        return true;
+      }
+      IRCode *code = IRNewCode(&ctx->irstore, IR_CODE_RETURN);
+      code->ret.value = frame->t1;
+      result->list = IRAppendCode(result->list, code);
+      return true;
+    }
+    case IF: { // IF LP Exp RP Stmt [ELSE Stmt]
+      STNode *enode = STNext(STNext(first));
+      STNode *snode = STNext(STNext(enode));
+      switch (frame->state) {
+        case 0:
+          frame->l1 = SENewLabel(ctx);
+          frame->l2 = SENewLabel(ctx);
+          frame->state = 1;
+          SEPushCond(ctx, enode, frame->l1, frame->l2);
+          return false;
+        case 1:
+          if (!SECompareType(result->type, STATIC_TYPE_INT)) {
+            throwErrorS(ctx, SE_MISMATCHED_OPERANDS, enode->line, NULL);
+          }
+          frame->pair = *result;
+          frame->state = 2;
+          SEPushStmt(ctx, snode, frame->type);
+          return false;
+        case 2:
+          frame->list = result->list;
+          frame->t3 = IRNewNullOperand();
+          if (snode->next != 0) {
+            frame->t3 = SENewLabel(ctx);
+            frame->state = 3;
+            SEPushStmt(ctx, STNext(STNext(snode)), frame->type);
+            return false;
+          }
+          result->list = STATIC_EMPTY_IR_LIST;
+          break;
+        default:
+          break; // the ELSE branch is in the result
+      }
+      IRCodeList list2 = result->list;
+      result->list = STATIC_EMPTY_IR_LIST;
+      if (ctx->hasErrorS) return true;
+
+      IRCode *label1 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+      label1->label.label = frame->l1;
+      IRCode *label2 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+      label2->label.label = frame->l2;
+
+      IRCodeList list = IRAppendCode(frame->pair.list, label1);
+      list = IRConcatLists(list, frame->list);
+      if (snode->next == 0) {
+        result->list = IRAppendCode(list, label2);
+        return true;
+      }
+      IRCode *jump = IRNewCode(&ctx->irstore, IR_CODE_JUMP);
+      jump->jump.dest = frame->t3;
+      list = IRAppendCode(list, jump);
+      list = IRAppendCode(list, label2);
+      list = IRConcatLists(list, list2);
+
+      IRCode *label3 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+      label3->label.label = frame->t3;
+      result->list = IRAppendCode(list, label3);
+      return true;
+    }
+    case WHILE: { // WHILE LP Exp RP Stmt
+      STNode *enode = STNext(STNext(first));
+      STNode *snode = STNext(STNext(enode));
+      if (frame->state == 0) {
+        frame->l1 = SENewLabel(ctx);
+        frame->l2 = SENewLabel(ctx);
+        frame->t3 = SENewLabel(ctx);
+        frame->state = 1;
+        SEPushCond(ctx, enode, frame->l2, frame->t3);
+        return false;
+      } else if (frame->state == 1) {
+        if (!SECompareType(result->type, STATIC_TYPE_INT)) {
+          throwErrorS(ctx, SE_MISMATCHED_OPERANDS, enode->line, NULL);
+        }
+        frame->pair = *result;
+        frame->state = 2;
+        SEPushStmt(ctx, snode, frame->type);
+        return false;
+      }
+      IRCodeList body = result->list;
+      result->list = STATIC_EMPTY_IR_LIST;
+      if (ctx->hasErrorS) return true;
+
+      IRCode *label1 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+      IRCode *label2 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+      IRCode *label3 = IRNewCode(&ctx->irstore, IR_CODE_LABEL);
+      label1->label.label = frame->l1;
+      label2->label.label = frame->l2;
+      label3->label.label = frame->t3;
+
+      IRCodeList list = IRWrapCode(label1);
+      list = IRConcatLists(list, frame->pair.list);
+      list = IRAppendCode(list, label2);
+      list = IRConcatLists(list, body);
+
+      IRCode *jump = IRNewCode(&ctx->irstore, IR_CODE_JUMP);
+      jump->jump.dest = frame->l1;
+      list = IRAppendCode(list, jump);
+      result->list = IRAppendCode(list, label3);
+      return true;
+    }
+    default: { // Exp SEMI
+      if (frame->state == 0) {
+        frame->state = 1;
+        SEPushExp(ctx, first, IRNewNullOperand(), true);
+        return false;
+      }
+      if (ctx->hasErrorS) result->list = STATIC_EMPTY_IR_LIST;
+      return true;
+    }
+  }
+}
+
+// Run a CompSt frame: its definitions, then its statements one by one.
+// We do not need to push/pop stack, that should be done by the CALLER.
+static bool SEStepCompSt(CCContext *ctx, SEFrame *frame, IRCodePair *result) {
+  AssertSTNode(frame->exp, CompSt);
+  // CompSt -> LC DefList StmtList RC
+  if (frame->state == 0) {
+    size_t index = frame - ctx->se.frames;
+    STNode *defs = STNext(STChild(frame->exp));
+    int outer = ctx->se.floatLine;
+    ctx->se.floatLine = 0;
+    IRCodeList list = STATIC_EMPTY_IR_LIST;
+    SEParseDefList(ctx, defs, true, &list); // runs frames of its own
+    frame = &ctx->se.frames[index];
+    frame->floatLine = outer;
+    frame->list = list;
+    frame->arg = STChild(STNext(defs)); // the first Stmt
+    frame->state = 1;
+  } else {
+    frame->list = IRConcatLists(frame->list, result->list);
+    frame->arg = STNext(frame->arg);
+  }
+  if (frame->arg != NULL) {
+    SEPushStmt(ctx, frame->arg, frame->type);
+    return false;
+  }
+  // FLOAT has no code, the CompSt cannot be translated.
+  if (ctx->se.floatLine != 0 && !ctx->hasErrorS) {
+    throwErrorT(ctx, ctx->se.floatLine);
+  }
+  ctx->se.floatLine = frame->floatLine;
+  *result = IRWrapPair(frame->list, STATIC_TYPE_VOID, false);
+  return true;
+}
+
+// Run the frames above base until they are all done, return the result.
+static IRCodePair SERunFrames(CCContext *ctx, size_t base) {
+  IRCodePair result = IRWrapPair(STATIC_EMPTY_IR_LIST, STATIC_TYPE_INT, false);
+  while (ctx->se.frameCount > base) {
+    SEFrame *frame = &ctx->se.frames[ctx->se.frameCount - 1];
+    bool done = false;
+    switch (frame->task) {
+      case SE_TASK_EXP:
+        done = SEStepExp(ctx, frame, &result);
+        break;
+      case SE_TASK_COND:
+        done = SEStepCond(ctx, frame, &result);
+        break;
+      case SE_TASK_COND_PRE:
+        done = SEStepCondPre(ctx, frame, &result);
+        break;
+      case SE_TASK_STMT:
+        done = SEStepStmt(ctx, frame, &result);
+        break;
+      case SE_TASK_COMPST:
+        done = SEStepCompSt(ctx, frame, &result);
+        break;
+    }
+    if (done) --ctx->se.frameCount;
+  }
+  return result;
+}
+
+// Parse an expression and translate it, the value is given to place.
+IRCodePair SEParseExp(CCContext *ctx, STNode *exp, IROperand place, bool deref) {
+  size_t base = ctx->se.frameCount;
+  SEPushExp(ctx, exp, place, deref);
+  return SERunFrames(ctx, base);
+}
+
+// Parse a condition and translate it into jumps to the labels.
+IRCodePair SEParseCond(CCContext *ctx, STNode *exp, IROperand label_true, IROperand label_false) {
+  size_t base = ctx->se.frameCount;
+  SEPushCond(ctx, exp, label_true, label_false);
+  return SERunFrames(ctx, base);
 }
 #undef malloc
 
 // Parse a specifier. Only one type so we don't need a chain.
-SEType *SEParseSpecifier(STNode *specifier) {
-  AssertSTNode(specifier, "Specifier");
-  STNode *child = specifier->child;
+SEType *SEParseSpecifier(CCContext *ctx, STNode *specifier) {
+  AssertSTNode(specifier, Specifier);
+  STNode *child = STChild(specifier);
   if (child->token == TYPE) {
-    if (!strcmp(child->sval, "int")) {
+    if (STId(child) == INTERN_INT) {
       Log("INT");
       return STATIC_TYPE_INT;
     } else {
@@ -246,52 +1088,44 @@ SEType *SEParseSpecifier(STNode *specifier) {
     }
   } else {
     Log("STRUCT");
-    child = child->child; // STRUCT
+    child = STChild(child); // STRUCT
     Assert(child->token == STRUCT, "child is not struct");
-    STNode *tag = child->next;
-    if (tag->next) {
+    STNode *tag = STNext(child);
+    if (tag->next != 0) {
       // define a new struct
       // STRUCT OptTag LC DefList RC
-      char *name = tag->empty ? NULL : tag->child->sval;
-      SEType *type = (SEType *)malloc(sizeof(SEType));
-      {
-        STPushStack(STACK_STRUCTURE);
-        type->extended = true; // struct has global scope
-        type->kind = STRUCTURE;
-        type->size = 0;
-        type->parent = type;
-        type->structure = SEParseDefList(tag->next->next, false).head;
-        for (SEField *field = type->structure; field; field = field->next) {
-          type->size += field->type->size;
-        }
-        STPopStack();
-      }
+      const char *name = tag->empty ? NULL : STId(STChild(tag));
+      STPushStack(ctx, STACK_STRUCTURE);
+      SEField *structure = SEParseDefList(ctx, STNext(STNext(tag)), false, NULL).head;
+      STPopStack(ctx);
+      SEType *type = SENewStructType(ctx, structure != &ctx->se.dummy ? structure : NULL);
       if (tag->empty) {
         // ID never begins with a space so it's safe!
-        name = (char *)malloc(sizeof(char) * 32);
-        sprintf(name, " ANONYMOUS_STRUCT_%08x", anonymous++);
+        char buffer[32];
+        int length = sprintf(buffer, " ANONYMOUS_STRUCT_%08x", ctx->se.anonymous++);
+        name = INIntern(buffer, length);
       }
       CLog(FG_GREEN, "new structure \"%s\"", name);
-      if (STSearch(name) != NULL) {
+      if (STSearch(ctx, name) != NULL) {
         // struct cannot have same name with variable
-        throwErrorS(SE_STRUCT_DUPLICATE, tag->line, name);
-      } else if (STSearchStru(name) != NULL) {
-        throwErrorS(SE_STRUCT_DUPLICATE, tag->line, name);
+        throwErrorS(ctx, SE_STRUCT_DUPLICATE, tag->line, name);
+      } else if (STSearchStru(ctx, name) != NULL) {
+        throwErrorS(ctx, SE_STRUCT_DUPLICATE, tag->line, name);
       } else {
-        STInsertStru(name, type);
+        STInsertStru(ctx, name, type);
       }
       return type;
     } else {
       // STRUCT Tag
-      const char *name = tag->child->sval;
-      STEntry *entry = STSearchStru(name);
+      const char *name = STId(STChild(tag));
+      STEntry *entry = STSearchStru(ctx, name);
       if (entry == NULL) {
         // undefined struct, treat as INT
-        throwErrorS(SE_STRUCT_UNDEFINED, tag->line, name);
+        throwErrorS(ctx, SE_STRUCT_UNDEFINED, tag->line, name);
         return STATIC_TYPE_INT;
       } else if (entry->type->kind != STRUCTURE) {
         // duplicated name of struct, treat as INT
-        throwErrorS(SE_STRUCT_DUPLICATE, tag->line, name);
+        throwErrorS(ctx, SE_STRUCT_DUPLICATE, tag->line, name);
         return STATIC_TYPE_INT;
       } else {
         return entry->type;
@@ -304,182 +1138,109 @@ SEType *SEParseSpecifier(STNode *specifier) {
 
 // Parse an ext-definition list.
 #define malloc(s) NO_MALLOC_ALLOWED_EXT_DEF_LIST(s)
-void SEParseExtDefList(STNode *list) {
-  AssertSTNode(list, "ExtDefList");
-  if (list->empty) return;
-  SEParseExtDef(list->child);
-  SEParseExtDefList(list->child->next);
+void SEParseExtDefList(CCContext *ctx, STNode *list) {
+  AssertSTNode(list, ExtDefList);
+  for (STNode *edef = STChild(list); edef != NULL; edef = STNext(edef)) {
+    SEParseExtDef(ctx, edef);
+  }
 }
 #undef malloc
 
 // Parse an ext-definition.
 #define malloc(s) NO_MALLOC_ALLOWED_EXT_DEF(s)
-void SEParseExtDef(STNode *edef) {
-  AssertSTNode(edef, "ExtDef");
-  SEType *type = SEParseSpecifier(edef->child);
-  STNode *body = edef->child->next;
+void SEParseExtDef(CCContext *ctx, STNode *edef) {
+  AssertSTNode(edef, ExtDef);
+  SEType *type = SEParseSpecifier(ctx, STChild(edef));
+  STNode *body = STNext(STChild(edef));
   if (body->token == SEMI) return;
-  if (!strcmp(body->name, "ExtDecList")) {
-    SEParseExtDecList(body, type);
+  if (body->kind == ST_ExtDecList) {
+    SEParseExtDecList(ctx, body, type);
   } else {
-    SEParseFunDec(body, type); // CompSt handled by FunDec
+    SEParseFunDec(ctx, body, type); // CompSt handled by FunDec
   }
 }
 #undef malloc
 
 // Parse an ext-declaration list.
 #define malloc(s) NO_MALLOC_ALLOWED_EXT_DEC_LIST(s)
-void SEParseExtDecList(STNode *list, SEType *type) {
-  AssertSTNode(list, "ExtDecList");
-  SEParseVarDec(list->child, type, false);
-  if (list->child->next) {
-    SEParseExtDecList(list->child->next->next, type);
+void SEParseExtDecList(CCContext *ctx, STNode *list, SEType *type) {
+  AssertSTNode(list, ExtDecList);
+  for (STNode *var = STChild(list); var != NULL; var = STNextItem(var)) {
+    SEParseVarDec(ctx, var, type, false);
   }
 }
 #undef malloc
 
 // Parse a function declaration.
-void SEParseFunDec(STNode *fdec, SEType *type) {
-  AssertSTNode(fdec, "FunDec");
-  STNode *id = fdec->child;
-  STNode *vars = id->next->next;
-  const char *name = id->sval;
-  STEntry *entry = STSearchFunc(name);
+void SEParseFunDec(CCContext *ctx, STNode *fdec, SEType *type) {
+  AssertSTNode(fdec, FunDec);
+  STNode *id = STChild(fdec);
+  STNode *vars = STNext(STNext(id));
+  const char *name = STId(id);
+  STEntry *entry = STSearchFunc(ctx, name);
   SEType *func = NULL;
   SEField *signature = NULL;
 
   if (entry == NULL) CLog(FG_GREEN, "new function \"%s\"", name);
 
-  STPushStack(STACK_LOCAL); // treat signature as inner scope
-  if (vars->next) {
-    SEFieldChain chain = SEParseVarList(vars);
-    for (SEField *field = chain.head; field != NULL; field = field->next) {
-      field->type->extended = true; // signature should not be destroyed locally
-    }
-    signature = chain.head;
+  STPushStack(ctx, STACK_LOCAL); // treat signature as inner scope
+  if (vars->next != 0) {
+    signature = SEParseVarList(ctx, vars).head;
   } else {
     signature = &STATIC_FIELD_VOID;
   }
 
   if (entry == NULL) {
-    func = (SEType *)malloc(sizeof(SEType));
-    func->kind = FUNCTION;
-    func->size = type->size;
-    func->parent = func;
-    func->function.node = fdec;
-    func->function.defined = fdec->next->token != SEMI;
-    func->function.type = type;
-    func->function.signature = signature;
-    STInsertFunc(name, func);
+    func = SENewFunctionType(ctx, type, signature, fdec->line, STNext(fdec)->token != SEMI);
+    STInsertFunc(ctx, name, func);
   } else {
     func = entry->type;
     if (func->kind != FUNCTION) {
       // treat as bad function call
-      throwErrorS(SE_ACCESS_TO_NON_FUNCTION, id->line, name);
+      throwErrorS(ctx, SE_ACCESS_TO_NON_FUNCTION, id->line, name);
     } else {
-      if (fdec->next->token != SEMI) {
+      if (STNext(fdec)->token != SEMI) {
         if (func->function.defined) {
-          throwErrorS(SE_FUNCTION_DUPLICATE, id->line, name);
+          throwErrorS(ctx, SE_FUNCTION_DUPLICATE, id->line, name);
         } else {
           CLog(FG_GREEN, "def function \"%s\"", name);
           func->function.defined = true;
         }
       }
       if (!SECompareType(func->function.type, type)) {
-        throwErrorS(SE_FUNCTION_CONFLICTING, id->line, name);
+        throwErrorS(ctx, SE_FUNCTION_CONFLICTING, id->line, name);
       }
       if (!SECompareField(func->function.signature, signature)) {
-        throwErrorS(SE_FUNCTION_CONFLICTING, id->line, name);
+        throwErrorS(ctx, SE_FUNCTION_CONFLICTING, id->line, name);
       }
     }
   }
-  if (fdec->next->token != SEMI) {
-    SEParseCompSt(fdec->next, type);
+  IRCodeList body = STATIC_EMPTY_IR_LIST;
+  if (STNext(fdec)->token != SEMI) {
+    body = SEParseCompSt(ctx, STNext(fdec), type);
   }
-  // At this moment, the code of the function is in IR queue.
-  // We need to pop it from queue and link to the global list.
-  if (!hasErrorS) {
-    IRTranslateFunc(name, fdec->next);
+  // The body is translated while it is checked,
+  // link it to the global list with the parameters.
+  if (!ctx->hasErrorS) {
+    IRTranslateFunc(ctx, name, body);
   }
-  STPopStack();  // After translation, stack can be poped.
+  STPopStack(ctx);  // After translation, stack can be poped.
 }
 
 // Parse a composed statement list and check for RETURN statements.
-#define malloc(s) NO_MALLOC_ALLOWED_COMPST(s)
-void SEParseCompSt(STNode *comp, SEType *type) {
-  AssertSTNode(comp, "CompSt");
-  // We do not need to push/pop stack, that should be done by the CALLER.
-  // CompSt -> LC DefList StmtList RC
-  SEParseDefList(comp->child->next, true);
-  SEParseStmtList(comp->child->next->next, type);
-  // After returning, the stack will be destroyed.
-  // Therefore we need to save the IR list into STNode.
-  if (!hasErrorS) {
-    IRTranslateCompSt(comp);  // IR is saved by callee.
-  }
+// Return the code of the CompSt.
+IRCodeList SEParseCompSt(CCContext *ctx, STNode *comp, SEType *type) {
+  size_t base = ctx->se.frameCount;
+  SEPushCompSt(ctx, comp, type);
+  return SERunFrames(ctx, base).list;
 }
-#undef malloc
-
-// Parse a statement list and check for RETURN statements.
-#define malloc(s) NO_MALLOC_ALLOWED_STMT_LIST(s)
-void SEParseStmtList(STNode *list, SEType *type) {
-  AssertSTNode(list, "StmtList");
-  if (list->empty) return;
-  SEParseStmt(list->child, type);
-  SEParseStmtList(list->child->next, type);
-}
-#undef malloc
 
 // Parse a single statement and check for RETURN statements.
-#define malloc(s) NO_MALLOC_ALLOWED_STMT(s)
-void SEParseStmt(STNode *stmt, SEType *type) {
-  AssertSTNode(stmt, "Stmt");
-  if (stmt->child->next == NULL) {
-    STPushStack(STACK_LOCAL);
-    SEParseCompSt(stmt->child, type);
-    STPopStack();
-    return;
-  } else {
-    switch (stmt->child->token) {
-      case RETURN: { // RETURN Exp SEMI
-        SEType *ret = SEParseExp(stmt->child->next);
-        if (!SECompareType(type, ret)) {
-          throwErrorS(SE_MISMATCHED_RETURN, stmt->child->line, NULL);
-        }
-        return;
-      }
-      case IF: { // IF LP Exp RP Stmt [ELSE Stmt]
-        STNode *enode = stmt->child->next->next;
-        STNode *snode = enode->next->next;
-        SEType *etype = SEParseExp(enode);
-        if (!SECompareType(etype, STATIC_TYPE_INT)) {
-          throwErrorS(SE_MISMATCHED_OPERANDS, enode->line, NULL);
-        }
-        SEParseStmt(snode, type);
-        if (snode->next) {
-          SEParseStmt(snode->next->next, type);
-        }
-        return;
-      }
-      case WHILE: { // WHILE LP Exp RP Stmt
-        STNode *enode = stmt->child->next->next;
-        STNode *snode = enode->next->next;
-        SEType *etype = SEParseExp(enode);
-        if (!SECompareType(etype, STATIC_TYPE_INT)) {
-          throwErrorS(SE_MISMATCHED_OPERANDS, enode->line, NULL);
-        }
-        SEParseStmt(snode, type);
-        return;
-      }
-      default: { // Exp SEMI
-        SEParseExp(stmt->child);
-        return;
-      }
-    }
-  }
-  Panic("should not reach here");
+IRCodeList SEParseStmt(CCContext *ctx, STNode *stmt, SEType *type) {
+  size_t base = ctx->se.frameCount;
+  SEPushStmt(ctx, stmt, type);
+  return SERunFrames(ctx, base).list;
 }
-#undef malloc
 
 /**
  * SEFieldChain is a struct of head and tail of the chain.
@@ -494,14 +1255,17 @@ void SEParseStmt(STNode *stmt, SEType *type) {
  * */
 // Parse a definition list. Return a field chain.
 #define malloc(s) NO_MALLOC_ALLOWED_DEF_LIST(s)
-SEFieldChain SEParseDefList(STNode *list, bool assignable) {
-  AssertSTNode(list, "DefList");
-  if (list->empty) return DUMMY_FIELD_CHAIN;
-  SEFieldChain chain = SEParseDef(list->child, assignable);
-  SEFieldChain tail = SEParseDefList(list->child->next, assignable);
-  if (tail.head != &DUMMY_FIELD) {
-    chain.tail->next = tail.head;
-    chain.tail = tail.tail;
+SEFieldChain SEParseDefList(CCContext *ctx, STNode *list, bool assignable, IRCodeList *code) {
+  AssertSTNode(list, DefList);
+  SEFieldChain chain = SE_DUMMY_CHAIN(ctx);
+  for (STNode *def = STChild(list); def != NULL; def = STNext(def)) {
+    SEFieldChain tail = SEParseDef(ctx, def, assignable, code);
+    if (chain.head == &ctx->se.dummy) {
+      chain = tail;
+    } else if (tail.head != &ctx->se.dummy) {
+      chain.tail->next = tail.head;
+      chain.tail = tail.tail;
+    }
   }
   return chain;
 }
@@ -509,20 +1273,20 @@ SEFieldChain SEParseDefList(STNode *list, bool assignable) {
 
 // Parse a single definition. Return a field chain.
 #define malloc(s) NO_MALLOC_ALLOWED_DEF(s)
-SEFieldChain SEParseDef(STNode *def, bool assignable) {
-  AssertSTNode(def, "Def");
-  SEType *type = SEParseSpecifier(def->child);
-  return SEParseDecList(def->child->next, type, assignable);
+SEFieldChain SEParseDef(CCContext *ctx, STNode *def, bool assignable, IRCodeList *code) {
+  AssertSTNode(def, Def);
+  SEType *type = SEParseSpecifier(ctx, STChild(def));
+  return SEParseDecList(ctx, STNext(STChild(def)), type, assignable, code);
 }
 #undef malloc
 
 // Parse a declaration list. Return a field chain.
 #define malloc(s) NO_MALLOC_ALLOWED_DEC_LIST(s)
-SEFieldChain SEParseDecList(STNode *list, SEType *type, bool assignable) {
-  AssertSTNode(list, "DecList");
-  SEFieldChain chain = SEParseDec(list->child, type, assignable);
-  if (list->child->next) {
-    SEFieldChain tail = SEParseDecList(list->child->next->next, type, assignable);
+SEFieldChain SEParseDecList(CCContext *ctx, STNode *list, SEType *type, bool assignable, IRCodeList *code) {
+  AssertSTNode(list, DecList);
+  SEFieldChain chain = SEParseDec(ctx, STChild(list), type, assignable, code);
+  for (STNode *dec = STNextItem(STChild(list)); dec != NULL; dec = STNextItem(dec)) {
+    SEFieldChain tail = SEParseDec(ctx, dec, type, assignable, code);
     if (!assignable) {
       chain.tail->next = tail.head;
       chain.tail = tail.tail;
@@ -533,20 +1297,46 @@ SEFieldChain SEParseDecList(STNode *list, SEType *type, bool assignable) {
 #undef malloc
 
 // Parse a single declaration. Return a field chain.
+// Local variables are translated into code, which is appended to code.
 #define malloc(s) NO_MALLOC_ALLOWED_DEC(s)
-SEFieldChain SEParseDec(STNode *dec, SEType *type, bool assignable) {
-  AssertSTNode(dec, "Dec");
+SEFieldChain SEParseDec(CCContext *ctx, STNode *dec, SEType *type, bool assignable, IRCodeList *code) {
+  AssertSTNode(dec, Dec);
   // We don't care about the chain, but we need the type!!
-  SEFieldChain chain = SEParseVarDec(dec->child, type, assignable);
-  if (dec->child->next != NULL) { // check assignment
+  SEFieldChain chain = SEParseVarDec(ctx, STChild(dec), type, assignable);
+  IROperand v = IRNewNullOperand();
+  if (code != NULL && !ctx->hasErrorS) {
+    // find the entry of variable and get IR number
+    STNode *id = STChild(dec);
+    while (id->token != ID) id = STChild(id);
+    STEntry *entry = STSearchCurr(ctx, STId(id));
+    Assert(entry, "entry %s not found in ST", STId(id));
+    v = IRNewVariableOperand(ctx, entry);
+    // check whether we need DEC an array or a struct (local variable)
+    if (entry->type->kind == ARRAY || entry->type->kind == STRUCTURE) {
+      Assert(v.kind == IR_OP_MEMBLOCK, "not declaring a memblock");
+      IRCode *dec = IRNewCode(&ctx->irstore, IR_CODE_DEC);
+      dec->dec.variable = v;
+      dec->dec.size = IRNewConstantOperand(entry->type->size);
+      *code = IRAppendCode(*code, dec);
+    }
+  }
+  if (STChild(dec)->next != 0) { // check assignment
     if (!assignable) {
-      STNode *id = dec->child;
-      while (id->token != ID) id = id->child;
-      throwErrorS(SE_STRUCT_FIELD_INITIALIZED, dec->child->next->line, id->sval);
+      STNode *id = STChild(dec);
+      while (id->token != ID) id = STChild(id);
+      throwErrorS(ctx, SE_STRUCT_FIELD_INITIALIZED, STNext(STChild(dec))->line, STId(id));
+    }
+    IROperand t1 = code != NULL ? SENewTemp(ctx) : IRNewNullOperand();
+    IRCodePair exp = SEParseExp(ctx, STNext(STNext(STChild(dec))), t1, true);
+    if (!SECompareType(chain.head->type, exp.type)) {
+      throwErrorS(ctx, SE_MISMATCHED_ASSIGNMENT, STNext(STChild(dec))->line, NULL);
     }
-    SEType *expType = SEParseExp(dec->child->next->next);
-    if (!SECompareType(chain.head->type, expType)) {
-      throwErrorS(SE_MISMATCHED_ASSIGNMENT, dec->child->next->line, NULL);
+    if (code != NULL && !ctx->hasErrorS) {
+      *code = IRConcatLists(*code, exp.list);
+      IRCode *assign = IRNewCode(&ctx->irstore, IR_CODE_ASSIGN);
+      assign->assign.left = v;
+      assign->assign.right = t1;
+      *code = IRAppendCode(*code, assign);
     }
   }
   return chain;
@@ -554,48 +1344,36 @@ SEFieldChain SEParseDec(STNode *dec, SEType *type, bool assignable) {
 #undef malloc
 
 // Parse a variable declaration. Return a field chain.
-SEFieldChain SEParseVarDec(STNode *var, SEType *type, bool assignable) {
-  AssertSTNode(var, "VarDec");
-  if (var->child->next) {
+SEFieldChain SEParseVarDec(CCContext *ctx, STNode *var, SEType *type, bool assignable) {
+  AssertSTNode(var, VarDec);
+  if (STChild(var)->next != 0) {
     // VarDec LB INT RB
-    int arraySize = var->child->next->next->ival;
-    SEType *arrayType = (SEType *)malloc(sizeof(SEType));
-    arrayType->kind = ARRAY;
-    arrayType->size = type->size * arraySize;
-    arrayType->parent = arrayType;
-    arrayType->array.size = arraySize;
-    arrayType->array.kind = type->kind;
-    arrayType->array.type = type;
-    return SEParseVarDec(var->child, arrayType, assignable);
+    int arraySize = STNext(STNext(STChild(var)))->ival;
+    return SEParseVarDec(ctx, STChild(var), SENewArrayType(ctx, type, arraySize), assignable);
   } else {
     // register ID in local scope
-    const char *name = var->child->sval;
-    if (STSearchCurr(name) != NULL) {
-      if (getCurrentStackType() == STACK_STRUCTURE) {
-        throwErrorS(SE_STRUCT_FIELD_DUPLICATE, var->child->line, name);
+    const char *name = STId(STChild(var));
+    if (STSearchCurr(ctx, name) != NULL) {
+      if (getCurrentStackType(ctx) == STACK_STRUCTURE) {
+        throwErrorS(ctx, SE_STRUCT_FIELD_DUPLICATE, STChild(var)->line, name);
       } else {
-        throwErrorS(SE_VARIABLE_DUPLICATE, var->child->line, name);
+        throwErrorS(ctx, SE_VARIABLE_DUPLICATE, STChild(var)->line, name);
       }
-    } else if (STSearchStru(name) != NULL) {
+    } else if (STSearchStru(ctx, name) != NULL) {
       // variables cannot share name with structures.
-      throwErrorS(SE_VARIABLE_DUPLICATE, var->child->line, name);
+      throwErrorS(ctx, SE_VARIABLE_DUPLICATE, STChild(var)->line, name);
     } else {
-      Log("%s: assignable=%s", var->child->sval, assignable ? "yes" : "no");
-      STInsertCurr(var->child->sval, type, assignable);
-      CLog(FG_GREEN, "new variable \"%s\"", var->child->sval);
+      Log("%s: assignable=%s", STId(STChild(var)), assignable ? "yes" : "no");
+      STInsertCurr(ctx, STId(STChild(var)), type, assignable);
+      CLog(FG_GREEN, "new variable \"%s\"", STId(STChild(var)));
     }
     if (assignable) {
       // we don't care about the chain except the type
-      DUMMY_FIELD_CHAIN.head->type = type;
-      return DUMMY_FIELD_CHAIN;
+      ctx->se.dummy.type = type;
+      return SE_DUMMY_CHAIN(ctx);
     } else {
       SEFieldChain chain;
-      SEField *field = (SEField *)malloc(sizeof(SEField));
-      field->name = var->child->sval;
-      field->kind = type->kind;
-      field->type = type;
-      field->next = NULL;
-      chain.head = chain.tail = field;
+      chain.head = chain.tail = SENewField(ctx, STId(STChild(var)), type);
       return chain; // chain of length 1
     }
   }
@@ -604,11 +1382,11 @@ SEFieldChain SEParseVarDec(STNode *var, SEType *type, bool assignable) {
 
 // Parse a variable list.
 #define malloc(s) NO_MALLOC_ALLOWED_VAR_LIST(s)
-SEFieldChain SEParseVarList(STNode *list) {
-  AssertSTNode(list, "VarList");
-  SEFieldChain chain = SEParseParamDec(list->child);
-  if (list->child->next) {
-    SEFieldChain tail = SEParseVarList(list->child->next->next);
+SEFieldChain SEParseVarList(CCContext *ctx, STNode *list) {
+  AssertSTNode(list, VarList);
+  SEFieldChain chain = SEParseParamDec(ctx, STChild(list));
+  for (STNode *pdec = STNextItem(STChild(list)); pdec != NULL; pdec = STNextItem(pdec)) {
+    SEFieldChain tail = SEParseParamDec(ctx, pdec);
     chain.tail->next = tail.head;
     chain.tail = tail.tail;
   }
@@ -618,33 +1396,15 @@ SEFieldChain SEParseVarList(STNode *list) {
 
 // Parse a parameter declaration.
 #define malloc(s) NO_MALLOC_ALLOWED_PARAM_DEC(s)
-SEFieldChain SEParseParamDec(STNode *pdec) {
-  AssertSTNode(pdec, "ParamDec");
-  SEType *type = SEParseSpecifier(pdec->child);
-  return SEParseVarDec(pdec->child->next, type, false);
+SEFieldChain SEParseParamDec(CCContext *ctx, STNode *pdec) {
+  AssertSTNode(pdec, ParamDec);
+  SEType *type = SEParseSpecifier(ctx, STChild(pdec));
+  return SEParseVarDec(ctx, STNext(STChild(pdec)), type, false);
 }
 #undef malloc
 
-// Parse arguments list. Return a field chain.
-SEFieldChain SEParseArgs(STNode *args) {
-  AssertSTNode(args, "Args");
-  SEType *type = SEParseExp(args->child);
-  SEField *field = (SEField *)malloc(sizeof(SEField));
-  field->name = NULL;
-  field->kind = type->kind;
-  field->type = type;
-  field->next = NULL;
-  SEFieldChain chain = { field, field };
-  if (args->child->next) {
-    SEFieldChain tail = SEParseArgs(args->child->next->next);
-    chain.tail->next = tail.head;
-    chain.tail = tail.tail;
-  }
-  return chain;
-}
-
 /**
- * Helper functions: dump, compare and destroy.
+ * Helper functions: dump and compare.
  * We don't need malloc from here any more.
  * */
 #define malloc(s) NO_MALLOC_ALLOWED_HELPERS(s)
@@ -675,112 +1435,18 @@ void SEDumpType(const SEType *type) {
 #endif
 }
 
-// Get parent type in disjoint-set-union.
-// Path is compressed for better performance.
-SEType *SEGetParentType(SEType *t) {
-  if (t->parent == t) return t;
-  return t->parent = SEGetParentType(t->parent);
-}
-
 // Compare two types, return true if they are same.
 bool SECompareType(SEType *t1, SEType *t2) {
   Log("%p (%d) vs %p (%d)", t1, t1->kind, t2, t2->kind);
-  t1 = SEGetParentType(t1);
-  t2 = SEGetParentType(t2);
-  if (t1->kind != t2->kind) return false;
-  if (t1->parent == t2->parent) return true;
-  SEField *f1 = NULL, *f2 = NULL;
-  switch (t1->kind) {
-    case VOID:
-      return t2->kind == VOID;
-    case BASIC:
-      return t1->basic == t2->basic;
-    case ARRAY:
-      // if (t1->array.size != t2->array.size) return false;
-      return SECompareType(t1->array.type, t2->array.type);
-    case STRUCTURE:
-      if (SECompareField(t1->structure, t2->structure)) {
-        t2->parent = t1;
-        return true;
-      } else return false;
-    case FUNCTION:
-      if (SECompareType(t1->function.type, t2->function.type) &&
-          SECompareField(t1->function.signature, t2->function.signature)) {
-        t2->parent = t1;
-        return true;
-      } else return false;
-    default:
-      Panic("compare %p (kind %d) not implemented", t1, t1->kind);
-  }
-  Panic("should not reach here");
-  return false;
+  return t1->canon == t2->canon;
 }
 
 // Compare two field chains, return true if they are same.
 bool SECompareField(SEField *f1, SEField *f2) {
   while (f1 != NULL && f2 != NULL) {
-    if (!SECompareType(f1->type, f2->type)) return false;
+    if (f1->type->canon != f2->type->canon) return false;
     f1 = f1->next;
     f2 = f2->next;
   }
   return f1 == NULL && f2 == NULL;
 }
-
-// Destroy the type in memory until INT or FLOAT is met
-void SEDestroyType(SEType *type) {
-  SEField *temp = NULL, *field = NULL;
-  switch (type->kind) {
-    case VOID:
-    case BASIC:
-      return;
-    case ARRAY: {
-      // structures must be destroyed individually
-      if (type->array.kind != STRUCTURE) {
-        SEDestroyType(type->array.type);
-      }
-      free(type);
-      return;
-    }
-    case STRUCTURE: {
-      SEDestroyField(type->structure);
-      free(type);
-      return;
-    }
-    case FUNCTION: {
-      if (!type->function.defined) {
-        // undefined function detected when destroying its type
-        throwErrorS(SE_FUNCTION_DECLARED_NOT_DEFINED, type->function.node->line, type->function.node->child->sval);
-      }
-      if (type->function.type->kind != STRUCTURE) {
-        // structures must be destroyed individually
-        SEDestroyType(type->function.type);
-      }
-      if (type->function.signature != &STATIC_FIELD_VOID &&
-          type->function.signature != &STATIC_FIELD_INT) {
-        SEDestroyField(type->function.signature);
-      }
-      free(type);
-      return;
-    }
-    default:
-      Panic("destroy %p (kind %d) not implemented", type, type->kind);
-  }
-  Panic("should not reach here");
-}
-
-// Destroy a chained field.
-void SEDestroyField(SEField *field) {
-  SEField *next = NULL;
-  if (field == &DUMMY_FIELD) return;
-  if (field == &STATIC_FIELD_VOID) return;
-  if (field == &STATIC_FIELD_INT) return;
-  while (field != NULL) {
-    next = field->next;
-    if (field->kind != STRUCTURE) {
-      // structures must be destroyed individually
-      SEDestroyType(field->type);
-    }
-    free(field);
-    field = next;
-  }
-}
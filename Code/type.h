@@ -8,6 +8,8 @@
 
 #include <stdbool.h>
 #include <unistd.h>
+#include "ir.h"
+#include "arena.h"
 
 enum SEBasicType {
   VOID,
@@ -22,20 +24,22 @@ struct STNode;
 struct SEField;
 
 typedef struct SEType {
-  bool extended; // should not be destroyed in local
   size_t size; // size of memory occupied by the type
   enum SEBasicType kind;
-  struct SEType *parent; // disjoint-set-unions, see massimo's m25
+  struct SEType *canon; // shared by all structurally equal types
   union {
     int basic;
     struct {
       int size;
-      enum SEBasicType kind; // type may already be destroyed!
       struct SEType *type;
     } array;
-    struct SEField *structure;
     struct {
-      struct STNode *node;
+      struct SEField *fields; // in the order of definition
+      struct SEField **layout; // fields by interned name, see SEFindField
+      size_t mask; // capacity of layout - 1
+    } structure;
+    struct {
+      int line; // where it is first declared
       bool defined;
       struct SEType *type;
       struct SEField *signature;
@@ -45,8 +49,8 @@ typedef struct SEType {
 
 typedef struct SEField {
   const char *name;
-  enum SEBasicType kind; // type may already be destroyed!
   struct SEType *type;
+  size_t offset; // from the start of its structure
   struct SEField *next;
 } SEField;
 
@@ -55,35 +59,56 @@ typedef struct SEFieldChain {
   struct SEField *tail;
 } SEFieldChain;
 
-void SEPrepare();
+// The types and the expression stack of a compilation, see type.c.
+typedef struct SEState {
+  Arena arena; // types and fields, until the end of the scan
+  struct SEType **table; // canonical types
+  size_t capacity, count;
+  struct SEFrame *frames;
+  size_t frameCount, frameCapacity;
+  int floatLine;  // of the first FLOAT in the current CompSt, 0: none
+  int anonymous;  // anonymous structure counter
+  SEField dummy;  // see SE_DUMMY_CHAIN in type.c
+} SEState;
+
+struct CCContext;
+
+extern SEType *const STATIC_TYPE_VOID, *const STATIC_TYPE_INT, *const STATIC_TYPE_FLOAT;
+
+void SEPrepare(struct CCContext *ctx);
+void SEDestroy(struct CCContext *ctx);
+
+// Types are only made here, see the type factory in type.c.
+SEType *SENewArrayType(struct CCContext *ctx, SEType *type, int size);
+SEType *SENewStructType(struct CCContext *ctx, SEField *structure);
+SEType *SENewFunctionType(struct CCContext *ctx, SEType *ret, SEField *signature, int line, bool defined);
+SEField *SENewField(struct CCContext *ctx, const char *name, SEType *type);
+SEField *SEFindField(const SEType *type, const char *name);
 
-SEType *SEParseExp(struct STNode *exp);
-SEType *SEParseSpecifier(struct STNode *specifier);
+IRCodePair SEParseExp(struct CCContext *ctx, struct STNode *exp, IROperand place, bool deref);
+IRCodePair SEParseCond(struct CCContext *ctx, struct STNode *exp, IROperand label_true, IROperand label_false);
+SEType *SEParseSpecifier(struct CCContext *ctx, struct STNode *specifier);
 
-void SEParseExtDefList(struct STNode *list);
-void SEParseExtDef(struct STNode *edef);
-void SEParseExtDecList(struct STNode *list, SEType *type);
-void SEParseFunDec(struct STNode *fdec, SEType *type);
+void SEParseExtDefList(struct CCContext *ctx, struct STNode *list);
+void SEParseExtDef(struct CCContext *ctx, struct STNode *edef);
+void SEParseExtDecList(struct CCContext *ctx, struct STNode *list, SEType *type);
+void SEParseFunDec(struct CCContext *ctx, struct STNode *fdec, SEType *type);
 
-void SEParseCompSt(struct STNode *comp, SEType *type);
-void SEParseStmtList(struct STNode *list, SEType *type);
-void SEParseStmt(struct STNode *stmt, SEType *type);
+IRCodeList SEParseCompSt(struct CCContext *ctx, struct STNode *comp, SEType *type);
+IRCodeList SEParseStmt(struct CCContext *ctx, struct STNode *stmt, SEType *type);
 
 // not assignable == function signature, or struct definition
-SEFieldChain SEParseDefList(struct STNode *list, bool assignable);
-SEFieldChain SEParseDef(struct STNode *def, bool assignable);
-SEFieldChain SEParseDecList(struct STNode *list, SEType *type, bool assignable);
-SEFieldChain SEParseDec(struct STNode *dec, SEType *type, bool assignable);
-SEFieldChain SEParseVarDec(struct STNode *var, SEType *type, bool assignable);
-SEFieldChain SEParseVarList(struct STNode *list);
-SEFieldChain SEParseParamDec(struct STNode *pdec);
-SEFieldChain SEParseArgs(struct STNode *args);
+// code != NULL: local definitions, translated and appended to code
+SEFieldChain SEParseDefList(struct CCContext *ctx, struct STNode *list, bool assignable, IRCodeList *code);
+SEFieldChain SEParseDef(struct CCContext *ctx, struct STNode *def, bool assignable, IRCodeList *code);
+SEFieldChain SEParseDecList(struct CCContext *ctx, struct STNode *list, SEType *type, bool assignable, IRCodeList *code);
+SEFieldChain SEParseDec(struct CCContext *ctx, struct STNode *dec, SEType *type, bool assignable, IRCodeList *code);
+SEFieldChain SEParseVarDec(struct CCContext *ctx, struct STNode *var, SEType *type, bool assignable);
+SEFieldChain SEParseVarList(struct CCContext *ctx, struct STNode *list);
+SEFieldChain SEParseParamDec(struct CCContext *ctx, struct STNode *pdec);
 
 void SEDumpType(const SEType *type);
-SEType *SEGetParentType(SEType *t);
 bool SECompareType(SEType *t1, SEType *t2);
 bool SECompareField(SEField *f1, SEField *f2);
-void SEDestroyType(SEType *type);
-void SEDestroyField(SEField *field);
 
 #endif // SE_TYPE_H
@@ -0,0 +1,131 @@
+#define _POSIX_C_SOURCE 200809L // pthreads
+#include <pthread.h>
+#include <stdlib.h>
+#include "worker.h"
+#include "debug.h"
+
+// Claim and run jobs until the pool is finished.
+static void *WKLoop(void *arg) {
+  WKPool *pool = (WKPool *)arg;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->claim == NULL && !pool->stop) {
+      pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    if (pool->claim == NULL) break;
+    WKJob *job = pool->claim;
+    pool->claim = job->next;
+    pthread_mutex_unlock(&pool->lock);
+    job->run(job);
+    pthread_mutex_lock(&pool->lock);
+    job->done = true;
+    if (job == pool->first) {
+      pthread_cond_signal(&pool->done); // only the oldest can be retired
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+// Retire the oldest job, waiting for it if needed. Called with the lock held.
+static void WKRetire(WKPool *pool) {
+  WKJob *job = pool->first;
+  while (!job->done) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pool->first = job->next;
+  if (pool->first == NULL) pool->last = NULL;
+  --pool->inFlight;
+  pthread_mutex_unlock(&pool->lock);
+  pool->retiring = true;
+  job->retire(job);
+  pool->retiring = false;
+  pthread_mutex_lock(&pool->lock);
+}
+
+// Start the workers of a new pool.
+void WKStart(WKPool *pool, int workers, int depth) {
+  pool->threads = NULL;
+  pool->count = pool->depth = 0;
+  pool->first = pool->last = pool->claim = NULL;
+  pool->inFlight = 0;
+  pool->stop = pool->retiring = false;
+  if (workers <= 0) return;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * workers);
+  Assert(pool->threads != NULL, "out of memory for workers");
+  for (int i = 0; i < workers; ++i) {
+    if (pthread_create(&pool->threads[i], NULL, WKLoop, pool) != 0) break;
+    ++pool->count;
+  }
+  pool->depth = depth > pool->count ? depth : pool->count;
+  Log("%d workers started", pool->count);
+}
+
+// Submit a job, retire finished jobs in order. A job may submit more
+// jobs when it is retired, they are retired later on.
+void WKSubmit(WKPool *pool, WKJob *job) {
+  job->done = false;
+  job->next = NULL;
+  if (pool->count == 0) {
+    job->run(job);
+    job->retire(job);
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  if (pool->last == NULL) {
+    pool->first = job;
+  } else {
+    pool->last->next = job;
+  }
+  pool->last = job;
+  if (pool->claim == NULL) pool->claim = job;
+  ++pool->inFlight;
+  pthread_cond_signal(&pool->work);
+  while (!pool->retiring && pool->first != NULL &&
+         (pool->first->done || pool->inFlight > pool->depth)) {
+    WKRetire(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// Retire the oldest job, waiting for it. Return false if there is none.
+bool WKRetireFirst(WKPool *pool) {
+  if (pool->count == 0) return false;
+  pthread_mutex_lock(&pool->lock);
+  bool any = pool->first != NULL;
+  if (any) WKRetire(pool);
+  pthread_mutex_unlock(&pool->lock);
+  return any;
+}
+
+// Retire all jobs, including those submitted meanwhile.
+void WKDrain(WKPool *pool) {
+  if (pool->count == 0) return;
+  pthread_mutex_lock(&pool->lock);
+  while (pool->first != NULL) {
+    WKRetire(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// Retire all jobs and stop the workers.
+void WKFinish(WKPool *pool) {
+  if (pool->threads == NULL) return;
+  WKDrain(pool);
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < pool->count; ++i) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  free(pool->threads);
+  pool->threads = NULL;
+  pool->count = 0;
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->done);
+}
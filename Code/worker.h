@@ -0,0 +1,47 @@
+/**
+ * The pool of worker threads for the back end.
+ * Jobs are run on the workers in any order, but retired on the thread
+ * which submits them, strictly in the order they were submitted, so the
+ * output of the jobs can be written out deterministically.
+ * At most `depth` jobs are in flight, submitting one more first retires
+ * the oldest, which bounds the memory held by finished jobs.
+ * With no workers, a job is run and retired as soon as it is submitted.
+ * Every compilation has a pool of its own.
+ * */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#define WKWORKERS 4 // <- back end threads switch (0: run on the main thread)
+#define WKDEPTH   64 // <- jobs in flight at most
+
+typedef struct WKJob {
+  void (*run)(struct WKJob *job);    // on a worker
+  void (*retire)(struct WKJob *job); // on the submitter, may free the job
+  bool done;
+  struct WKJob *next; // in order of submission
+} WKJob;
+
+// A pool of workers, nothing is shared between pools.
+typedef struct WKPool {
+  pthread_t *threads;
+  int count, depth;
+  WKJob *first, *last, *claim; // not retired yet; claim is the first not run
+  int inFlight;
+  bool stop;
+  bool retiring; // jobs submitted while retiring wait
+  pthread_mutex_t lock;
+  pthread_cond_t work; // a job to claim
+  pthread_cond_t done; // a job finished
+} WKPool;
+
+void WKStart(WKPool *pool, int workers, int depth);
+void WKSubmit(WKPool *pool, WKJob *job);
+bool WKRetireFirst(WKPool *pool);
+void WKDrain(WKPool *pool);
+void WKFinish(WKPool *pool);
+
+#endif // WORKER_H